@@ -42,19 +42,24 @@
 // Let the user define a keymap - assume the same row/column count as defined in constructor
 void Keypad_I2C::begin(char *userKeymap) {
     Keypad::begin(userKeymap);
+	busAcquire( );
 	port_write( 0xffff );			//set to power-up state
 	pinState = pinState_set( );
+	busRelease( );
 }
 
 // Initialize I2C
 void Keypad_I2C::begin(void) {
+	busAcquire( );
 	port_write( 0xffff );			//set to power-up state
 	pinState = pinState_set( );
+	busRelease( );
 }
 
 
 void Keypad_I2C::pin_write(byte pinNum, boolean level) {
 	word mask = 1<<pinNum;
+	portValid = false;			// the column drive changes, so rows must be read again
 	if( level == HIGH ) {
 		pinState |= mask;
 	} else {
@@ -66,11 +71,17 @@ void Keypad_I2C::pin_write(byte pinNum, boolean level) {
 
 int Keypad_I2C::pin_read(byte pinNum) {
 	word mask = 0x1<<pinNum;
-	_wire->requestFrom((int)i2caddr, (int)i2cwidth);
-	word pinVal = _wire->read( );
-	if (i2cwidth > 1) {
-		pinVal |= _wire->read( ) << 8;
-	} 
+	word pinVal;
+	if( scanMode == KEYPAD_I2C_SCAN_PORT ) {
+		// one read serves every row of the column being driven
+		if( !portValid ) {
+			portValue = port_read( );
+			portValid = true;
+		}
+		pinVal = portValue;
+	} else {
+		pinVal = port_read( );
+	}
 	pinVal &= mask;
 	if( pinVal == mask ) {
 		return 1;
@@ -79,29 +90,155 @@ int Keypad_I2C::pin_read(byte pinNum) {
 	}
 }
 
+word Keypad_I2C::port_read( ) {
+	if( !busAcquire( ) ) {
+		busRelease( );
+		return 0xffff;
+	}
+	unsigned long start = micros( );
+	if( _wire->requestFrom((int)i2caddr, (int)i2cwidth) != i2cwidth ) {
+		errors++;
+	}
+	word pinVal = _wire->read( );
+	if (i2cwidth > 1) {
+		pinVal |= _wire->read( ) << 8;
+	} 
+	transactions++;
+	busMicros += micros( ) - start;
+	busRelease( );
+	return pinVal;
+} // port_read( )
+
 void Keypad_I2C::port_write( word i2cportval ) {
+	pinState = i2cportval;
+	portValid = false;
+	if( !busAcquire( ) ) {
+		busRelease( );
+		return;
+	}
+	unsigned long start = micros( );
 	_wire->beginTransmission((int)i2caddr);
 	_wire->write( i2cportval & 0x00FF);
 	if (i2cwidth > 1) {
 		_wire->write( i2cportval >> 8 );
 	}
-	_wire->endTransmission();
-	pinState = i2cportval;
+	if( _wire->endTransmission() != 0 ) {
+		errors++;
+	}
+	transactions++;
+	busMicros += micros( ) - start;
+	busRelease( );
 } // port_write( )
 
-word Keypad_I2C::pinState_set( ) {
-	_wire->requestFrom( (int)i2caddr, (int)i2cwidth );
-	pinState = _wire->read( );
-	if (i2cwidth > 1) {
-		pinState |= _wire->read( ) << 8;
+// Nested calls share the outermost lock, so a scan holds the bus from its first write to its last read
+boolean Keypad_I2C::busAcquire( ) {
+	if( busLock == NULL ) {
+		return true;
 	}
+	if( lockDepth++ == 0 ) {
+		lockOk = busLock( i2caddr );
+		lockTransactions = transactions;
+		lockErrors = errors;
+	}
+	return lockOk;
+} // busAcquire( )
+
+void Keypad_I2C::busRelease( ) {
+	if( busLock == NULL ) {
+		return;
+	}
+	if( --lockDepth == 0 && lockOk ) {
+		busUnlock( i2caddr, transactions - lockTransactions, errors - lockErrors );
+	}
+} // busRelease( )
+
+word Keypad_I2C::pinState_set( ) {
+	pinState = port_read( );
 	return pinState;
 } // set_pinState( )
 
+bool Keypad_I2C::armInterrupt( ) {
+	word state = pinState;
+	for( byte c=0; c<numColsI2C; c++ ) {
+		state &= ~(1<<colPinsI2C[c]);
+	}
+	busAcquire( );
+	port_write( state );
+	word rows = port_read( );		// reading the port clears any pending INT
+	busRelease( );
+	armed = true;
+	scannedSinceArm = false;
+	for( byte r=0; r<numRowsI2C; r++ ) {
+		if( !(rows & (1<<rowPinsI2C[r])) ) {
+			return false;
+		}
+	}
+	return true;
+} // armInterrupt( )
+
+bool Keypad_I2C::keysIdle( ) {
+	if( !scannedSinceArm ) {
+		return false;
+	}
+	for( byte i=0; i<LIST_MAX; i++ ) {
+		if( key[i].kchar != NO_KEY ) {
+			return false;
+		}
+	}
+	return true;
+} // keysIdle( )
+
+// A scan drives one column at a time, so columns held low by armInterrupt( ) go back high first
+void Keypad_I2C::scanStart( ) {
+	if( armed ) {
+		word state = pinState;
+		for( byte c=0; c<numColsI2C; c++ ) {
+			state |= 1<<colPinsI2C[c];
+		}
+		port_write( state );
+		armed = false;
+	}
+} // scanStart( )
+
+// Keypad only scans when its debounce time has passed, so a call that moved no
+// bytes on the bus is not counted as a scan
+void Keypad_I2C::scanDone( unsigned long startTransactions, unsigned long startMicros ) {
+	if( transactions != startTransactions ) {
+		lastScanTransactions = transactions - startTransactions;
+		lastScanMicros = busMicros - startMicros;
+		scannedSinceArm = true;
+	}
+} // scanDone( )
+
+char Keypad_I2C::getKey( ) {
+	busAcquire( );
+	scanStart( );
+	unsigned long startTransactions = transactions;
+	unsigned long startMicros = busMicros;
+	char key = Keypad::getKey( );
+	scanDone( startTransactions, startMicros );
+	busRelease( );
+	return key;
+} // getKey( )
+
+bool Keypad_I2C::getKeys( ) {
+	busAcquire( );
+	scanStart( );
+	unsigned long startTransactions = transactions;
+	unsigned long startMicros = busMicros;
+	bool changed = Keypad::getKeys( );
+	scanDone( startTransactions, startMicros );
+	busRelease( );
+	return changed;
+} // getKeys( )
+
 
 /*
 || @changelog
 || |
+|| | 3.1 2026-10-17 - port scan mode: one expander read per column, bus statistics,
+|| |                  INT pin wake support with armInterrupt( )/keysIdle( ),
+|| |                  bus lock hooks and error count
 || | 3.0 2020-04-06 - Joe Young : multiple WireX param in constructor
 || | 2.0 2013-08-31 - Paul Williamson : Added i2cwidth parameter for PCF8575 support
 || |
@@ -46,11 +46,21 @@
 #define	PCF8574	1	// PCF8574 I/O expander device is 1 byte wide
 #define PCF8575 2	// PCF8575 I/O expander device is 2 bytes wide
 
+#define KEYPAD_I2C_SCAN_PIN  0	// read the expander once for every row pin (original behaviour)
+#define KEYPAD_I2C_SCAN_PORT 1	// read the expander once per column and decode all rows from it
+
+// optional bus arbitration: lock before a run of transactions, unlock reports what the run did
+typedef bool (*Keypad_I2C_Lock)( byte address );
+typedef void (*Keypad_I2C_Unlock)( byte address, unsigned int transactions, unsigned int errors );
+
 class Keypad_I2C : public Keypad {
 public:
 	Keypad_I2C(char* userKeymap, byte* row, byte* col, byte numRows, byte numCols, byte address,
                byte width = 1, TwoWire * awire=&Wire ) 
-		: Keypad(userKeymap, row, col, numRows, numCols) { i2caddr=address; i2cwidth=width; _wire=awire; } 
+		: Keypad(userKeymap, row, col, numRows, numCols) { i2caddr=address; i2cwidth=width; _wire=awire;
+			scanMode=KEYPAD_I2C_SCAN_PORT; portValid=false; transactions=0; busMicros=0;
+			lastScanTransactions=0; lastScanMicros=0; colPinsI2C=col; numColsI2C=numCols; rowPinsI2C=row; numRowsI2C=numRows;
+			armed=false; scannedSinceArm=true; errors=0; busLock=NULL; busUnlock=NULL; lockDepth=0; lockOk=true; } 
 	
 
 	// Keypad function
@@ -66,6 +76,29 @@ public:
 	word pinState_set( );
 	// write a whole byte or word (depending on the port expander chip) to i2c port
 	void port_write( word i2cportval );
+	// read the whole byte or word from the i2c port
+	word port_read( );
+
+	// KEYPAD_I2C_SCAN_PORT (default) or KEYPAD_I2C_SCAN_PIN
+	void setScanMode( byte mode ) { scanMode=mode; portValid=false; }
+	// Keypad functions, wrapped to measure the bus cost of each scan
+	char getKey( );
+	bool getKeys( );
+	// interrupt mode: hold every column low so any key press pulls a row low and the
+	// expander asserts INT; the columns are released by the next getKey()/getKeys().
+	// Returns false if a key is already down, since that press will not raise INT
+	bool armInterrupt( );
+	// true once a scan since armInterrupt() has found no key in any state
+	bool keysIdle( );
+	// bus statistics: all transactions, and the transactions and bus time of the last scan
+	unsigned long getTransactions( ) { return transactions; }
+	unsigned long getBusMicros( ) { return busMicros; }
+	unsigned int getLastScanTransactions( ) { return lastScanTransactions; }
+	unsigned long getLastScanMicros( ) { return lastScanMicros; }
+	unsigned long getErrors( ) { return errors; }
+	// share the bus with other drivers: a whole scan runs under one lock. If the lock
+	// fails, the scan is skipped and reads return the idle (all high) port
+	void setBusHooks( Keypad_I2C_Lock lock, Keypad_I2C_Unlock unlock ) { busLock=lock; busUnlock=unlock; }
 
 private:
     // I2C device address
@@ -76,6 +109,33 @@ private:
 	// least significant byte is used for 8-bit port expanders
 	word pinState;
 	TwoWire *_wire;
+	// port mode: value read for the current column drive, valid until the next pin_write
+	byte scanMode;
+	boolean portValid;
+	word portValue;
+	unsigned long transactions;
+	unsigned long busMicros;
+	unsigned int lastScanTransactions;
+	unsigned long lastScanMicros;
+	unsigned long errors;
+	// bus arbitration
+	Keypad_I2C_Lock busLock;
+	Keypad_I2C_Unlock busUnlock;
+	byte lockDepth;
+	boolean lockOk;
+	unsigned long lockTransactions;
+	unsigned long lockErrors;
+	boolean busAcquire( );
+	void busRelease( );
+	// interrupt mode
+	byte *rowPinsI2C;
+	byte *colPinsI2C;
+	byte numRowsI2C;
+	byte numColsI2C;
+	boolean armed;
+	boolean scannedSinceArm;
+	void scanStart( );
+	void scanDone( unsigned long startTransactions, unsigned long startMicros );
 };
 
 
@@ -85,6 +145,9 @@ private:
 /*
 || @changelog
 || |
+|| | 3.1 2026-10-17 - port scan mode: one expander read per column, bus statistics,
+|| |                  INT pin wake support with armInterrupt( )/keysIdle( ),
+|| |                  bus lock hooks and error count
 || | 3.0 2020-04-06 - Joe Young : support multiple I2C port WireX objects in constructor
 || | 2.0 2013-08-31 - Paul Williamson : Added i2cwidth parameter for PCF8575 support
 || |
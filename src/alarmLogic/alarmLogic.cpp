@@ -0,0 +1,341 @@
+#include "alarmLogic.h"
+#include <stdio.h>
+#include <string.h>
+#include "../hal/hal.h"
+#include "../sensorReporter/sensorReporter.h"
+#include "../uidTable/uidTable.h"
+#include "../logger/logger.h"
+
+#define VIBRATION_THRESHOLD 4000
+#define VIBRATION_HYSTERESIS 300 // A hit ends once the window peak drops this far below the threshold
+#define VIBRATION_RMS_THRESHOLD 1000 // Window RMS a hit also needs, so a lone noisy sample is ignored
+#define VIBRATION_FALLBACK_SAMPLES 32 // ADC reads per pass without DMA; a lone spike is diluted across the window
+#define MOTION_DEBOUNCE_MS 100
+#define MAGNETIC_DEBOUNCE_MS 30
+#define SENSOR_HEARTBEAT_MS 60000 // Unchanged values are re-sent this often
+#define ACCESS_HOLD_MS 5000       // Door alarm stays disarmed this long after a card or PIN
+#define ACCESS_MESSAGE_MS 2000    // A rejected PIN's message shows this long before the next entry
+#define LCD_COLUMNS 16
+
+// Status flags, switched from the sensor_data table
+extern int sirenStatus;
+extern int rfidStatus;
+extern int keypadStatus;
+extern int vibrationStatus;
+extern int magneticStatus;
+extern int motionStatus;
+
+static AlarmPins pins;
+static const VibrationThresholds vibrationThresholds = {VIBRATION_THRESHOLD, VIBRATION_THRESHOLD - VIBRATION_HYSTERESIS,
+                                                        VIBRATION_RMS_THRESHOLD};
+
+// Report-by-exception state for each sensor
+static DigitalReporter motionReporter;
+static DigitalReporter magneticReporter;
+static DigitalReporter vibrationReporter;
+static VibrationDetector fallbackVibrationDetector; // Used when continuous sampling is unavailable
+
+// Access state; the two flags are written by the keypad pass and read by the sensor pass
+static volatile int rfidAccess = 0;
+static volatile int keypadAccess = 0;
+static bool isAccessGranted = false;
+static uint32_t lastKeypadAccessTime = 0;
+static uint32_t lastRfidAccessTime = 0;
+static uint32_t messageShownAt = 0;
+static bool messageShowing = false;
+static char keypadDigits[ALARM_PIN_MAX_DIGITS];
+static uint8_t keypadDigitCount = 0;
+
+void alarmLogicBegin(const AlarmPins &alarmPins)
+{
+  pins = alarmPins;
+  digitalReporterInit(motionReporter, MOTION_DEBOUNCE_MS, SENSOR_HEARTBEAT_MS);
+  digitalReporterInit(magneticReporter, MAGNETIC_DEBOUNCE_MS, SENSOR_HEARTBEAT_MS);
+  digitalReporterInit(vibrationReporter, 0, SENSOR_HEARTBEAT_MS);
+  vibrationDetectorInit(fallbackVibrationDetector, vibrationThresholds);
+}
+
+VibrationThresholds alarmVibrationThresholds()
+{
+  return vibrationThresholds;
+}
+
+static void updateMotion(int level, uint32_t now)
+{
+  ReportReason reason = digitalReporterUpdate(motionReporter, level, now);
+  if (reason == REPORT_CHANGE)
+  {
+    LOG_INFO(LOG_SENSORS, motionReporter.stableLevel == 1 ? "Motion detected" : "Motion stopped");
+  }
+  if (reason != REPORT_NONE)
+  {
+    halBackendSend(TELEMETRY_MOTION, motionReporter.stableLevel == 1 ? 1 : 0, false);
+  }
+}
+
+static void updateMagnetic(int level, uint32_t now)
+{
+  ReportReason reason = digitalReporterUpdate(magneticReporter, level, now);
+  if (reason == REPORT_CHANGE)
+  {
+    LOG_INFO(LOG_SENSORS, "Magnetic value: %d - Door is %s!", level, magneticReporter.stableLevel == 1 ? "open" : "closed");
+  }
+  if (reason != REPORT_NONE)
+  {
+    halBackendSend(TELEMETRY_MAGNETIC, magneticReporter.stableLevel == 1 ? 1 : 0, magneticReporter.stableLevel == 1);
+  }
+}
+
+// The door sensor stands down while someone who just identified themselves opens it
+static bool doorArmed()
+{
+  return magneticStatus && !rfidAccess && !keypadAccess;
+}
+
+void alarmSensorEdge(uint8_t pin, int level, uint32_t at)
+{
+  if (pin == pins.motion && motionStatus)
+  {
+    updateMotion(level, at);
+  }
+  else if (pin == pins.magnetic && doorArmed())
+  {
+    updateMagnetic(level, at);
+  }
+}
+
+AlarmReadings alarmSensorsStep(const AlarmVibration *vibration)
+{
+  AlarmReadings readings = {0, 0, 0, false};
+
+  // The current level is read every pass; it closes debounce windows and covers missed edges
+  readings.motion = halDigitalRead(pins.motion);
+  readings.magnetic = halDigitalRead(pins.magnetic);
+
+  if (motionStatus)
+  {
+    updateMotion(readings.motion, halMillis());
+  }
+  else
+  {
+    LOG_DEBUG(LOG_SENSORS, "MOTION is turned OFF");
+  }
+
+  if (vibrationStatus)
+  {
+    bool hit;
+    if (vibration != NULL)
+    {
+      hit = vibration->hit;
+      readings.vibration = vibration->peak;
+    }
+    else
+    {
+      uint16_t samples[VIBRATION_FALLBACK_SAMPLES];
+      for (int i = 0; i < VIBRATION_FALLBACK_SAMPLES; i++)
+      {
+        samples[i] = halAnalogRead(pins.vibration);
+      }
+      hit = vibrationDetectorUpdate(fallbackVibrationDetector, samples, VIBRATION_FALLBACK_SAMPLES);
+      readings.vibration = fallbackVibrationDetector.block.peak;
+    }
+    // The windowed peak and RMS decide, so a single noisy sample does not sound the siren
+    readings.alarm = hit;
+    ReportReason reason = digitalReporterUpdate(vibrationReporter, hit ? 1 : 0, halMillis());
+    if (reason == REPORT_CHANGE)
+    {
+      LOG_INFO(LOG_SENSORS, "Vibration amplitude: %d%s", readings.vibration, hit ? " - that's a hit!" : "");
+    }
+    if (reason != REPORT_NONE)
+    {
+      halBackendSend(TELEMETRY_VIBRATION, vibrationReporter.stableLevel, vibrationReporter.stableLevel == 1);
+    }
+  }
+  else
+  {
+    LOG_DEBUG(LOG_SENSORS, "VIBRATION is turned OFF");
+  }
+
+  if (!magneticStatus)
+  {
+    LOG_DEBUG(LOG_SENSORS, "MAGNETIC is turned OFF");
+  }
+  if (doorArmed())
+  {
+    // The door sensor decides the alarm whenever it is armed, as it did when both wrote the pin
+    readings.alarm = readings.magnetic == 1;
+    updateMagnetic(readings.magnetic, halMillis());
+  }
+
+  // The alarm preempts a welcome melody and repeats until the condition clears
+  halSiren(sirenStatus && readings.alarm);
+  return readings;
+}
+
+bool alarmSensorsDebouncing()
+{
+  return motionReporter.candidateLevel != motionReporter.stableLevel ||
+         magneticReporter.candidateLevel != magneticReporter.stableLevel;
+}
+
+static void clearKeypadDigits()
+{
+  memset(keypadDigits, 0, sizeof(keypadDigits));
+  keypadDigitCount = 0;
+}
+
+static void showPrompt()
+{
+  char stars[LCD_COLUMNS + 1];
+  int count = keypadDigitCount < LCD_COLUMNS ? keypadDigitCount : LCD_COLUMNS;
+  memset(stars, '*', count); // Display '*' for each key pressed
+  stars[count] = '\0';
+  halDisplay("Enter password:", stars);
+}
+
+static void grantAccess()
+{
+  halDisplay("Access granted", "");
+  isAccessGranted = true;
+  halChime();
+}
+
+static void resetAccess()
+{
+  if (isAccessGranted)
+  {
+    clearKeypadDigits();
+    showPrompt();
+    isAccessGranted = false;
+  }
+}
+
+static void handleKey(char key)
+{
+  LOG_DEBUG(LOG_KEYPAD, "Key Pressed: %c", key);
+  if (key == '#') // Submit password
+  {
+    LOG_INFO(LOG_KEYPAD, "Entered %u digits", keypadDigitCount);
+    int userId = -1;
+    HalPinResult result = halCheckPin(keypadDigits, keypadDigitCount, userId);
+    if (result == HAL_PIN_ACCEPTED)
+    {
+      LOG_INFO(LOG_KEYPAD, "Keypad user %d", userId);
+      keypadAccess = 1;
+      lastKeypadAccessTime = halMillis();
+      grantAccess();
+      halBackendSend(TELEMETRY_KEYPAD, 1, false);
+    }
+    else
+    {
+      keypadAccess = 1;
+      if (result == HAL_PIN_LOCKED_OUT)
+      {
+        halDisplay("Keypad locked", "Try again later");
+      }
+      else
+      {
+        halDisplay("Incorrect", "password");
+      }
+      messageShowing = true;
+      messageShownAt = halMillis();
+    }
+    clearKeypadDigits();
+  }
+  else if (key == '*')
+  {
+    clearKeypadDigits();
+    showPrompt();
+  }
+  else if (keypadDigitCount < ALARM_PIN_MAX_DIGITS)
+  {
+    keypadDigits[keypadDigitCount++] = key;
+    halDisplayAt(keypadDigitCount - 1, 1, "*");
+  }
+}
+
+static void handleCard(const uint8_t *uid, uint8_t length)
+{
+  char hex[2 * UID_MAX_LENGTH + 1];
+  for (uint8_t i = 0; i < length; i++)
+  {
+    snprintf(&hex[i * 2], 3, "%02X", uid[i]);
+  }
+  hex[length * 2] = '\0';
+  if (halCheckCard(uid, length))
+  {
+    LOG_INFO(LOG_RFID, "UID tag %s: Authorized access", logCopy(hex));
+    rfidAccess = 1;
+    lastRfidAccessTime = halMillis();
+    grantAccess();
+    halBackendSend(TELEMETRY_RFID, 1, false);
+  }
+  else
+  {
+    LOG_WARN(LOG_RFID, "UID tag %s: Access denied", logCopy(hex));
+    rfidAccess = 1;
+    halBackendSend(TELEMETRY_RFID, 0, false);
+  }
+}
+
+void alarmAccessBegin()
+{
+  rfidAccess = 0;
+  keypadAccess = 0;
+  isAccessGranted = false;
+  messageShowing = false;
+  clearKeypadDigits();
+  showPrompt();
+}
+
+void alarmAccessStep(char key)
+{
+  // A rejected PIN's message holds the keypad and the reader, as the blocking delay did
+  if (messageShowing)
+  {
+    if (halMillis() - messageShownAt < ACCESS_MESSAGE_MS)
+    {
+      return;
+    }
+    messageShowing = false;
+    showPrompt();
+  }
+
+  if (!keypadStatus)
+  {
+    LOG_DEBUG(LOG_KEYPAD, "KEYPAD is turned OFF");
+  }
+  if (keypadStatus && key)
+  {
+    handleKey(key);
+    if (messageShowing)
+    {
+      return;
+    }
+  }
+
+  if (!rfidStatus)
+  {
+    LOG_DEBUG(LOG_RFID, "RFID is turned OFF");
+  }
+  uint8_t uid[UID_MAX_LENGTH];
+  uint8_t length = 0;
+  if (rfidStatus && halRfidRead(uid, length))
+  {
+    handleCard(uid, length);
+  }
+
+  // Access ends, and the door re-arms, 5 seconds after the card or PIN
+  if (keypadAccess && halMillis() - lastKeypadAccessTime >= ACCESS_HOLD_MS)
+  {
+    keypadAccess = 0;
+    halBackendSend(TELEMETRY_KEYPAD, 0, false);
+    resetAccess();
+  }
+  if (rfidAccess && halMillis() - lastRfidAccessTime >= ACCESS_HOLD_MS)
+  {
+    rfidAccess = 0;
+    halBackendSend(TELEMETRY_RFID, 0, false);
+    resetAccess();
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef ALARM_LOGIC_H
+#define ALARM_LOGIC_H
+
+// Reaches the hardware only through the HAL, so the device and the native simulator make the same decisions
+
+#include <stdint.h>
+#include "../vibrationKernel/vibrationKernel.h"
+
+#define ALARM_SENSOR_LOOP_MS 50
+#define ALARM_DEBOUNCE_POLL_MS 10 // Sensor pass period while a debounce window is open
+#define ALARM_ACCESS_LOOP_MS 50   // Keypad pass period while the keypad sleeps; RFID is polled at this rate
+#define ALARM_PIN_MAX_DIGITS 8
+
+struct AlarmPins
+{
+  uint8_t motion;
+  uint8_t magnetic;
+  uint8_t vibration;
+};
+
+// A vibration decision made elsewhere, e.g. by the DMA sampler task
+struct AlarmVibration
+{
+  bool hit;
+  uint16_t peak;
+};
+
+// What one sensor pass read and decided
+struct AlarmReadings
+{
+  int motion;
+  int magnetic;
+  int vibration;
+  bool alarm;
+};
+
+void alarmLogicBegin(const AlarmPins &pins);
+VibrationThresholds alarmVibrationThresholds();
+
+// A motion or door edge captured at the time it happened
+void alarmSensorEdge(uint8_t pin, int level, uint32_t at);
+// One pass of the sensor task: reads motion and door levels, decides the alarm and drives the siren.
+// vibration is NULL to read a short block from the ADC each pass through the fallback detector
+AlarmReadings alarmSensorsStep(const AlarmVibration *vibration);
+// True while a debounce window is open, so the next pass should come sooner
+bool alarmSensorsDebouncing();
+
+// One pass of the keypad task: handles key (0 for none), polls the RFID reader and ends access
+// after its timeout. Begin starts with the door armed and the password prompt shown
+void alarmAccessBegin();
+void alarmAccessStep(char key);
+
+#endif
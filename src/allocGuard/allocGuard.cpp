@@ -0,0 +1,130 @@
+#include "allocGuard.h"
+#include "../jsonArena/jsonArena.h"
+
+static volatile bool armed = false;
+static uint32_t armedFreeHeap = 0;
+static uint32_t armedLargestBlock = 0;
+
+#ifdef NO_ALLOC_AFTER_BOOT
+// The linker sends every malloc, calloc and realloc here (-Wl,--wrap=...), including the
+// ones behind new, String and the Arduino core. Nothing in here may allocate itself
+static portMUX_TYPE guardMux = portMUX_INITIALIZER_UNLOCKED;
+static AllocGuardCaller callers[ALLOC_GUARD_CALLERS];
+static uint32_t allocations = 0;
+static uint32_t bytes = 0;
+static uint32_t otherCallers = 0;
+
+static void record(size_t size, void *caller)
+{
+  portENTER_CRITICAL_SAFE(&guardMux);
+  allocations++;
+  bytes += size;
+  int i = 0;
+  while (i < ALLOC_GUARD_CALLERS && callers[i].address != NULL && callers[i].address != caller)
+  {
+    i++;
+  }
+  if (i == ALLOC_GUARD_CALLERS)
+  {
+    otherCallers++;
+  }
+  else
+  {
+    callers[i].address = caller;
+    callers[i].count++;
+  }
+  portEXIT_CRITICAL_SAFE(&guardMux);
+}
+
+extern "C"
+{
+  void *__real_malloc(size_t size);
+  void *__real_calloc(size_t count, size_t size);
+  void *__real_realloc(void *pointer, size_t size);
+
+  void *__wrap_malloc(size_t size)
+  {
+    if (armed)
+    {
+      record(size, __builtin_return_address(0));
+    }
+    return __real_malloc(size);
+  }
+
+  void *__wrap_calloc(size_t count, size_t size)
+  {
+    if (armed)
+    {
+      record(count * size, __builtin_return_address(0));
+    }
+    return __real_calloc(count, size);
+  }
+
+  void *__wrap_realloc(void *pointer, size_t size)
+  {
+    if (armed)
+    {
+      record(size, __builtin_return_address(0));
+    }
+    return __real_realloc(pointer, size);
+  }
+}
+#endif
+
+void allocGuardArm()
+{
+  armedFreeHeap = esp_get_free_heap_size();
+  armedLargestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  armed = true;
+}
+
+AllocGuardStats allocGuardStats()
+{
+  AllocGuardStats stats = {};
+  stats.armed = armed;
+  stats.freeHeap = esp_get_free_heap_size();
+  stats.minFreeHeap = esp_get_minimum_free_heap_size();
+  stats.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  if (armed)
+  {
+    stats.freeHeapChange = (int32_t)(stats.freeHeap - armedFreeHeap);
+    stats.largestBlockChange = (int32_t)(stats.largestBlock - armedLargestBlock);
+  }
+#ifdef NO_ALLOC_AFTER_BOOT
+  portENTER_CRITICAL(&guardMux);
+  stats.counting = true;
+  stats.allocations = allocations;
+  stats.bytes = bytes;
+  stats.otherCallers = otherCallers;
+  portEXIT_CRITICAL(&guardMux);
+#endif
+  return stats;
+}
+
+void allocGuardPrintStats(Print &out)
+{
+  AllocGuardStats s = allocGuardStats();
+  out.printf("Heap: %u free (%+d since boot), largest block %u (%+d), minimum %u, JSON arena high water %u/%u\n",
+             s.freeHeap, s.freeHeapChange, s.largestBlock, s.largestBlockChange, s.minFreeHeap,
+             (unsigned)jsonArenaHighWater(), (unsigned)JSON_ARENA_BYTES);
+  if (!s.counting)
+  {
+    return;
+  }
+  out.printf("Allocations after boot: %u (%u bytes)\n", s.allocations, s.bytes);
+#ifdef NO_ALLOC_AFTER_BOOT
+  // Copy the table out first; printing may itself allocate and would deadlock in here
+  AllocGuardCaller snapshot[ALLOC_GUARD_CALLERS];
+  portENTER_CRITICAL(&guardMux);
+  memcpy(snapshot, callers, sizeof(snapshot));
+  portEXIT_CRITICAL(&guardMux);
+  for (int i = 0; i < ALLOC_GUARD_CALLERS && snapshot[i].address != NULL; i++)
+  {
+    out.printf("  caller %p: %u\n", snapshot[i].address, snapshot[i].count);
+  }
+  if (s.otherCallers > 0)
+  {
+    out.printf("  other callers: %u\n", s.otherCallers);
+  }
+#endif
+}
@@ -0,0 +1,34 @@
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+
+#include <Arduino.h>
+
+#define ALLOC_GUARD_CALLERS 8 // Distinct call sites remembered; the rest are only counted
+
+struct AllocGuardCaller
+{
+  void *address;
+  uint32_t count;
+};
+
+struct AllocGuardStats
+{
+  bool armed;
+  bool counting; // false unless built with NO_ALLOC_AFTER_BOOT
+  uint32_t allocations; // malloc, calloc and realloc calls since arming
+  uint32_t bytes;
+  uint32_t otherCallers; // Allocations from call sites past the first ALLOC_GUARD_CALLERS
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;
+  uint32_t largestBlock;
+  int32_t freeHeapChange; // Since arming
+  int32_t largestBlockChange;
+};
+
+// Call once setup() is done; allocations after this point count as steady-state ones
+void allocGuardArm();
+AllocGuardStats allocGuardStats();
+// Soak test report: heap size and fragmentation drift, plus where any allocations came from
+void allocGuardPrintStats(Print &out);
+
+#endif
@@ -0,0 +1,54 @@
+#include "bootProfile.h"
+
+static const char *phaseNames[BOOT_PHASE_COUNT] = {"logging", "peripherals", "armed", "setup", "wifi", "online"};
+static volatile uint32_t phaseTimes[BOOT_PHASE_COUNT];
+static volatile bool phaseReached[BOOT_PHASE_COUNT];
+static portMUX_TYPE bootMux = portMUX_INITIALIZER_UNLOCKED;
+
+void bootProfileMark(BootPhase phase)
+{
+  // millis() counts from the start of the application, so the bootloader is not included
+  uint32_t now = millis();
+  portENTER_CRITICAL(&bootMux);
+  if (!phaseReached[phase])
+  {
+    phaseTimes[phase] = now;
+    phaseReached[phase] = true;
+  }
+  portEXIT_CRITICAL(&bootMux);
+}
+
+uint32_t bootProfileTime(BootPhase phase)
+{
+  return phaseReached[phase] ? phaseTimes[phase] : 0;
+}
+
+bool bootProfileReached(BootPhase phase)
+{
+  return phaseReached[phase];
+}
+
+void bootProfilePrint(Print &out)
+{
+  out.print("Boot:");
+  uint32_t previous = 0;
+  for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+  {
+    if (!phaseReached[i])
+    {
+      out.printf(" %s pending", phaseNames[i]);
+      continue;
+    }
+    // Local phases follow each other, so the step shows what each one cost
+    out.printf(" %s %u ms (+%u)", phaseNames[i], phaseTimes[i], phaseTimes[i] - previous);
+    previous = phaseTimes[i];
+  }
+  out.println();
+  out.printf("Boot: time to armed %u ms, time to online %s", bootProfileTime(BOOT_PHASE_ARMED),
+             phaseReached[BOOT_PHASE_ONLINE] ? "" : "pending");
+  if (phaseReached[BOOT_PHASE_ONLINE])
+  {
+    out.printf("%u ms", phaseTimes[BOOT_PHASE_ONLINE]);
+  }
+  out.println();
+}
@@ -0,0 +1,25 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <Arduino.h>
+
+// In the order they are expected; the network phases run in the background and may come late
+enum BootPhase
+{
+  BOOT_PHASE_LOGGING,     // Serial, logger, metrics and task monitor up
+  BOOT_PHASE_PERIPHERALS, // Pins, buses, RFID, LCD, keypad and the local stores ready
+  BOOT_PHASE_ARMED,       // Sensor and keypad tasks running; the door is protected from here
+  BOOT_PHASE_SETUP_DONE,  // setup() returned with the network tasks started
+  BOOT_PHASE_WIFI,        // First WiFi link with an address
+  BOOT_PHASE_ONLINE,      // First valid Supabase session
+  BOOT_PHASE_COUNT
+};
+
+// Records millis() for the phase the first time it is reached; later calls are ignored
+void bootProfileMark(BootPhase phase);
+uint32_t bootProfileTime(BootPhase phase); // 0 until reached
+bool bootProfileReached(BootPhase phase);
+
+void bootProfilePrint(Print &out);
+
+#endif
@@ -0,0 +1,214 @@
+#include "buzzer.h"
+#include "../taskMonitor/taskMonitor.h"
+
+#define BUZZER_QUEUE_LENGTH 8
+#define BUZZER_TASK_STACK 2048
+#define BUZZER_TASK_PRIORITY 3 // Above the keypad and sensor tasks so note changes stay on time
+#define BUZZER_LEDC_RESOLUTION 8
+
+struct BuzzerCommand
+{
+  const BuzzerNote *notes; // NULL stops the pattern at this priority
+  uint8_t count;
+  uint8_t priority;
+  bool loop;
+};
+
+static uint8_t channel = 0;
+static QueueHandle_t buzzerQueue = NULL;
+
+// Owned by the buzzer task; playing and playingPriority are also read by callers to skip repeats
+static volatile const BuzzerNote *playing = NULL;
+static volatile uint8_t playingPriority = BUZZER_PRIORITY_MELODY;
+static uint8_t playingCount = 0;
+static bool playingLoop = false;
+static uint8_t noteIndex = 0;
+static unsigned long noteStartMicros = 0;
+static uint32_t noteDurationMicros = 0;
+
+static BuzzerStats stats;
+static portMUX_TYPE buzzerMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void startNote()
+{
+  const BuzzerNote &note = ((const BuzzerNote *)playing)[noteIndex];
+  ledcWriteTone(channel, note.frequency); // 0 sets the duty to 0, which is silence
+  noteStartMicros = micros();
+  noteDurationMicros = (uint32_t)note.durationMs * 1000;
+  portENTER_CRITICAL(&buzzerMux);
+  stats.notes++;
+  portEXIT_CRITICAL(&buzzerMux);
+}
+
+static void silence()
+{
+  ledcWriteTone(channel, 0);
+  playing = NULL;
+}
+
+static void handleCommand(const BuzzerCommand &command)
+{
+  if (command.notes == NULL)
+  {
+    if (playing != NULL && playingPriority == command.priority)
+    {
+      silence();
+    }
+    return;
+  }
+
+  if (playing != NULL)
+  {
+    if (command.priority < playingPriority)
+    {
+      portENTER_CRITICAL(&buzzerMux);
+      stats.rejected++;
+      portEXIT_CRITICAL(&buzzerMux);
+      return;
+    }
+    if (playing == command.notes && playingLoop && command.loop)
+    {
+      return; // Already repeating this pattern
+    }
+    if (command.priority > playingPriority)
+    {
+      portENTER_CRITICAL(&buzzerMux);
+      stats.preempted++;
+      portEXIT_CRITICAL(&buzzerMux);
+    }
+  }
+
+  playingPriority = command.priority;
+  playingCount = command.count;
+  playingLoop = command.loop;
+  noteIndex = 0;
+  playing = command.notes;
+  portENTER_CRITICAL(&buzzerMux);
+  stats.started++;
+  portEXIT_CRITICAL(&buzzerMux);
+  startNote();
+}
+
+static void nextNote()
+{
+  // Only called once the note is due, but clamp anyway so an early wake cannot wrap
+  int32_t late = (int32_t)(micros() - noteStartMicros - noteDurationMicros);
+  portENTER_CRITICAL(&buzzerMux);
+  if (late > 0 && (uint32_t)late > stats.maxLateMicros)
+  {
+    stats.maxLateMicros = late;
+  }
+  portEXIT_CRITICAL(&buzzerMux);
+
+  if (++noteIndex >= playingCount)
+  {
+    if (!playingLoop)
+    {
+      silence();
+      return;
+    }
+    noteIndex = 0;
+  }
+  startNote();
+}
+
+static void buzzerTask(void *pvParameters)
+{
+  BuzzerCommand command;
+  while (true)
+  {
+    // Sleep until the current note ends or a request arrives. The wait is rounded up to whole
+    // ticks, so the task never wakes before the note is due
+    TickType_t wait = portMAX_DELAY;
+    if (playing != NULL)
+    {
+      uint32_t elapsed = micros() - noteStartMicros;
+      uint32_t tickMicros = portTICK_PERIOD_MS * 1000;
+      wait = elapsed >= noteDurationMicros ? 0 : (noteDurationMicros - elapsed + tickMicros - 1) / tickMicros;
+    }
+
+    if (xQueueReceive(buzzerQueue, &command, wait) == pdTRUE)
+    {
+      handleCommand(command);
+    }
+    else if (playing != NULL && micros() - noteStartMicros >= noteDurationMicros)
+    {
+      nextNote();
+    }
+  }
+}
+
+bool buzzerBegin(int pin, uint8_t ledcChannel)
+{
+  channel = ledcChannel;
+  ledcSetup(channel, 2000, BUZZER_LEDC_RESOLUTION);
+  ledcAttachPin(pin, channel);
+  ledcWriteTone(channel, 0);
+
+  buzzerQueue = xQueueCreate(BUZZER_QUEUE_LENGTH, sizeof(BuzzerCommand));
+  if (buzzerQueue == NULL)
+  {
+    Serial.println("Failed to create buzzer queue");
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(buzzerTask, "Buzzer", BUZZER_TASK_STACK, NULL, BUZZER_TASK_PRIORITY, NULL, TASK_CORE_IO) != pdPASS)
+  {
+    Serial.println("Failed to create Buzzer task");
+    return false;
+  }
+  return true;
+}
+
+static bool queueCommand(const BuzzerCommand &command)
+{
+  if (buzzerQueue == NULL)
+  {
+    return false;
+  }
+  if (xQueueSend(buzzerQueue, &command, 0) != pdTRUE)
+  {
+    portENTER_CRITICAL(&buzzerMux);
+    stats.droppedRequests++;
+    portEXIT_CRITICAL(&buzzerMux);
+    return false;
+  }
+  return true;
+}
+
+bool buzzerPlay(const BuzzerNote *notes, uint8_t count, BuzzerPriority priority, bool loop)
+{
+  if (notes == NULL || count == 0)
+  {
+    return false;
+  }
+  // Callers that re-assert an alarm every loop would otherwise fill the queue
+  if (loop && playing == notes && playingPriority == priority)
+  {
+    return true;
+  }
+  BuzzerCommand command = {notes, count, (uint8_t)priority, loop};
+  return queueCommand(command);
+}
+
+void buzzerStop(BuzzerPriority priority)
+{
+  if (playing == NULL || playingPriority != priority)
+  {
+    return;
+  }
+  BuzzerCommand command = {NULL, 0, (uint8_t)priority, false};
+  queueCommand(command);
+}
+
+bool buzzerBusy()
+{
+  return playing != NULL;
+}
+
+BuzzerStats buzzerStats()
+{
+  portENTER_CRITICAL(&buzzerMux);
+  BuzzerStats copy = stats;
+  portEXIT_CRITICAL(&buzzerMux);
+  return copy;
+}
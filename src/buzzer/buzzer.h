@@ -0,0 +1,42 @@
+#ifndef BUZZER_H
+#define BUZZER_H
+
+#include <Arduino.h>
+
+// One step of a pattern; a frequency of 0 is a rest
+struct BuzzerNote
+{
+  uint16_t frequency;
+  uint16_t durationMs;
+};
+
+// A pattern replaces the one playing only if its priority is the same or higher
+enum BuzzerPriority
+{
+  BUZZER_PRIORITY_MELODY,
+  BUZZER_PRIORITY_ALARM
+};
+
+struct BuzzerStats
+{
+  uint32_t started;
+  uint32_t preempted;       // patterns cut short by a higher priority one
+  uint32_t rejected;        // requests ignored because a higher priority pattern was playing
+  uint32_t notes;
+  uint32_t maxLateMicros;   // worst delay of a note change past its scheduled time
+  uint32_t droppedRequests; // the request queue stayed full
+};
+
+// The tone comes from an LEDC channel; a buzzer task only wakes to change notes
+bool buzzerBegin(int pin, uint8_t ledcChannel);
+
+// Any task may call these; they queue the request and return.
+// notes must stay valid while the pattern plays; loop repeats it until buzzerStop()
+bool buzzerPlay(const BuzzerNote *notes, uint8_t count, BuzzerPriority priority, bool loop = false);
+// Silences the pattern playing at this priority, if there is one
+void buzzerStop(BuzzerPriority priority);
+bool buzzerBusy();
+
+BuzzerStats buzzerStats();
+
+#endif
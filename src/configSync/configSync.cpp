@@ -0,0 +1,355 @@
+#include "configSync.h"
+#include <Preferences.h>
+#include <sys/time.h>
+#include "../sendToSupabaseRead/sendToSupabaseRead.h"
+#include "../logger/logger.h"
+
+#define CONFIG_NVS_NAMESPACE "config"
+#define CONFIG_PATH_BYTES 192
+#define CONFIG_CLOCK_VALID 1600000000 // Earlier than this, SNTP has not set the clock yet
+
+extern const char *table;
+
+static ConfigFlag *flags = NULL;
+static int flagCount = 0;
+static char stamp[CONFIG_STAMP_BYTES]; // updated_at of the newest row applied
+static char appliedAt[CONFIG_MAX_FLAGS][CONFIG_STAMP_BYTES]; // Per flag, so an older row never undoes a newer one
+static char pendingAt[CONFIG_MAX_FLAGS][CONFIG_STAMP_BYTES];
+static bool pendingSet[CONFIG_MAX_FLAGS];
+static char path[CONFIG_PATH_BYTES];
+static SemaphoreHandle_t configMutex = NULL; // Polls and pushed events come from different tasks
+static ConfigSyncStats stats = {false, true};
+
+static int findFlag(const char *name)
+{
+  for (int i = 0; i < flagCount; i++)
+  {
+    if (strcmp(flags[i].name, name) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void copyStamp(char *out, const char *value)
+{
+  strncpy(out, value ? value : "", CONFIG_STAMP_BYTES - 1);
+  out[CONFIG_STAMP_BYTES - 1] = '\0';
+}
+
+// Timestamps from PostgREST and Realtime share one format, so they order as strings. A row
+// without one (full reads of a table with no updated_at) always applies
+static bool isNewer(const char *updatedAt, const char *applied)
+{
+  return !updatedAt[0] || !applied[0] || strcmp(updatedAt, applied) > 0;
+}
+
+static int64_t daysFromCivil(int year, int month, int day)
+{
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int yearOfEra = year - era * 400;
+  int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+// Parses e.g. 2024-05-01T12:34:56.123456+00:00 (or with a space, Z or no offset) into Unix ms
+static bool parseTimestamp(const char *text, int64_t &ms)
+{
+  int year, month, day, hour, minute, second;
+  if (sscanf(text, "%4d-%2d-%2d%*c%2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second) != 6 ||
+      strlen(text) < 19)
+  {
+    return false;
+  }
+  const char *c = text + 19;
+  int fraction = 0;
+  int digits = 0;
+  if (*c == '.')
+  {
+    for (c++; isdigit((unsigned char)*c); c++)
+    {
+      if (digits < 3)
+      {
+        fraction = fraction * 10 + (*c - '0');
+        digits++;
+      }
+    }
+  }
+  while (digits++ < 3)
+  {
+    fraction *= 10;
+  }
+  int offsetMinutes = 0;
+  if (*c == '+' || *c == '-')
+  {
+    int offsetHours = 0;
+    int offsetRest = 0;
+    sscanf(c + 1, "%2d:%2d", &offsetHours, &offsetRest);
+    offsetMinutes = (*c == '-' ? -1 : 1) * (offsetHours * 60 + offsetRest);
+  }
+  int64_t seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offsetMinutes * 60;
+  ms = seconds * 1000 + fraction;
+  return true;
+}
+
+// Commit (updated_at) to applied, by the wall clock; skipped until SNTP has set it
+static void recordLatency(ConfigLatency &latency, const char *updatedAt)
+{
+  int64_t committed;
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (now.tv_sec < CONFIG_CLOCK_VALID || !parseTimestamp(updatedAt, committed))
+  {
+    return;
+  }
+  int64_t elapsed = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000 - committed;
+  uint32_t ms = elapsed > 0 ? elapsed : 0;
+  latency.count++;
+  latency.lastMs = ms;
+  latency.totalMs += ms;
+  if (ms > latency.maxMs)
+  {
+    latency.maxMs = ms;
+  }
+}
+
+static void save()
+{
+  Preferences prefs;
+  if (!prefs.begin(CONFIG_NVS_NAMESPACE, false))
+  {
+    LOG_ERROR(LOG_MAIN, "Failed to open config cache in NVS");
+    return;
+  }
+  // Only the flags that differ are written, so a new stamp alone costs one entry
+  for (int i = 0; i < flagCount; i++)
+  {
+    uint8_t value = *flags[i].value ? 1 : 0;
+    if (prefs.getUChar(flags[i].name, 2) != value)
+    {
+      prefs.putUChar(flags[i].name, value);
+    }
+  }
+  prefs.putString("stamp", stamp);
+  prefs.end();
+  stats.saves++;
+}
+
+bool configSyncBegin(ConfigFlag *configFlags, int count)
+{
+  flags = configFlags;
+  flagCount = count < CONFIG_MAX_FLAGS ? count : CONFIG_MAX_FLAGS;
+  configMutex = xSemaphoreCreateMutex();
+
+  Preferences prefs;
+  if (!prefs.begin(CONFIG_NVS_NAMESPACE, true))
+  {
+    return false;
+  }
+  prefs.getString("stamp", stamp, sizeof(stamp));
+  int found = 0;
+  for (int i = 0; i < flagCount; i++)
+  {
+    if (prefs.isKey(flags[i].name))
+    {
+      *flags[i].value = prefs.getUChar(flags[i].name, 1);
+      found++;
+    }
+  }
+  prefs.end();
+
+  // A flag missing from the cache keeps its default, and the full read that follows fills it in
+  if (found < flagCount)
+  {
+    stamp[0] = '\0';
+  }
+  stats.restored = found > 0;
+  return stats.restored;
+}
+
+// The stamp's '+' must not reach the server as a space
+static size_t appendStamp(size_t length, const char *value)
+{
+  for (const char *c = value; *c && length < sizeof(path) - 4; c++)
+  {
+    if (*c == '+')
+    {
+      length += snprintf(&path[length], sizeof(path) - length, "%%2B");
+    }
+    else
+    {
+      path[length++] = *c;
+    }
+  }
+  path[length] = '\0';
+  return length;
+}
+
+int configSyncPoll()
+{
+  stats.polls++;
+  char since[CONFIG_STAMP_BYTES];
+  xSemaphoreTake(configMutex, portMAX_DELAY);
+  copyStamp(since, stamp);
+  xSemaphoreGive(configMutex);
+
+  size_t length;
+  if (stats.incremental)
+  {
+    length = snprintf(path, sizeof(path), "/rest/v1/%s?select=name,status,updated_at&order=updated_at.asc", table);
+    if (since[0])
+    {
+      length += snprintf(&path[length], sizeof(path) - length, "&updated_at=gt.");
+      appendStamp(length, since);
+    }
+  }
+  else
+  {
+    snprintf(path, sizeof(path), "/rest/v1/%s?select=name,status", table);
+  }
+
+  // Rows missing from the response keep their state
+  for (int i = 0; i < flagCount; i++)
+  {
+    pendingSet[i] = false;
+  }
+
+  char newest[CONFIG_STAMP_BYTES];
+  copyStamp(newest, since);
+  const char *fields[] = {"name", "status", "updated_at"};
+  SupabaseRows rows(path, fields, stats.incremental ? 3 : 2);
+  while (rows.next())
+  {
+    JsonObjectConst row = rows.row();
+    const char *name = row["name"];
+    const char *status = row["status"];
+    const char *updatedAt = row["updated_at"];
+    if (updatedAt != NULL)
+    {
+      // Rows come oldest first, so the last one carries the new stamp
+      copyStamp(newest, updatedAt);
+    }
+    int i = name ? findFlag(name) : -1;
+    if (i >= 0 && status != NULL)
+    {
+      flags[i].pending = strcmp(status, "on") == 0 ? 1 : 0;
+      copyStamp(pendingAt[i], updatedAt);
+      pendingSet[i] = true;
+    }
+  }
+
+  if (rows.failed())
+  {
+    stats.failures++;
+    if (rows.status() == 400 && stats.incremental)
+    {
+      // PostgREST rejects the filter when the column does not exist
+      LOG_WARN(LOG_MAIN, "%s has no updated_at column; reading every row instead", table);
+      stats.incremental = false;
+      xSemaphoreTake(configMutex, portMAX_DELAY);
+      stamp[0] = '\0';
+      xSemaphoreGive(configMutex);
+    }
+    return -1;
+  }
+  stats.rows += rows.count();
+
+  // Apply every flag at once so a refresh never leaves the device half configured
+  xSemaphoreTake(configMutex, portMAX_DELAY);
+  int changes = 0;
+  for (int i = 0; i < flagCount; i++)
+  {
+    if (!pendingSet[i] || !isNewer(pendingAt[i], appliedAt[i]))
+    {
+      continue;
+    }
+    copyStamp(appliedAt[i], pendingAt[i]);
+    if (since[0])
+    {
+      // Without a stamp this is the first read, and the rows are as old as their last change
+      recordLatency(stats.poll, pendingAt[i]);
+    }
+    if (*flags[i].value != flags[i].pending)
+    {
+      *flags[i].value = flags[i].pending;
+      changes++;
+    }
+  }
+  stats.changes += changes;
+
+  bool stampChanged = newest[0] && strcmp(newest, stamp) > 0;
+  if (stampChanged)
+  {
+    copyStamp(stamp, newest);
+  }
+  if (changes > 0 || stampChanged)
+  {
+    save();
+  }
+  xSemaphoreGive(configMutex);
+  return rows.count();
+}
+
+bool configSyncApply(const char *name, const char *status, const char *updatedAt)
+{
+  int i = name ? findFlag(name) : -1;
+  if (i < 0 || status == NULL)
+  {
+    return false;
+  }
+  int value = strcmp(status, "on") == 0 ? 1 : 0;
+  char at[CONFIG_STAMP_BYTES];
+  copyStamp(at, updatedAt);
+
+  xSemaphoreTake(configMutex, portMAX_DELAY);
+  bool changed = false;
+  if (isNewer(at, appliedAt[i]))
+  {
+    copyStamp(appliedAt[i], at);
+    recordLatency(stats.push, at);
+    stats.pushed++;
+    changed = *flags[i].value != value;
+    *flags[i].value = value;
+    bool stampChanged = at[0] && strcmp(at, stamp) > 0;
+    if (stampChanged)
+    {
+      // A poll after the socket drops starts from here
+      copyStamp(stamp, at);
+    }
+    if (changed)
+    {
+      stats.changes++;
+    }
+    if (changed || stampChanged)
+    {
+      save();
+    }
+  }
+  xSemaphoreGive(configMutex);
+  return changed;
+}
+
+ConfigSyncStats configSyncStats()
+{
+  return stats;
+}
+
+static void printLatency(Print &out, const char *source, const ConfigLatency &latency)
+{
+  out.printf(", %s latency %u ms avg %u ms max (%u)", source, latency.count ? latency.totalMs / latency.count : 0,
+             latency.maxMs, latency.count);
+}
+
+void configSyncPrintStats(Print &out)
+{
+  out.printf("Config: %s, %s, %u polls, %u rows, %u pushed, %u changes, %u failed, %u saves, stamp %s",
+             stats.restored ? "restored from NVS" : "defaults at boot",
+             stats.incremental ? "changes only" : "full reads", stats.polls, stats.rows, stats.pushed,
+             stats.changes, stats.failures, stats.saves, stamp[0] ? stamp : "none");
+  printLatency(out, "push", stats.push);
+  printLatency(out, "poll", stats.poll);
+  out.println();
+}
@@ -0,0 +1,57 @@
+#ifndef CONFIG_SYNC_H
+#define CONFIG_SYNC_H
+
+#include <Arduino.h>
+
+#define CONFIG_STAMP_BYTES 40 // PostgREST timestamptz, e.g. 2024-05-01T12:34:56.123456+00:00
+#define CONFIG_MAX_FLAGS 16
+
+// Maps a sensor_data row to the flag the tasks read. The name doubles as the NVS key,
+// so it is at most 15 characters
+struct ConfigFlag
+{
+  const char *name;
+  int *value;
+  int pending;
+};
+
+// updated_at (the commit) to the flag changing on the device, by the SNTP clock
+struct ConfigLatency
+{
+  uint32_t count;
+  uint32_t lastMs;
+  uint32_t maxMs;
+  uint32_t totalMs;
+};
+
+struct ConfigSyncStats
+{
+  bool restored;        // Flags came from NVS at boot rather than the built-in defaults
+  bool incremental;     // False once the table turned out to have no updated_at column
+  uint32_t polls;
+  uint32_t rows;        // Rows received; only changed ones once a stamp is known
+  uint32_t pushed;      // Change events applied from the realtime channel
+  uint32_t changes;     // Flags whose value actually changed
+  uint32_t failures;
+  uint32_t saves;
+  ConfigLatency push;
+  ConfigLatency poll;   // Rows that arrived by a poll with a stamp, i.e. while push was down
+};
+
+// Applies the values the last sync cached in NVS, so the flags are right before any task reads
+// them. Returns true when a cache was found
+bool configSyncBegin(ConfigFlag *flags, int count);
+
+// Fetches only the rows changed since the last updated_at stamp and applies them all at once,
+// skipping any a pushed event has overtaken; the merged flags and the new stamp go to NVS
+// when they changed. The caller holds xSupabaseMutex. Returns the number of rows received, or -1
+int configSyncPoll();
+
+// Applies one row pushed by the realtime channel, unless a newer one was already applied.
+// Safe to call alongside configSyncPoll(); returns true when the flag changed
+bool configSyncApply(const char *name, const char *status, const char *updatedAt);
+
+ConfigSyncStats configSyncStats();
+void configSyncPrintStats(Print &out);
+
+#endif
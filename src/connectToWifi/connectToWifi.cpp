@@ -1,16 +0,0 @@
-#include "connectToWifi.h"
-#include "../confidential.h"
-
-void connectToWifi()
-{
-  Serial.println("Connecting to WiFi...");
-  WiFi.begin(ssid, password);
-
-  while (WiFi.status() != WL_CONNECTED)
-  {
-    delay(1000);
-    Serial.println("Connecting...");
-  }
-
-  Serial.println("Connected to WiFi");
-}
\ No newline at end of file
@@ -1,9 +0,0 @@
-#ifndef CONNECT_TO_WIFI_H
-#define CONNECT_TO_WIFI_H
-
-#include <Arduino.h>
-#include <WiFi.h>
-
-void connectToWifi();
-
-#endif
\ No newline at end of file
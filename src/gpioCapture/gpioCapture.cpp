@@ -0,0 +1,132 @@
+#include "gpioCapture.h"
+#include <atomic>
+#include <driver/gpio.h>
+
+#define GPIO_CAPTURE_RING_SIZE 64 // Power of two
+
+static uint8_t capturePins[GPIO_CAPTURE_MAX_PINS];
+static int capturePinCount = 0;
+static volatile GpioCaptureMode captureMode = GPIO_CAPTURE_POLLED;
+static TaskHandle_t captureTask = NULL;
+
+// Single-producer single-consumer ring: the GPIO ISR writes head, the sensor task writes tail
+static GpioEdge ring[GPIO_CAPTURE_RING_SIZE];
+static std::atomic<uint32_t> ringHead(0);
+static std::atomic<uint32_t> ringTail(0);
+static std::atomic<uint32_t> overflows(0);
+
+// Latest ISR timestamp per pin, used to measure the polled path
+static std::atomic<uint32_t> lastEdgeMicros[GPIO_CAPTURE_MAX_PINS];
+static int polledLevel[GPIO_CAPTURE_MAX_PINS];
+
+static LatencyHistogram isrLatency;
+static LatencyHistogram polledLatency;
+
+static void IRAM_ATTR onEdge(void *arg)
+{
+  uint32_t now = micros();
+  int index = (int)(intptr_t)arg;
+  lastEdgeMicros[index].store(now, std::memory_order_relaxed);
+
+  if (captureMode != GPIO_CAPTURE_INTERRUPT)
+  {
+    return;
+  }
+
+  uint32_t head = ringHead.load(std::memory_order_relaxed);
+  if (head - ringTail.load(std::memory_order_acquire) >= GPIO_CAPTURE_RING_SIZE)
+  {
+    overflows.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  GpioEdge &edge = ring[head & (GPIO_CAPTURE_RING_SIZE - 1)];
+  edge.pin = capturePins[index];
+  edge.level = gpio_get_level((gpio_num_t)capturePins[index]);
+  edge.micros = now;
+  ringHead.store(head + 1, std::memory_order_release);
+
+  if (captureTask)
+  {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(captureTask, &woken);
+    if (woken)
+    {
+      portYIELD_FROM_ISR();
+    }
+  }
+}
+
+bool gpioCaptureBegin(const uint8_t *pins, int count, GpioCaptureMode mode, TaskHandle_t notifyTask)
+{
+  if (count > GPIO_CAPTURE_MAX_PINS)
+  {
+    return false;
+  }
+
+  latencyHistogramInit(isrLatency, "GPIO edge latency (interrupt)");
+  latencyHistogramInit(polledLatency, "GPIO edge latency (polled)");
+  captureMode = mode;
+  captureTask = notifyTask;
+  capturePinCount = count;
+
+  for (int i = 0; i < count; i++)
+  {
+    capturePins[i] = pins[i];
+    polledLevel[i] = digitalRead(pins[i]);
+    lastEdgeMicros[i].store(micros());
+    attachInterruptArg(digitalPinToInterrupt(pins[i]), onEdge, (void *)(intptr_t)i, CHANGE);
+  }
+  return true;
+}
+
+GpioCaptureMode gpioCaptureMode()
+{
+  return captureMode;
+}
+
+void gpioCaptureSetMode(GpioCaptureMode mode)
+{
+  captureMode = mode;
+}
+
+bool gpioCaptureNext(GpioEdge &edge)
+{
+  uint32_t tail = ringTail.load(std::memory_order_relaxed);
+  if (tail == ringHead.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  edge = ring[tail & (GPIO_CAPTURE_RING_SIZE - 1)];
+  ringTail.store(tail + 1, std::memory_order_release);
+
+  latencyHistogramRecord(isrLatency, micros() - edge.micros);
+  return true;
+}
+
+void gpioCapturePolled(uint8_t pin, int level)
+{
+  for (int i = 0; i < capturePinCount; i++)
+  {
+    if (capturePins[i] == pin)
+    {
+      if (level != polledLevel[i])
+      {
+        polledLevel[i] = level;
+        latencyHistogramRecord(polledLatency, micros() - lastEdgeMicros[i].load(std::memory_order_relaxed));
+      }
+      return;
+    }
+  }
+}
+
+uint32_t gpioCaptureOverflows()
+{
+  return overflows.load();
+}
+
+void gpioCapturePrintStats(Print &out)
+{
+  latencyHistogramPrint(isrLatency, out);
+  latencyHistogramPrint(polledLatency, out);
+  out.printf("GPIO capture ring overflows: %u\n", gpioCaptureOverflows());
+}
@@ -0,0 +1,38 @@
+#ifndef GPIO_CAPTURE_H
+#define GPIO_CAPTURE_H
+
+#include <Arduino.h>
+#include "../latencyHistogram/latencyHistogram.h"
+
+#define GPIO_CAPTURE_MAX_PINS 4
+
+// How the sensor task learns about level changes on the captured pins
+enum GpioCaptureMode
+{
+  GPIO_CAPTURE_POLLED,   // digitalRead once per loop, edges between polls are missed
+  GPIO_CAPTURE_INTERRUPT // edges timestamped in the ISR and delivered through the ring
+};
+
+struct GpioEdge
+{
+  uint8_t pin;
+  uint8_t level;
+  uint32_t micros; // micros() in the ISR
+};
+
+// Attaches CHANGE interrupts to every pin; notifyTask is woken on each edge in interrupt mode.
+// The ISRs run in both modes so polled detection can be compared against the real edge time.
+bool gpioCaptureBegin(const uint8_t *pins, int count, GpioCaptureMode mode, TaskHandle_t notifyTask);
+GpioCaptureMode gpioCaptureMode();
+void gpioCaptureSetMode(GpioCaptureMode mode);
+
+// Single consumer: pops the oldest edge and records its ISR-to-task latency
+bool gpioCaptureNext(GpioEdge &edge);
+
+// Polled path: call with each digitalRead result; a changed level records the latency since the edge
+void gpioCapturePolled(uint8_t pin, int level);
+
+uint32_t gpioCaptureOverflows();
+void gpioCapturePrintStats(Print &out);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef HAL_H
+#define HAL_H
+
+// The device's peripherals and clock as the alarm logic sees them. halArduino.cpp backs them with
+// the real hardware; the native build links the simulator's version instead
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Rows of the sensor_data table the device reports to
+enum TelemetryId
+{
+  TELEMETRY_MOTION,
+  TELEMETRY_VIBRATION,
+  TELEMETRY_MAGNETIC,
+  TELEMETRY_KEYPAD,
+  TELEMETRY_RFID,
+  TELEMETRY_COUNT
+};
+
+enum HalPinResult
+{
+  HAL_PIN_ACCEPTED,
+  HAL_PIN_REJECTED,
+  HAL_PIN_LOCKED_OUT
+};
+
+// Clock
+uint32_t halMillis();
+uint32_t halMicros();
+
+// GPIO and ADC
+int halDigitalRead(uint8_t pin);
+uint16_t halAnalogRead(uint8_t pin);
+
+// I2C devices: the PCF8574 keypad (next key pressed, or 0) and the LCD
+char halKeypadKey();
+void halDisplay(const char *line0, const char *line1);
+void halDisplayAt(uint8_t col, uint8_t row, const char *text);
+
+// RFID reader: true when a new card was read; uid holds UID_MAX_LENGTH (10) bytes
+bool halRfidRead(uint8_t *uid, uint8_t &length);
+
+// Buzzer: the looping alarm siren, and the melody that welcomes an authorised user
+void halSiren(bool on);
+void halChime();
+
+// Backend client: queues one telemetry record, and checks credentials as last synced
+void halBackendSend(TelemetryId id, int32_t value, bool critical);
+HalPinResult halCheckPin(const char *digits, uint8_t length, int &userId);
+bool halCheckCard(const uint8_t *uid, uint8_t length);
+
+#endif
@@ -0,0 +1,109 @@
+#include "hal.h"
+#include <Arduino.h>
+#include <MFRC522.h>
+#include <Keypad_I2C.h>
+#include "../uidTable/uidTable.h"
+#include "../lcdRenderer/lcdRenderer.h"
+#include "../buzzer/buzzer.h"
+#include "../networkWorker/networkWorker.h"
+#include "../pinStore/pinStore.h"
+#include "../rfidAllowlist/rfidAllowlist.h"
+#include "../alarmLogic/alarmLogic.h"
+
+static_assert(ALARM_PIN_MAX_DIGITS <= PIN_MAX_DIGITS, "The keypad takes more digits than the PIN store checks");
+static_assert(sizeof(((MFRC522::Uid *)0)->uidByte) <= UID_MAX_LENGTH, "RFID UIDs do not fit the HAL buffer");
+
+extern MFRC522 mfrc522;
+extern Keypad_I2C keypad;
+
+// Buzzer patterns
+static const BuzzerNote welcomeMelody[] = {
+    {262, 500}, {0, 150}, {294, 500}, {0, 150}, {330, 500}, {0, 150}, {349, 500}, {0, 150},
+    {392, 500}, {0, 150}, {440, 500}, {0, 150}, {494, 500}, {0, 150}, {523, 500}};
+static const BuzzerNote alarmSiren[] = {{2400, 250}, {1800, 250}};
+
+uint32_t halMillis()
+{
+  return millis();
+}
+
+uint32_t halMicros()
+{
+  return micros();
+}
+
+int halDigitalRead(uint8_t pin)
+{
+  return digitalRead(pin);
+}
+
+uint16_t halAnalogRead(uint8_t pin)
+{
+  return analogRead(pin);
+}
+
+char halKeypadKey()
+{
+  return keypad.getKey();
+}
+
+void halDisplay(const char *line0, const char *line1)
+{
+  lcdShow(line0, line1);
+}
+
+void halDisplayAt(uint8_t col, uint8_t row, const char *text)
+{
+  lcdPrintAt(col, row, text);
+}
+
+bool halRfidRead(uint8_t *uid, uint8_t &length)
+{
+  if (!mfrc522.PICC_IsNewCardPresent() || !mfrc522.PICC_ReadCardSerial())
+  {
+    return false;
+  }
+  length = mfrc522.uid.size;
+  memcpy(uid, mfrc522.uid.uidByte, length);
+  return true;
+}
+
+void halSiren(bool on)
+{
+  if (on)
+  {
+    buzzerPlay(alarmSiren, sizeof(alarmSiren) / sizeof(alarmSiren[0]), BUZZER_PRIORITY_ALARM, true);
+  }
+  else
+  {
+    buzzerStop(BUZZER_PRIORITY_ALARM);
+  }
+}
+
+void halChime()
+{
+  buzzerPlay(welcomeMelody, sizeof(welcomeMelody) / sizeof(welcomeMelody[0]), BUZZER_PRIORITY_MELODY);
+}
+
+void halBackendSend(TelemetryId id, int32_t value, bool critical)
+{
+  networkWorkerEnqueue(id, value, critical);
+}
+
+HalPinResult halCheckPin(const char *digits, uint8_t length, int &userId)
+{
+  switch (pinStoreVerify(digits, length, userId))
+  {
+  case PIN_ACCEPTED:
+    return HAL_PIN_ACCEPTED;
+  case PIN_LOCKED_OUT:
+    return HAL_PIN_LOCKED_OUT;
+  default:
+    return HAL_PIN_REJECTED;
+  }
+}
+
+bool halCheckCard(const uint8_t *uid, uint8_t length)
+{
+  return rfidAllowlistContains(uid, length);
+}
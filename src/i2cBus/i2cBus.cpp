@@ -0,0 +1,284 @@
+#include "i2cBus.h"
+
+#define I2C_BUS_TIMEOUT_MS 100
+
+struct I2cDevice
+{
+  I2cDeviceStats stats;
+  I2cBusPriority priority;
+};
+
+static TwoWire *bus = NULL;
+static uint32_t busClockHz = 0;
+static SemaphoreHandle_t busMutex = NULL;
+static I2cDevice devices[I2C_BUS_MAX_DEVICES];
+static int deviceCount = 0;
+
+static portMUX_TYPE busMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile int highWaiting = 0;
+static unsigned long acquiredMicros = 0;
+static uint32_t busyMicros = 0;
+static unsigned long lastStatsMicros = 0;
+static uint32_t lastBusyMicros = 0;
+
+static I2cDevice *findDevice(uint8_t address)
+{
+  for (int i = 0; i < deviceCount; i++)
+  {
+    if (devices[i].stats.address == address)
+    {
+      return &devices[i];
+    }
+  }
+  return NULL;
+}
+
+bool i2cBusBegin(TwoWire *wire, uint32_t clockHz)
+{
+  busMutex = xSemaphoreCreateMutex();
+  if (busMutex == NULL)
+  {
+    Serial.println("Failed to create I2C bus mutex");
+    return false;
+  }
+  bus = wire;
+  busClockHz = clockHz;
+  bus->setClock(clockHz);
+  lastStatsMicros = micros();
+  return true;
+}
+
+TwoWire *i2cBusWire()
+{
+  return bus;
+}
+
+bool i2cBusAddDevice(uint8_t address, I2cBusPriority priority, const char *name)
+{
+  if (deviceCount >= I2C_BUS_MAX_DEVICES || findDevice(address) != NULL)
+  {
+    Serial.println("Failed to add I2C device");
+    return false;
+  }
+  I2cDevice &device = devices[deviceCount++];
+  memset(&device.stats, 0, sizeof(device.stats));
+  device.stats.name = name;
+  device.stats.address = address;
+  device.priority = priority;
+  return true;
+}
+
+bool i2cBusAcquire(uint8_t address)
+{
+  I2cDevice *device = findDevice(address);
+  if (device == NULL || busMutex == NULL)
+  {
+    return false;
+  }
+
+  unsigned long start = micros();
+  TickType_t startTick = xTaskGetTickCount();
+  TickType_t timeout = pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MS);
+  bool taken;
+  if (device->priority == I2C_PRIORITY_HIGH)
+  {
+    portENTER_CRITICAL(&busMux);
+    highWaiting++;
+    portEXIT_CRITICAL(&busMux);
+    taken = xSemaphoreTake(busMutex, timeout) == pdTRUE;
+    portENTER_CRITICAL(&busMux);
+    highWaiting--;
+    portEXIT_CRITICAL(&busMux);
+  }
+  else
+  {
+    // Stand aside while a high priority client waits, even if it runs on a task of equal priority
+    while (true)
+    {
+      TickType_t waited = xTaskGetTickCount() - startTick;
+      taken = waited < timeout && xSemaphoreTake(busMutex, timeout - waited) == pdTRUE;
+      if (!taken || highWaiting == 0)
+      {
+        break;
+      }
+      xSemaphoreGive(busMutex);
+      portENTER_CRITICAL(&busMux);
+      device->stats.yields++;
+      portEXIT_CRITICAL(&busMux);
+      vTaskDelay(1);
+    }
+  }
+
+  if (!taken)
+  {
+    // The client skips its transactions, so a timeout counts as an error
+    portENTER_CRITICAL(&busMux);
+    device->stats.errors++;
+    portEXIT_CRITICAL(&busMux);
+    return false;
+  }
+
+  acquiredMicros = micros();
+  uint32_t wait = acquiredMicros - start;
+  portENTER_CRITICAL(&busMux);
+  device->stats.acquisitions++;
+  if (wait > device->stats.maxWaitMicros)
+  {
+    device->stats.maxWaitMicros = wait;
+  }
+  portEXIT_CRITICAL(&busMux);
+  return true;
+}
+
+void i2cBusRelease(uint8_t address)
+{
+  I2cDevice *device = findDevice(address);
+  if (device == NULL)
+  {
+    return;
+  }
+
+  uint32_t hold = micros() - acquiredMicros;
+  portENTER_CRITICAL(&busMux);
+  device->stats.holdMicros += hold;
+  if (hold > device->stats.maxHoldMicros)
+  {
+    device->stats.maxHoldMicros = hold;
+  }
+  busyMicros += hold;
+  portEXIT_CRITICAL(&busMux);
+  xSemaphoreGive(busMutex);
+}
+
+bool i2cBusWrite(uint8_t address, const uint8_t *data, size_t length)
+{
+  I2cDevice *device = findDevice(address);
+  if (device == NULL)
+  {
+    return false;
+  }
+
+  size_t sent = 0;
+  while (sent < length)
+  {
+    size_t chunk = length - sent;
+    if (chunk > I2C_BUS_BATCH_BYTES)
+    {
+      chunk = I2C_BUS_BATCH_BYTES;
+    }
+    bus->beginTransmission(address);
+    bus->write(data + sent, chunk);
+    uint8_t result = bus->endTransmission();
+
+    portENTER_CRITICAL(&busMux);
+    device->stats.transactions++;
+    if (result == 0)
+    {
+      device->stats.bytes += chunk;
+    }
+    else
+    {
+      device->stats.errors++;
+    }
+    portEXIT_CRITICAL(&busMux);
+
+    if (result != 0)
+    {
+      return false;
+    }
+    sent += chunk;
+  }
+  return true;
+}
+
+size_t i2cBusRead(uint8_t address, uint8_t *data, size_t length)
+{
+  I2cDevice *device = findDevice(address);
+  if (device == NULL)
+  {
+    return 0;
+  }
+
+  size_t received = bus->requestFrom((int)address, (int)length);
+  for (size_t i = 0; i < received; i++)
+  {
+    data[i] = bus->read();
+  }
+
+  portENTER_CRITICAL(&busMux);
+  device->stats.transactions++;
+  device->stats.bytes += received;
+  if (received != length)
+  {
+    device->stats.errors++;
+  }
+  portEXIT_CRITICAL(&busMux);
+  return received;
+}
+
+void i2cBusRecord(uint8_t address, unsigned int transactions, unsigned int errors)
+{
+  I2cDevice *device = findDevice(address);
+  if (device == NULL)
+  {
+    return;
+  }
+  portENTER_CRITICAL(&busMux);
+  device->stats.transactions += transactions;
+  device->stats.errors += errors;
+  portEXIT_CRITICAL(&busMux);
+}
+
+bool i2cBusLockHook(byte address)
+{
+  return i2cBusAcquire(address);
+}
+
+void i2cBusUnlockHook(byte address, unsigned int transactions, unsigned int errors)
+{
+  i2cBusRecord(address, transactions, errors);
+  i2cBusRelease(address);
+}
+
+bool i2cBusDeviceStats(int index, I2cDeviceStats &stats)
+{
+  if (index < 0 || index >= deviceCount)
+  {
+    return false;
+  }
+  portENTER_CRITICAL(&busMux);
+  stats = devices[index].stats;
+  portEXIT_CRITICAL(&busMux);
+  return true;
+}
+
+void i2cBusPrintStats(Print &out)
+{
+  I2cDeviceStats snapshot[I2C_BUS_MAX_DEVICES];
+  portENTER_CRITICAL(&busMux);
+  uint32_t busy = busyMicros - lastBusyMicros;
+  lastBusyMicros = busyMicros;
+  for (int i = 0; i < deviceCount; i++)
+  {
+    snapshot[i] = devices[i].stats;
+    // Maxima cover one stats interval
+    devices[i].stats.maxHoldMicros = 0;
+    devices[i].stats.maxWaitMicros = 0;
+  }
+  portEXIT_CRITICAL(&busMux);
+
+  unsigned long now = micros();
+  unsigned long elapsed = now - lastStatsMicros;
+  lastStatsMicros = now;
+
+  out.printf("I2C bus: %lu kHz, %lu.%02lu%% busy over %lu ms\n", (unsigned long)(busClockHz / 1000),
+             elapsed ? (unsigned long)((uint64_t)busy * 100 / elapsed) : 0,
+             elapsed ? (unsigned long)((uint64_t)busy * 10000 / elapsed % 100) : 0, elapsed / 1000);
+  for (int i = 0; i < deviceCount; i++)
+  {
+    const I2cDeviceStats &s = snapshot[i];
+    out.printf("  %s 0x%02X: %u holds, %u transactions, %u errors, %u bytes, hold max %u us, wait max %u us, %u yields\n",
+               s.name, s.address, s.acquisitions, s.transactions, s.errors, s.bytes, s.maxHoldMicros,
+               s.maxWaitMicros, s.yields);
+  }
+}
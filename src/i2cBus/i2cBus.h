@@ -0,0 +1,55 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define I2C_BUS_MAX_DEVICES 4
+#define I2C_BUS_BATCH_BYTES 120 // Bytes per transmission; the ESP32 Wire buffer holds 128
+
+// Waiting high priority clients get the bus before any low priority client
+enum I2cBusPriority
+{
+  I2C_PRIORITY_LOW,
+  I2C_PRIORITY_HIGH
+};
+
+struct I2cDeviceStats
+{
+  const char *name;
+  uint8_t address;
+  uint32_t acquisitions;
+  uint32_t transactions;
+  uint32_t errors;
+  uint32_t bytes;
+  uint32_t holdMicros;    // total time the device held the bus
+  uint32_t maxHoldMicros;
+  uint32_t maxWaitMicros; // longest wait for the bus
+  uint32_t yields;        // times a low priority acquire stood aside for a high priority one
+};
+
+// Takes ownership of wire and sets its clock; call before any device is added
+bool i2cBusBegin(TwoWire *wire, uint32_t clockHz);
+TwoWire *i2cBusWire();
+bool i2cBusAddDevice(uint8_t address, I2cBusPriority priority, const char *name);
+
+// Holds the bus for a sequence of transactions to one device; every call pairs with i2cBusRelease()
+bool i2cBusAcquire(uint8_t address);
+void i2cBusRelease(uint8_t address);
+
+// Bus must be held. Back-to-back bytes go out in as few transmissions as the Wire buffer allows
+bool i2cBusWrite(uint8_t address, const uint8_t *data, size_t length);
+size_t i2cBusRead(uint8_t address, uint8_t *data, size_t length);
+
+// For drivers that talk to Wire themselves and only report what they did
+void i2cBusRecord(uint8_t address, unsigned int transactions, unsigned int errors);
+
+// Keypad_I2C bus hooks
+bool i2cBusLockHook(byte address);
+void i2cBusUnlockHook(byte address, unsigned int transactions, unsigned int errors);
+
+bool i2cBusDeviceStats(int index, I2cDeviceStats &stats);
+// Prints per-device counters and bus occupancy since the last call
+void i2cBusPrintStats(Print &out);
+
+#endif
@@ -0,0 +1,136 @@
+#include "jsonArena.h"
+#include "../logger/logger.h"
+
+#define JSON_ARENA_ALIGN 8
+#define JSON_ARENA_HEADER JSON_ARENA_ALIGN // block size, padded to keep the data aligned
+#define JSON_ARENA_NONE ((size_t)-1)
+
+alignas(JSON_ARENA_ALIGN) static uint8_t pool[JSON_ARENA_COUNT][JSON_ARENA_BYTES];
+static bool poolBusy[JSON_ARENA_COUNT];
+static portMUX_TYPE poolMux = portMUX_INITIALIZER_UNLOCKED;
+static size_t highWater = 0;
+static uint32_t failures = 0;
+
+static size_t roundUp(size_t size)
+{
+  return (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+}
+
+static size_t &blockSize(uint8_t *buffer, size_t offset)
+{
+  return *(size_t *)&buffer[offset];
+}
+
+JsonArena::JsonArena() : buffer(NULL), live(0), top(0), last(JSON_ARENA_NONE)
+{
+  portENTER_CRITICAL(&poolMux);
+  for (int i = 0; i < JSON_ARENA_COUNT && buffer == NULL; i++)
+  {
+    if (!poolBusy[i])
+    {
+      poolBusy[i] = true;
+      buffer = pool[i];
+    }
+  }
+  portEXIT_CRITICAL(&poolMux);
+  if (buffer == NULL)
+  {
+    LOG_ERROR(LOG_SUPABASE, "JSON arena pool exhausted");
+  }
+}
+
+JsonArena::~JsonArena()
+{
+  if (buffer != NULL)
+  {
+    portENTER_CRITICAL(&poolMux);
+    poolBusy[(buffer - pool[0]) / JSON_ARENA_BYTES] = false;
+    portEXIT_CRITICAL(&poolMux);
+  }
+}
+
+void *JsonArena::allocate(size_t size)
+{
+  size_t need = JSON_ARENA_HEADER + roundUp(size);
+  if (buffer == NULL || need > JSON_ARENA_BYTES - top)
+  {
+    failures++;
+    return NULL;
+  }
+  last = top;
+  blockSize(buffer, last) = size;
+  top += need;
+  live++;
+  if (top > highWater)
+  {
+    highWater = top;
+  }
+  return &buffer[last + JSON_ARENA_HEADER];
+}
+
+void JsonArena::deallocate(void *pointer)
+{
+  if (pointer == NULL)
+  {
+    return;
+  }
+  // Only the newest block gives its space back at once; the rest is reclaimed when the
+  // document has freed everything
+  live--;
+  if (live == 0)
+  {
+    top = 0;
+    last = JSON_ARENA_NONE;
+  }
+  else if (last != JSON_ARENA_NONE && pointer == &buffer[last + JSON_ARENA_HEADER])
+  {
+    top = last;
+    last = JSON_ARENA_NONE;
+  }
+}
+
+void *JsonArena::reallocate(void *pointer, size_t size)
+{
+  if (pointer == NULL)
+  {
+    return allocate(size);
+  }
+
+  // ArduinoJson grows the string it is reading, which is nearly always the newest block
+  if (last != JSON_ARENA_NONE && pointer == &buffer[last + JSON_ARENA_HEADER])
+  {
+    size_t need = JSON_ARENA_HEADER + roundUp(size);
+    if (need > JSON_ARENA_BYTES - last)
+    {
+      failures++;
+      return NULL;
+    }
+    blockSize(buffer, last) = size;
+    top = last + need;
+    if (top > highWater)
+    {
+      highWater = top;
+    }
+    return pointer;
+  }
+
+  size_t offset = (uint8_t *)pointer - buffer - JSON_ARENA_HEADER;
+  size_t oldSize = blockSize(buffer, offset);
+  void *moved = allocate(size);
+  if (moved != NULL)
+  {
+    memcpy(moved, pointer, oldSize < size ? oldSize : size);
+    live--; // The old block is abandoned in place
+  }
+  return moved;
+}
+
+size_t jsonArenaHighWater()
+{
+  return highWater;
+}
+
+uint32_t jsonArenaFailures()
+{
+  return failures;
+}
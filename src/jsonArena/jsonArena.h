@@ -0,0 +1,44 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Per arena; responses are parsed a row at a time, so this holds one row. ArduinoJson 7 takes its
+// first variant pool whole: 256 slots of 16 bytes on a 64-bit host, 128 on the ESP32. The rest is
+// for the pool list and the row's strings, each with its block header
+#if UINTPTR_MAX > 0xFFFFFFFFu
+#define JSON_ARENA_BYTES 5120
+#else
+#define JSON_ARENA_BYTES 3072
+#endif
+#define JSON_ARENA_COUNT 3 // A streamed read needs two (filter and row); the realtime channel one
+
+// ArduinoJson allocator over a pool of static buffers, so documents never touch the heap:
+//   JsonArena arena;
+//   JsonDocument doc(&arena);
+// Each live arena holds one buffer of the pool; once all are taken a new one hands out no
+// memory and the document reports NoMemory. Taking and returning a buffer is thread safe; one
+// arena is used by one task at a time. A buffer is reused from the start whenever its document
+// frees everything, as deserializeJson() does before each parse
+class JsonArena : public ArduinoJson::Allocator
+{
+public:
+  JsonArena();
+  ~JsonArena();
+
+  void *allocate(size_t size) override;
+  void deallocate(void *pointer) override;
+  void *reallocate(void *pointer, size_t size) override;
+
+private:
+  uint8_t *buffer; // NULL when the pool was empty
+  size_t live;     // Blocks handed out and not yet freed
+  size_t top;
+  size_t last; // offset of the newest block, which can grow or be freed in place
+};
+
+size_t jsonArenaHighWater();
+uint32_t jsonArenaFailures();
+
+#endif
@@ -0,0 +1,71 @@
+#include "jsonRows.h"
+#include "../logger/logger.h"
+
+JsonRows::JsonRows(const char *const *fields, int fieldCount)
+    : filter(&filterArena), doc(&rowArena), rows(0), started(false), done(false), error(false)
+{
+  // Anything else in a row (embedded resources, columns added later) is skipped by the parser
+  for (int i = 0; i < fieldCount && i < JSON_ROWS_MAX_FIELDS; i++)
+  {
+    filter[fields[i]] = true;
+  }
+}
+
+static int skipWhitespace(Stream &body)
+{
+  int c = body.peek();
+  while (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+  {
+    body.read();
+    c = body.peek();
+  }
+  return c;
+}
+
+bool JsonRows::next(Stream &body)
+{
+  if (done)
+  {
+    return false;
+  }
+
+  // Step over the array punctuation by hand so each element is parsed on its own
+  int c = skipWhitespace(body);
+  if (!started)
+  {
+    started = true;
+    if (c != '[')
+    {
+      LOG_ERROR(LOG_SUPABASE, "Supabase response is not an array");
+      error = done = true;
+      return false;
+    }
+    body.read();
+  }
+  else if (c == ',')
+  {
+    body.read();
+  }
+  else if (c != ']')
+  {
+    LOG_ERROR(LOG_SUPABASE, "Supabase response array is cut short");
+    error = done = true;
+    return false;
+  }
+  if (skipWhitespace(body) == ']')
+  {
+    body.read();
+    done = true;
+    return false;
+  }
+
+  DeserializationError result = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+  if (result)
+  {
+    LOG_ERROR(LOG_SUPABASE, "deserializeJson() failed: %s", result.c_str());
+    error = done = true;
+    return false;
+  }
+  rows++;
+  return true;
+}
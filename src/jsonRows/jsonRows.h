@@ -0,0 +1,35 @@
+#ifndef JSON_ROWS_H
+#define JSON_ROWS_H
+
+#include <Arduino.h>
+#include "../jsonArena/jsonArena.h"
+
+#define JSON_ROWS_MAX_FIELDS 8
+
+// Parses a JSON array from a stream one element at a time, keeping only the named fields of
+// each, so memory does not grow with the response. Knows nothing of HTTP, so it can be fed a
+// recorded response on the host. Values in row() are valid until the next call to next().
+// Uses two JSON arenas, one for the filter and one for the row
+class JsonRows
+{
+public:
+  JsonRows(const char *const *fields, int fieldCount);
+
+  // Parses the next element; false at the end of the array or when the body is not a whole array
+  bool next(Stream &body);
+  JsonObjectConst row() const { return doc.as<JsonObjectConst>(); }
+  int count() const { return rows; }
+  bool failed() const { return error; }
+
+private:
+  JsonArena filterArena;
+  JsonDocument filter;
+  JsonArena rowArena;
+  JsonDocument doc;
+  int rows;
+  bool started;
+  bool done;
+  bool error;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "keypadWake.h"
+
+static KeypadWakeMode wakeMode = KEYPAD_WAKE_POLLED;
+static TaskHandle_t wakeTask = NULL;
+static volatile uint32_t wakeMicros = 0;
+static bool wakePending = false; // A wake happened and its first key has not been seen yet
+
+static LatencyHistogram interruptLatency;
+static LatencyHistogram polledLatency;
+
+static unsigned long lastStatsTime = 0;
+static unsigned long lastTransactions = 0;
+static unsigned long lastBusMicros = 0;
+
+static void IRAM_ATTR onKeypadInterrupt()
+{
+  wakeMicros = micros();
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(wakeTask, &woken);
+  if (woken)
+  {
+    portYIELD_FROM_ISR();
+  }
+}
+
+bool keypadWakeBegin(int intPin, KeypadWakeMode mode, TaskHandle_t task)
+{
+  latencyHistogramInit(interruptLatency, "Key to event latency (interrupt)");
+  latencyHistogramInit(polledLatency, "Key to event latency (polled)");
+  lastStatsTime = micros();
+
+  wakeMode = mode;
+  wakeTask = task;
+  if (mode == KEYPAD_WAKE_INTERRUPT)
+  {
+    pinMode(intPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(intPin), onKeypadInterrupt, FALLING);
+  }
+  return true;
+}
+
+KeypadWakeMode keypadWakeMode()
+{
+  return wakeMode;
+}
+
+bool keypadWakeWait(TickType_t timeout)
+{
+  if (ulTaskNotifyTake(pdTRUE, timeout) > 0)
+  {
+    wakePending = true;
+    return true;
+  }
+  return false;
+}
+
+void keypadWakeClear()
+{
+  ulTaskNotifyTake(pdTRUE, 0);
+}
+
+void keypadWakeKeyEvent(unsigned long previousScanMicros)
+{
+  if (wakePending)
+  {
+    latencyHistogramRecord(interruptLatency, micros() - wakeMicros);
+    wakePending = false;
+  }
+  else
+  {
+    latencyHistogramRecord(polledLatency, micros() - previousScanMicros);
+  }
+}
+
+void keypadWakePrintStats(Print &out, unsigned long transactions, unsigned long busMicros)
+{
+  unsigned long elapsed = micros() - lastStatsTime;
+  unsigned long busy = busMicros - lastBusMicros;
+  out.printf("Keypad bus: %lu transactions in %lu ms, %lu.%02lu%% busy (%s mode)\n",
+             transactions - lastTransactions, elapsed / 1000,
+             elapsed ? (unsigned long)((uint64_t)busy * 100 / elapsed) : 0,
+             elapsed ? (unsigned long)((uint64_t)busy * 10000 / elapsed % 100) : 0,
+             wakeMode == KEYPAD_WAKE_INTERRUPT ? "interrupt" : "polled");
+  latencyHistogramPrint(interruptLatency, out);
+  latencyHistogramPrint(polledLatency, out);
+
+  lastStatsTime = micros();
+  lastTransactions = transactions;
+  lastBusMicros = busMicros;
+}
@@ -0,0 +1,30 @@
+#ifndef KEYPAD_WAKE_H
+#define KEYPAD_WAKE_H
+
+#include <Arduino.h>
+#include "../latencyHistogram/latencyHistogram.h"
+
+// How the keypad task decides when to scan the matrix
+enum KeypadWakeMode
+{
+  KEYPAD_WAKE_POLLED,   // scan on every pass of the task loop
+  KEYPAD_WAKE_INTERRUPT // sleep until the expander INT line falls, then scan until the keys are released
+};
+
+// intPin is the GPIO wired to the PCF8574/8575 INT output (open drain, active low)
+bool keypadWakeBegin(int intPin, KeypadWakeMode mode, TaskHandle_t task);
+KeypadWakeMode keypadWakeMode();
+
+// Waits up to timeout for the INT line; returns true when it fired
+bool keypadWakeWait(TickType_t timeout);
+// Drops INT edges caused by the task's own scanning; call before re-arming the expander
+void keypadWakeClear();
+
+// Records key-to-event latency: from the INT edge for the first key after a wake,
+// otherwise from the previous scan, which bounds how long the press went unseen
+void keypadWakeKeyEvent(unsigned long previousScanMicros);
+
+// Prints the latency histograms and the bus use of the keypad since the last call
+void keypadWakePrintStats(Print &out, unsigned long transactions, unsigned long busMicros);
+
+#endif
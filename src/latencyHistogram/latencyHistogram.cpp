@@ -0,0 +1,60 @@
+#include "latencyHistogram.h"
+
+void latencyHistogramInit(LatencyHistogram &histogram, const char *name)
+{
+  histogram.name = name;
+  latencyHistogramReset(histogram);
+}
+
+void latencyHistogramReset(LatencyHistogram &histogram)
+{
+  memset(histogram.buckets, 0, sizeof(histogram.buckets));
+  histogram.count = 0;
+  histogram.max = 0;
+  histogram.total = 0;
+}
+
+void latencyHistogramRecord(LatencyHistogram &histogram, uint32_t micros)
+{
+  // Index of the highest set bit, found without a loop
+  int bucket = micros ? 31 - __builtin_clz(micros) : 0;
+  if (bucket >= LATENCY_BUCKETS)
+  {
+    bucket = LATENCY_BUCKETS - 1;
+  }
+
+  histogram.buckets[bucket]++;
+  histogram.count++;
+  histogram.total += micros;
+  if (micros > histogram.max)
+  {
+    histogram.max = micros;
+  }
+}
+
+uint32_t latencyHistogramPercentile(const LatencyHistogram &histogram, int percent)
+{
+  if (histogram.count == 0)
+  {
+    return 0;
+  }
+
+  uint32_t target = ((uint64_t)histogram.count * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS - 1; i++)
+  {
+    seen += histogram.buckets[i];
+    if (seen >= target)
+    {
+      return (2UL << i) - 1;
+    }
+  }
+  return histogram.max;
+}
+
+void latencyHistogramPrint(const LatencyHistogram &histogram, Print &out)
+{
+  out.printf("%s: n=%u avg=%u us p50<=%u us p99<=%u us max=%u us\n", histogram.name, histogram.count,
+             histogram.count ? (uint32_t)(histogram.total / histogram.count) : 0,
+             latencyHistogramPercentile(histogram, 50), latencyHistogramPercentile(histogram, 99), histogram.max);
+}
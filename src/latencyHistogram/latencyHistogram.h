@@ -0,0 +1,27 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+// Bucket i counts values in [2^i, 2^(i+1)) microseconds; the last bucket also takes anything larger
+#define LATENCY_BUCKETS 21
+
+struct LatencyHistogram
+{
+  const char *name;
+  uint32_t buckets[LATENCY_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+  uint64_t total;
+};
+
+void latencyHistogramInit(LatencyHistogram &histogram, const char *name);
+void latencyHistogramRecord(LatencyHistogram &histogram, uint32_t micros);
+void latencyHistogramReset(LatencyHistogram &histogram);
+
+// Upper bound of the bucket holding the given percentile, in microseconds
+uint32_t latencyHistogramPercentile(const LatencyHistogram &histogram, int percent);
+
+void latencyHistogramPrint(const LatencyHistogram &histogram, Print &out);
+
+#endif
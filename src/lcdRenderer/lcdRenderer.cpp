@@ -0,0 +1,238 @@
+#include "lcdRenderer.h"
+#include "../i2cBus/i2cBus.h"
+#include "../taskMonitor/taskMonitor.h"
+
+#define LCD_QUEUE_LENGTH 16
+#define LCD_QUEUE_TIMEOUT_MS 50
+#define LCD_TASK_STACK 3072
+#define LCD_TASK_PRIORITY 1
+#define LCD_MERGE_GAP 1 // Unchanged cells rewritten to avoid a cursor move, which costs as much as a character
+#define LCD_RETRY_MS 100 // Redraw period while cells failed to reach the LCD
+#define LCD_BYTES_PER_WRITE 6 // Two nibbles, each set up, latched on EN high and released on EN low
+
+struct LcdRequest
+{
+  uint8_t col;
+  uint8_t row;
+  bool clearRow; // blank the rest of the row after the text
+  char text[LCD_RENDER_COLUMNS + 1];
+  uint32_t queuedMicros;
+};
+
+static LiquidCrystal_I2C *display = NULL;
+static uint8_t displayAddress = 0;
+static QueueHandle_t lcdQueue = NULL;
+
+// front is what the LCD shows, back is what it should show
+static char front[LCD_RENDER_ROWS][LCD_RENDER_COLUMNS];
+static char back[LCD_RENDER_ROWS][LCD_RENDER_COLUMNS];
+
+// One run: a cursor move and up to a full row of characters
+static uint8_t runBytes[(LCD_RENDER_COLUMNS + 1) * LCD_BYTES_PER_WRITE];
+
+static LcdRendererStats stats;
+static portMUX_TYPE rendererMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void applyRequest(const LcdRequest &request)
+{
+  if (request.row >= LCD_RENDER_ROWS)
+  {
+    return;
+  }
+  char *cells = back[request.row];
+  uint8_t col = request.col;
+  for (const char *c = request.text; *c && col < LCD_RENDER_COLUMNS; c++)
+  {
+    cells[col++] = *c;
+  }
+  if (request.clearRow)
+  {
+    memset(&cells[col], ' ', LCD_RENDER_COLUMNS - col);
+  }
+}
+
+// Encodes one HD44780 byte as the PCF8574 output sequence LiquidCrystal_I2C would send, so a
+// whole run goes out as one I2C transmission instead of three per nibble. The expander byte
+// time covers the controller's 37 us execution time from 400 kHz down, so no delays are needed
+static size_t encodeLcdByte(uint8_t *out, uint8_t value, uint8_t mode)
+{
+  uint8_t high = (value & 0xF0) | mode | LCD_BACKLIGHT;
+  uint8_t low = ((value << 4) & 0xF0) | mode | LCD_BACKLIGHT;
+  out[0] = high;
+  out[1] = high | En;
+  out[2] = high;
+  out[3] = low;
+  out[4] = low | En;
+  out[5] = low;
+  return LCD_BYTES_PER_WRITE;
+}
+
+// Sends only the cells that differ between back and front, one bus hold per run so a
+// keypad scan waits for at most one run
+static uint32_t render()
+{
+  uint32_t writes = 0;
+  for (uint8_t row = 0; row < LCD_RENDER_ROWS; row++)
+  {
+    uint8_t col = 0;
+    while (col < LCD_RENDER_COLUMNS)
+    {
+      if (back[row][col] == front[row][col])
+      {
+        col++;
+        continue;
+      }
+
+      // Extend the run over changed cells and short unchanged gaps
+      uint8_t end = col + 1;
+      uint8_t last = col;
+      while (end < LCD_RENDER_COLUMNS && end - last <= LCD_MERGE_GAP + 1)
+      {
+        if (back[row][end] != front[row][end])
+        {
+          last = end;
+        }
+        end++;
+      }
+
+      static const uint8_t rowOffsets[] = {0x00, 0x40};
+      size_t length = encodeLcdByte(runBytes, LCD_SETDDRAMADDR | (col + rowOffsets[row]), 0);
+      for (uint8_t c = col; c <= last; c++)
+      {
+        length += encodeLcdByte(&runBytes[length], back[row][c], Rs);
+      }
+
+      if (i2cBusAcquire(displayAddress))
+      {
+        bool sent = i2cBusWrite(displayAddress, runBytes, length);
+        i2cBusRelease(displayAddress);
+        if (sent)
+        {
+          // Cells that failed stay dirty and are retried on the next frame
+          memcpy(&front[row][col], &back[row][col], last - col + 1);
+          writes += last - col + 2;
+          stats.cursorMoves++;
+          stats.charsWritten += last - col + 1;
+        }
+      }
+      col = last + 1;
+    }
+  }
+  return writes;
+}
+
+static void displayTask(void *pvParameters)
+{
+  LcdRequest request;
+  bool dirty = false;
+  while (true)
+  {
+    // Apply every queued request before drawing, so a full-screen change is one frame
+    uint32_t oldest = micros();
+    if (xQueueReceive(lcdQueue, &request, dirty ? pdMS_TO_TICKS(LCD_RETRY_MS) : portMAX_DELAY) == pdTRUE)
+    {
+      oldest = request.queuedMicros;
+      applyRequest(request);
+    }
+    while (xQueueReceive(lcdQueue, &request, 0) == pdTRUE)
+    {
+      applyRequest(request);
+    }
+
+    unsigned long start = micros();
+    uint32_t writes = render();
+    unsigned long end = micros();
+    dirty = memcmp(front, back, sizeof(front)) != 0;
+
+    if (writes > 0)
+    {
+      portENTER_CRITICAL(&rendererMux);
+      stats.frames++;
+      stats.lastFrameWrites = writes;
+      stats.lastRenderMicros = end - start;
+      stats.lastLatencyMicros = end - oldest;
+      if (stats.lastRenderMicros > stats.maxRenderMicros)
+      {
+        stats.maxRenderMicros = stats.lastRenderMicros;
+      }
+      if (stats.lastLatencyMicros > stats.maxLatencyMicros)
+      {
+        stats.maxLatencyMicros = stats.lastLatencyMicros;
+      }
+      portEXIT_CRITICAL(&rendererMux);
+    }
+  }
+}
+
+bool lcdRendererBegin(LiquidCrystal_I2C *lcd, uint8_t address)
+{
+  display = lcd;
+  displayAddress = address;
+  if (i2cBusAcquire(displayAddress))
+  {
+    display->clear();
+    i2cBusRelease(displayAddress);
+  }
+  memset(front, ' ', sizeof(front));
+  memset(back, ' ', sizeof(back));
+
+  lcdQueue = xQueueCreate(LCD_QUEUE_LENGTH, sizeof(LcdRequest));
+  if (lcdQueue == NULL)
+  {
+    Serial.println("Failed to create LCD queue");
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(displayTask, "Display", LCD_TASK_STACK, NULL, LCD_TASK_PRIORITY, NULL, TASK_CORE_IO) != pdPASS)
+  {
+    Serial.println("Failed to create Display task");
+    return false;
+  }
+  return true;
+}
+
+static void queueRequest(uint8_t col, uint8_t row, const char *text, bool clearRow)
+{
+  if (lcdQueue == NULL)
+  {
+    return;
+  }
+
+  LcdRequest request;
+  request.col = col;
+  request.row = row;
+  request.clearRow = clearRow;
+  strncpy(request.text, text ? text : "", LCD_RENDER_COLUMNS);
+  request.text[LCD_RENDER_COLUMNS] = '\0';
+  request.queuedMicros = micros();
+
+  if (xQueueSend(lcdQueue, &request, LCD_QUEUE_TIMEOUT_MS / portTICK_PERIOD_MS) != pdTRUE)
+  {
+    portENTER_CRITICAL(&rendererMux);
+    stats.droppedRequests++;
+    portEXIT_CRITICAL(&rendererMux);
+  }
+}
+
+void lcdShow(const char *line0, const char *line1)
+{
+  queueRequest(0, 0, line0, true);
+  queueRequest(0, 1, line1, true);
+}
+
+void lcdShowLine(uint8_t row, const char *text)
+{
+  queueRequest(0, row, text, true);
+}
+
+void lcdPrintAt(uint8_t col, uint8_t row, const char *text)
+{
+  queueRequest(col, row, text, false);
+}
+
+LcdRendererStats lcdRendererStats()
+{
+  portENTER_CRITICAL(&rendererMux);
+  LcdRendererStats copy = stats;
+  portEXIT_CRITICAL(&rendererMux);
+  return copy;
+}
@@ -0,0 +1,34 @@
+#ifndef LCD_RENDERER_H
+#define LCD_RENDERER_H
+
+#include <Arduino.h>
+#include <LiquidCrystal_I2C.h>
+
+#define LCD_RENDER_COLUMNS 16
+#define LCD_RENDER_ROWS 2
+
+struct LcdRendererStats
+{
+  uint32_t frames;            // render passes that changed at least one cell
+  uint32_t charsWritten;
+  uint32_t cursorMoves;
+  uint32_t lastFrameWrites;   // characters plus cursor moves of the last frame
+  uint32_t lastRenderMicros;  // I2C time of the last frame
+  uint32_t maxRenderMicros;
+  uint32_t lastLatencyMicros; // oldest request of the last frame to the end of its render
+  uint32_t maxLatencyMicros;
+  uint32_t droppedRequests;   // the request queue stayed full
+};
+
+// Starts the display task; from then on only that task touches the LCD. address must
+// already be registered with the I2C bus manager, and lcd initialised with the backlight on
+bool lcdRendererBegin(LiquidCrystal_I2C *lcd, uint8_t address);
+
+// Any task may call these; they queue the change and return
+void lcdShow(const char *line0, const char *line1);     // replace the whole screen
+void lcdShowLine(uint8_t row, const char *text);        // replace one row
+void lcdPrintAt(uint8_t col, uint8_t row, const char *text); // overwrite cells, keep the rest
+
+LcdRendererStats lcdRendererStats();
+
+#endif
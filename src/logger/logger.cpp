@@ -0,0 +1,209 @@
+#include "logger.h"
+#include <atomic>
+#include "../taskMonitor/taskMonitor.h"
+
+#define LOG_RING_SIZE 64 // Power of two
+#define LOG_PRESSURE_FILL (LOG_RING_SIZE * 3 / 4) // Past this only WARN and ERROR get in
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+#define LOG_TASK_STACK 3072
+#define LOG_TASK_PRIORITY 1
+#define LOG_DRAIN_MS 10
+#define LOG_LINE_BYTES 160
+
+struct LogRecord
+{
+  uint32_t millis;
+  const char *format;
+  uintptr_t args[LOG_MAX_ARGS];
+  uint8_t level;
+  uint8_t module;
+  int8_t textIndex;
+  char text[LOG_TEXT_BYTES];
+};
+
+// Bounded multi-producer ring: a producer claims a slot by advancing head with a
+// compare-and-swap, fills it, then publishes it through the slot's sequence number.
+// The sequence is stored minus the slot index so the zeroed ring starts out valid
+struct LogSlot
+{
+  std::atomic<uint32_t> sequence;
+  LogRecord record;
+};
+
+static LogSlot ring[LOG_RING_SIZE];
+static std::atomic<uint32_t> ringHead(0);
+static std::atomic<uint32_t> ringTail(0);
+static std::atomic<uint32_t> written(0);
+static std::atomic<uint32_t> dropped(0);
+static std::atomic<uint32_t> maxFill(0);
+
+static uint8_t moduleLevels[LOG_MODULE_COUNT] = {LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+                                                  LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL,
+                                                  LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL};
+static Print *output = NULL;
+
+static const char *const moduleNames[LOG_MODULE_COUNT] = {"main", "sensors", "keypad", "rfid",
+                                                          "pin", "network", "supabase", "journal",
+                                                          "realtime"};
+static const char levelNames[] = {'D', 'I', 'W', 'E'};
+static_assert(sizeof(moduleNames) / sizeof(moduleNames[0]) == LOG_MODULE_COUNT, "One name per log module");
+
+static uint32_t slotSequence(uint32_t index)
+{
+  return ring[index].sequence.load(std::memory_order_acquire) + index;
+}
+
+static void setSlotSequence(uint32_t index, uint32_t sequence)
+{
+  ring[index].sequence.store(sequence - index, std::memory_order_release);
+}
+
+void logRecord(uint8_t level, LogModule module, const char *format, const uintptr_t *args, int textIndex,
+               const char *text)
+{
+  uint32_t position = ringHead.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    int32_t fill = (int32_t)(position - ringTail.load(std::memory_order_relaxed));
+    if (fill < 0)
+    {
+      // position is stale and the drain task has already moved past it
+      position = ringHead.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (fill >= LOG_RING_SIZE || (fill >= LOG_PRESSURE_FILL && level < LOG_LEVEL_WARN))
+    {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    int32_t diff = (int32_t)(slotSequence(position & (LOG_RING_SIZE - 1)) - position);
+    if (diff == 0)
+    {
+      if (ringHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+      {
+        if ((uint32_t)fill + 1 > maxFill.load(std::memory_order_relaxed))
+        {
+          maxFill.store(fill + 1, std::memory_order_relaxed);
+        }
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      // The drain task has not released this slot yet
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    else
+    {
+      position = ringHead.load(std::memory_order_relaxed);
+    }
+  }
+
+  uint32_t index = position & (LOG_RING_SIZE - 1);
+  LogRecord &record = ring[index].record;
+  record.millis = millis();
+  record.format = format;
+  memcpy(record.args, args, sizeof(record.args));
+  record.level = level;
+  record.module = module;
+  record.textIndex = textIndex;
+  if (textIndex >= 0)
+  {
+    strncpy(record.text, text ? text : "", sizeof(record.text) - 1);
+    record.text[sizeof(record.text) - 1] = '\0';
+  }
+  setSlotSequence(index, position + 1);
+  written.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void writeRecord(LogRecord &record)
+{
+  uintptr_t *a = record.args;
+  if (record.textIndex >= 0)
+  {
+    a[record.textIndex] = (uintptr_t)record.text;
+  }
+
+  char line[LOG_LINE_BYTES];
+  int length = snprintf(line, sizeof(line), "%lu.%03lu %c %s: ", (unsigned long)(record.millis / 1000),
+                        (unsigned long)(record.millis % 1000), levelNames[record.level], moduleNames[record.module]);
+  int room = sizeof(line) - length - 1;
+  int message = snprintf(&line[length], room, record.format, a[0], a[1], a[2], a[3]);
+  length += message < room ? message : room - 1;
+  line[length++] = '\n';
+  output->write((const uint8_t *)line, length);
+}
+
+// Single consumer: only the log task moves the tail
+static void drain()
+{
+  static uint32_t reportedDrops = 0;
+  uint32_t position = ringTail.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    uint32_t index = position & (LOG_RING_SIZE - 1);
+    if (slotSequence(index) != position + 1)
+    {
+      break; // Empty, or the next record is still being written
+    }
+    LogRecord record = ring[index].record;
+    setSlotSequence(index, position + LOG_RING_SIZE);
+    ringTail.store(++position, std::memory_order_relaxed);
+    writeRecord(record);
+  }
+
+  uint32_t drops = dropped.load(std::memory_order_relaxed);
+  if (drops != reportedDrops)
+  {
+    output->printf("log: %u records dropped\n", (unsigned)(drops - reportedDrops));
+    reportedDrops = drops;
+  }
+}
+
+static void logTask(void *pvParameters)
+{
+  for (;;)
+  {
+    drain();
+    vTaskDelay(LOG_DRAIN_MS / portTICK_PERIOD_MS);
+  }
+}
+
+bool logBegin(Print &out)
+{
+  output = &out;
+  if (xTaskCreatePinnedToCore(logTask, "Log", LOG_TASK_STACK, NULL, LOG_TASK_PRIORITY, NULL, TASK_CORE_NETWORK) != pdPASS)
+  {
+    out.println("Failed to create Log task");
+    return false;
+  }
+  return true;
+}
+
+void logSetLevel(LogModule module, uint8_t level)
+{
+  moduleLevels[module] = level;
+}
+
+void logSetLevelAll(uint8_t level)
+{
+  for (int i = 0; i < LOG_MODULE_COUNT; i++)
+  {
+    moduleLevels[i] = level;
+  }
+}
+
+uint8_t logLevel(LogModule module)
+{
+  return moduleLevels[module];
+}
+
+LogStats logStats()
+{
+  LogStats stats;
+  stats.written = written.load(std::memory_order_relaxed);
+  stats.dropped = dropped.load(std::memory_order_relaxed);
+  stats.maxFill = maxFill.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,126 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+class Print; // The native build formats records itself; see simulator.cpp
+#endif
+#include <type_traits>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE 4
+
+// Calls below this level compile to nothing, e.g. -DLOG_COMPILE_LEVEL=LOG_LEVEL_WARN
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_MAX_ARGS 4
+#define LOG_TEXT_BYTES 24 // Room for one string copied with logCopy()
+
+enum LogModule
+{
+  LOG_MAIN,
+  LOG_SENSORS,
+  LOG_KEYPAD,
+  LOG_RFID,
+  LOG_PIN,
+  LOG_NETWORK,
+  LOG_SUPABASE,
+  LOG_JOURNAL,
+  LOG_REALTIME,
+  LOG_MODULE_COUNT
+};
+
+struct LogStats
+{
+  uint32_t written;
+  uint32_t dropped; // ring full, or below WARN while the ring was nearly full
+  uint32_t maxFill;
+};
+
+// A string argument that is copied into the record; plain const char * arguments are
+// only formatted later, so they must be literals or otherwise outlive the record
+struct LogText
+{
+  const char *value;
+};
+
+inline LogText logCopy(const char *value)
+{
+  return LogText{value};
+}
+
+// Starts the task that formats records and writes them to out. Records logged
+// before this are kept in the ring until it runs
+bool logBegin(Print &out);
+void logSetLevel(LogModule module, uint8_t level);
+void logSetLevelAll(uint8_t level);
+uint8_t logLevel(LogModule module);
+LogStats logStats();
+
+// Reserves a slot and stores the record without formatting it; never blocks, so any task may call it
+void logRecord(uint8_t level, LogModule module, const char *format, const uintptr_t *args, int textIndex,
+               const char *text);
+
+template <typename T>
+inline uintptr_t logPack(T value, int, int &, const char *&)
+{
+  static_assert(sizeof(T) <= sizeof(uintptr_t) && !std::is_floating_point<T>::value,
+                "Log arguments must be integers or pointers");
+  return (uintptr_t)value;
+}
+
+inline uintptr_t logPack(LogText value, int index, int &textIndex, const char *&text)
+{
+  textIndex = index;
+  text = value.value;
+  return 0;
+}
+
+template <typename... Args>
+inline void logWrite(uint8_t level, LogModule module, const char *format, Args... args)
+{
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+  if (level < logLevel(module))
+  {
+    return;
+  }
+  int index = 0;
+  int textIndex = -1;
+  const char *text = NULL;
+  uintptr_t packed[LOG_MAX_ARGS + 1] = {logPack(args, index++, textIndex, text)...};
+  (void)index;
+  logRecord(level, module, format, packed, textIndex, text);
+}
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(module, ...) logWrite(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#else
+#define LOG_DEBUG(module, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(module, ...) logWrite(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#else
+#define LOG_INFO(module, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(module, ...) logWrite(LOG_LEVEL_WARN, module, __VA_ARGS__)
+#else
+#define LOG_WARN(module, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(module, ...) logWrite(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#else
+#define LOG_ERROR(module, ...) ((void)0)
+#endif
+
+#endif
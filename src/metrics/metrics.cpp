@@ -0,0 +1,235 @@
+#include "metrics.h"
+#include "../supabaseConnection/supabaseConnection.h"
+#include "../logger/logger.h"
+
+#define METRICS_KIND_BYTES 32
+#define METRICS_COMMAND_BYTES 32
+#define METRICS_UPLOAD_BYTES 3072
+
+static const char *const metricNames[METRIC_COUNT] = {
+    "Keypad loop", "Sensor loop", "Network loop", "Main loop",
+    "Mutex wait (status)", "Mutex wait (sync)", "Mutex wait (network)"};
+
+static portMUX_TYPE metricsMux = portMUX_INITIALIZER_UNLOCKED;
+static LatencyHistogram histograms[METRIC_COUNT];
+
+// Request kinds are added the first time they are seen and never removed
+static LatencyHistogram requests[METRICS_MAX_REQUEST_KINDS];
+static char requestNames[METRICS_MAX_REQUEST_KINDS][METRICS_KIND_BYTES];
+static int requestKinds = 0;
+
+// Looked up by name when reporting, since some tasks are started by other tasks after setup()
+static const char *tasks[METRICS_MAX_TASKS];
+static int taskCount = 0;
+
+static char command[METRICS_COMMAND_BYTES];
+static size_t commandLength = 0;
+static char upload[METRICS_UPLOAD_BYTES];
+
+void metricsBegin()
+{
+  for (int i = 0; i < METRIC_COUNT; i++)
+  {
+    latencyHistogramInit(histograms[i], metricNames[i]);
+  }
+}
+
+void metricsRecord(MetricId id, uint32_t micros)
+{
+  portENTER_CRITICAL(&metricsMux);
+  latencyHistogramRecord(histograms[id], micros);
+  portEXIT_CRITICAL(&metricsMux);
+}
+
+BaseType_t metricsTake(SemaphoreHandle_t mutex, MetricId id, TickType_t timeout)
+{
+  unsigned long start = micros();
+  BaseType_t taken = xSemaphoreTake(mutex, timeout);
+  metricsRecord(id, micros() - start);
+  return taken;
+}
+
+// "/rest/v1/sensor_data?select=..." becomes "sensor_data", "/auth/v1/token?..." stays "auth/v1/token"
+static void requestKind(char *out, size_t size, const char *method, const char *path)
+{
+  const char *resource = strncmp(path, "/rest/v1/", 9) == 0 ? path + 9 : path + (path[0] == '/');
+  size_t length = strcspn(resource, "?");
+  snprintf(out, size, "%s %.*s", method, (int)length, resource);
+}
+
+void metricsRecordRequest(const char *method, const char *path, uint32_t micros)
+{
+  char kind[METRICS_KIND_BYTES];
+  requestKind(kind, sizeof(kind), method, path);
+
+  // Requests are serialised by xSupabaseMutex, so only the histogram update needs the lock
+  int i = 0;
+  while (i < requestKinds && strcmp(requestNames[i], kind) != 0)
+  {
+    i++;
+  }
+  if (i == requestKinds)
+  {
+    if (requestKinds == METRICS_MAX_REQUEST_KINDS)
+    {
+      return;
+    }
+    strcpy(requestNames[i], kind);
+    latencyHistogramInit(requests[i], requestNames[i]);
+    requestKinds++;
+  }
+
+  portENTER_CRITICAL(&metricsMux);
+  latencyHistogramRecord(requests[i], micros);
+  portEXIT_CRITICAL(&metricsMux);
+}
+
+void metricsWatchTask(const char *name)
+{
+  if (taskCount < METRICS_MAX_TASKS)
+  {
+    tasks[taskCount++] = name;
+  }
+}
+
+// Lowest free stack the task has had, in bytes; -1 if it is not running
+static int stackFree(const char *name)
+{
+  TaskHandle_t handle = xTaskGetHandle(name);
+  return handle ? (int)uxTaskGetStackHighWaterMark(handle) : -1;
+}
+
+static LatencyHistogram snapshot(const LatencyHistogram &histogram)
+{
+  portENTER_CRITICAL(&metricsMux);
+  LatencyHistogram copy = histogram;
+  portEXIT_CRITICAL(&metricsMux);
+  return copy;
+}
+
+void metricsPrint(Print &out)
+{
+  for (int i = 0; i < METRIC_COUNT; i++)
+  {
+    latencyHistogramPrint(snapshot(histograms[i]), out);
+  }
+  for (int i = 0; i < requestKinds; i++)
+  {
+    latencyHistogramPrint(snapshot(requests[i]), out);
+  }
+  out.print("Stack free (bytes):");
+  for (int i = 0; i < taskCount; i++)
+  {
+    int free = stackFree(tasks[i]);
+    if (free >= 0)
+    {
+      out.printf(" %s %d", tasks[i], free);
+    }
+  }
+  out.println();
+  out.printf("Heap: %u free, %u minimum, largest block %u\n", esp_get_free_heap_size(),
+             esp_get_minimum_free_heap_size(), heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+void metricsReset()
+{
+  portENTER_CRITICAL(&metricsMux);
+  for (int i = 0; i < METRIC_COUNT; i++)
+  {
+    latencyHistogramReset(histograms[i]);
+  }
+  for (int i = 0; i < requestKinds; i++)
+  {
+    latencyHistogramReset(requests[i]);
+  }
+  portEXIT_CRITICAL(&metricsMux);
+}
+
+void metricsPoll(Stream &in, Print &out)
+{
+  while (in.available() > 0)
+  {
+    char c = in.read();
+    if (c != '\n' && c != '\r')
+    {
+      if (commandLength < sizeof(command) - 1)
+      {
+        command[commandLength++] = c;
+      }
+      continue;
+    }
+    command[commandLength] = '\0';
+    if (strcmp(command, "metrics") == 0)
+    {
+      metricsPrint(out);
+    }
+    else if (strcmp(command, "metrics reset") == 0)
+    {
+      metricsReset();
+      out.println("Metrics reset");
+    }
+    else if (commandLength > 0)
+    {
+      out.println("Commands: metrics, metrics reset");
+    }
+    commandLength = 0;
+  }
+}
+
+static bool appendRow(size_t &length, const char *metric, uint32_t count, uint32_t p50, uint32_t p99, uint32_t max)
+{
+  int written = snprintf(&upload[length], sizeof(upload) - length,
+                         "%s{\"metric\":\"%s\",\"count\":%u,\"p50_us\":%u,\"p99_us\":%u,\"max\":%u}",
+                         length > 1 ? "," : "", metric, count, p50, p99, max);
+  if (written < 0 || length + written + 2 > sizeof(upload))
+  {
+    return false;
+  }
+  length += written;
+  return true;
+}
+
+static bool appendHistogram(size_t &length, const LatencyHistogram &histogram)
+{
+  LatencyHistogram h = snapshot(histogram);
+  return appendRow(length, h.name, h.count, latencyHistogramPercentile(h, 50), latencyHistogramPercentile(h, 99),
+                   h.max);
+}
+
+int metricsUpload()
+{
+  // Stack and heap rows only fill in max: free stack bytes and minimum free heap
+  size_t length = 0;
+  upload[length++] = '[';
+  bool fits = true;
+  for (int i = 0; i < METRIC_COUNT && fits; i++)
+  {
+    fits = appendHistogram(length, histograms[i]);
+  }
+  for (int i = 0; i < requestKinds && fits; i++)
+  {
+    fits = appendHistogram(length, requests[i]);
+  }
+  for (int i = 0; i < taskCount && fits; i++)
+  {
+    int free = stackFree(tasks[i]);
+    if (free >= 0)
+    {
+      char name[METRICS_KIND_BYTES];
+      snprintf(name, sizeof(name), "Stack free (%s)", tasks[i]);
+      fits = appendRow(length, name, 0, 0, 0, free);
+    }
+  }
+  if (fits)
+  {
+    fits = appendRow(length, "Heap minimum", 0, 0, 0, esp_get_minimum_free_heap_size());
+  }
+  if (!fits)
+  {
+    LOG_ERROR(LOG_SUPABASE, "Metrics upload too large");
+    return -1;
+  }
+  upload[length++] = ']';
+  upload[length] = '\0';
+  return supabaseRequest("POST", "/rest/v1/device_metrics", upload, "return=minimal", NULL);
+}
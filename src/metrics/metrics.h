@@ -0,0 +1,44 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include "../latencyHistogram/latencyHistogram.h"
+
+#define METRICS_MAX_REQUEST_KINDS 8 // Distinct method + resource pairs timed separately
+#define METRICS_MAX_TASKS 12
+
+enum MetricId
+{
+  METRIC_KEYPAD_LOOP,    // One pass of the keypad/RFID task
+  METRIC_SENSOR_LOOP,    // One pass of the sensor task
+  METRIC_NETWORK_LOOP,   // One pass of the network task, not counting the wait for records
+  METRIC_MAIN_LOOP,      // One call of loop()
+  METRIC_MUTEX_STATUS,   // xSupabaseMutex wait before the status read
+  METRIC_MUTEX_SYNC,     // xSupabaseMutex wait before the credential sync
+  METRIC_MUTEX_NETWORK,  // xSupabaseMutex wait before a telemetry batch
+  METRIC_COUNT
+};
+
+void metricsBegin();
+
+// Cheap enough to leave on: a bucket index and a few adds under a spinlock
+void metricsRecord(MetricId id, uint32_t micros);
+// xSemaphoreTake that also records how long the take waited
+BaseType_t metricsTake(SemaphoreHandle_t mutex, MetricId id, TickType_t timeout = portMAX_DELAY);
+// Supabase request latency, kept per method and table (e.g. "PATCH sensor_data")
+void metricsRecordRequest(const char *method, const char *path, uint32_t micros);
+
+// Adds a task to the stack high-water report; name is the one given to xTaskCreate and must stay valid
+void metricsWatchTask(const char *name);
+
+void metricsPrint(Print &out);
+void metricsReset();
+
+// Serial commands, one per line: "metrics" prints the report, "metrics reset" clears the histograms
+void metricsPoll(Stream &in, Print &out);
+
+// POSTs one row per histogram, task stack and heap minimum to the device_metrics table.
+// The caller holds xSupabaseMutex; returns the HTTP status
+int metricsUpload();
+
+#endif
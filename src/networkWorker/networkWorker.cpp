@@ -0,0 +1,355 @@
+#include "networkWorker.h"
+#include "../sendToSupabaseWrite/sendToSupabaseWrite.h"
+#include "../supabaseConnection/supabaseConnection.h"
+#include "../offlineJournal/offlineJournal.h"
+#include "../logger/logger.h"
+#include "../metrics/metrics.h"
+#include "../taskMonitor/taskMonitor.h"
+
+#define NETWORK_QUEUE_LENGTH 32
+#define NETWORK_TASK_STACK 8192
+#define NETWORK_TASK_PRIORITY 1
+#define NETWORK_DEADLINE_MS 30000 // A batch may wait out two connection timeouts and a login
+#define NETWORK_STATS_INTERVAL 60000
+#define NETWORK_BATCH_WINDOW_MS 500            // Longest a record waits for others to share its request
+#define NETWORK_BATCH_MAX_ROWS TELEMETRY_COUNT // A batch holds at most one row per sensor
+#define NETWORK_REPLAY_ROWS TELEMETRY_COUNT    // Journal records taken per replay step
+
+extern int wifiStatus;
+extern SemaphoreHandle_t xSupabaseMutex;
+
+static const char *telemetryNames[TELEMETRY_COUNT] = {"motion", "vibration", "magnetic", "keypad", "rfid"};
+
+static QueueHandle_t telemetryQueue = NULL;
+static TaskHandle_t networkTaskHandle = NULL;
+
+// Newest value per sensor, used once the queue is full
+static TelemetryRecord overflowSlots[TELEMETRY_COUNT];
+static bool overflowPending[TELEMETRY_COUNT];
+static NetworkWorkerStats stats;
+static portMUX_TYPE workerMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Batch being gathered by the network task, indexed by sensor
+static TelemetryRecord batch[TELEMETRY_COUNT];
+static bool batchPending[TELEMETRY_COUNT];
+static int batchRows = 0;
+static bool batchUrgent = false;
+static unsigned long batchStartTime = 0;
+static uint32_t batchOldestTimestamp = 0;
+
+// Replay bookkeeping: journal records are older than live ones, so once the journal is
+// drained the newest live value of every replayed sensor is sent again
+static TelemetryRecord lastLive[TELEMETRY_COUNT];
+static bool hasLive[TELEMETRY_COUNT];
+static bool replayTouched[TELEMETRY_COUNT];
+static bool linkHealthy = true; // Last batch reached Supabase; replay waits for this
+
+const char *telemetryName(uint8_t id)
+{
+  return id < TELEMETRY_COUNT ? telemetryNames[id] : "";
+}
+
+static void flushBatch()
+{
+  if (batchRows == 0)
+  {
+    return;
+  }
+
+  const char *names[TELEMETRY_COUNT];
+  int values[TELEMETRY_COUNT];
+  TelemetryRecord records[TELEMETRY_COUNT];
+  int count = 0;
+  for (int i = 0; i < TELEMETRY_COUNT; i++)
+  {
+    if (batchPending[i])
+    {
+      names[count] = telemetryName(i);
+      values[count] = batch[i].value;
+      records[count] = batch[i];
+      count++;
+      batchPending[i] = false;
+    }
+  }
+  batchRows = 0;
+  batchUrgent = false;
+
+  int code = -1;
+  unsigned long start = millis();
+  if (wifiStatus && metricsTake(xSupabaseMutex, METRIC_MUTEX_NETWORK) == pdTRUE)
+  {
+    code = sendToSupabaseWriteBatch(names, values, count, "value");
+    xSemaphoreGive(xSupabaseMutex);
+    LOG_INFO(LOG_NETWORK, "Sent batch of %d rows to Supabase: HTTP %d", count, code);
+  }
+  else
+  {
+    LOG_WARN(LOG_NETWORK, "WiFi not connected, keeping %d rows for later", count);
+  }
+  uint32_t elapsed = millis() - start;
+
+  // Keep what could not be delivered; client errors (4xx) would fail again, so they are not kept
+  linkHealthy = code >= 200 && code < 300;
+  if (code < 0 || code >= 500)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      offlineJournalAppend(records[i]);
+    }
+  }
+
+  portENTER_CRITICAL(&workerMux);
+  stats.batches++;
+  stats.lastBatchRows = count;
+  stats.lastBatchMillis = elapsed;
+  if (elapsed > stats.maxBatchMillis)
+  {
+    stats.maxBatchMillis = elapsed;
+  }
+  stats.lastBatchAgeMillis = millis() - batchOldestTimestamp;
+  stats.lastHttpCode = code;
+  if (code >= 200 && code < 300)
+  {
+    stats.sent += count;
+  }
+  else
+  {
+    stats.failed += count;
+  }
+  portEXIT_CRITICAL(&workerMux);
+}
+
+static void addToBatch(const TelemetryRecord &record)
+{
+  // A second value for the same row would be lost in one upsert, so send what is gathered first
+  if (batchPending[record.id])
+  {
+    flushBatch();
+  }
+
+  if (batchRows == 0)
+  {
+    batchStartTime = millis();
+    batchOldestTimestamp = record.timestamp;
+  }
+  batch[record.id] = record;
+  batchPending[record.id] = true;
+  batchRows++;
+
+  if (record.flags & TELEMETRY_REPLAYED)
+  {
+    replayTouched[record.id] = true;
+  }
+  else
+  {
+    lastLive[record.id] = record;
+    hasLive[record.id] = true;
+  }
+
+  if (record.flags & TELEMETRY_CRITICAL)
+  {
+    batchUrgent = true;
+  }
+}
+
+// Moves the parked values into the batch; each is newer than anything that was queued for its sensor
+static void drainOverflowSlots()
+{
+  for (int i = 0; i < TELEMETRY_COUNT; i++)
+  {
+    TelemetryRecord record;
+    bool pending = false;
+
+    portENTER_CRITICAL(&workerMux);
+    if (overflowPending[i])
+    {
+      record = overflowSlots[i];
+      overflowPending[i] = false;
+      pending = true;
+    }
+    portEXIT_CRITICAL(&workerMux);
+
+    if (pending)
+    {
+      addToBatch(record);
+    }
+  }
+}
+
+// Feeds journal records into the batch path while the link is up and no live data is waiting
+static void replayJournal()
+{
+  // A new WiFi connection is worth one replay attempt even before live data has gone through
+  static int lastWifiStatus = 1;
+  if (wifiStatus && !lastWifiStatus)
+  {
+    linkHealthy = true;
+  }
+  lastWifiStatus = wifiStatus;
+
+  if (!wifiStatus || !linkHealthy || batchRows > 0 || uxQueueMessagesWaiting(telemetryQueue) > 0 || !offlineJournalPending())
+  {
+    return;
+  }
+
+  TelemetryRecord records[NETWORK_REPLAY_ROWS];
+  int count = offlineJournalReplay(records, NETWORK_REPLAY_ROWS);
+  for (int i = 0; i < count; i++)
+  {
+    records[i].flags |= TELEMETRY_REPLAYED;
+    addToBatch(records[i]);
+  }
+
+  if (count > 0 && !offlineJournalPending())
+  {
+    // Replayed values are stale; restore the current ones
+    for (int i = 0; i < TELEMETRY_COUNT; i++)
+    {
+      if (replayTouched[i] && hasLive[i])
+      {
+        TelemetryRecord record = lastLive[i];
+        record.flags &= ~TELEMETRY_CRITICAL;
+        addToBatch(record);
+      }
+      replayTouched[i] = false;
+    }
+  }
+}
+
+static void networkTask(void *pvParameters)
+{
+  TelemetryRecord record;
+  unsigned long lastStatsTime = millis();
+  int monitorId = taskMonitorRegister("Network", 100, NETWORK_DEADLINE_MS, false);
+
+  while (true)
+  {
+    taskMonitorCheckIn(monitorId);
+
+    // Sleep until the next record, or until the open batch window closes
+    TickType_t wait = 100 / portTICK_PERIOD_MS;
+    if (batchRows > 0)
+    {
+      unsigned long age = millis() - batchStartTime;
+      wait = age >= NETWORK_BATCH_WINDOW_MS ? 0 : (NETWORK_BATCH_WINDOW_MS - age) / portTICK_PERIOD_MS;
+    }
+
+    bool received = xQueueReceive(telemetryQueue, &record, wait) == pdTRUE;
+    unsigned long loopStart = micros();
+    if (received)
+    {
+      addToBatch(record);
+    }
+    if (uxQueueMessagesWaiting(telemetryQueue) == 0)
+    {
+      drainOverflowSlots();
+    }
+
+    replayJournal();
+    offlineJournalPoll();
+
+    if (batchRows > 0 && (batchUrgent || batchRows >= NETWORK_BATCH_MAX_ROWS || millis() - batchStartTime >= NETWORK_BATCH_WINDOW_MS))
+    {
+      flushBatch();
+    }
+
+    if (millis() - lastStatsTime >= NETWORK_STATS_INTERVAL)
+    {
+      lastStatsTime = millis();
+      NetworkWorkerStats s = networkWorkerStats();
+      uint32_t accepted = s.enqueued + s.parked;
+      Serial.printf("Network worker: sent %u, failed %u, parked %u, dropped %u, enqueue avg %u us max %u us\n",
+                    s.sent, s.failed, s.parked, s.dropped,
+                    accepted ? s.totalEnqueueMicros / accepted : 0, s.maxEnqueueMicros);
+      Serial.printf("Network batches: %u, last %u rows in %u ms (HTTP %d, oldest record %u ms), max %u ms\n",
+                    s.batches, s.lastBatchRows, s.lastBatchMillis, s.lastHttpCode, s.lastBatchAgeMillis, s.maxBatchMillis);
+      SupabaseConnectionStats c = supabaseConnectionStats();
+      uint32_t answered = c.requests - c.failures;
+      Serial.printf("Supabase connection: %u requests, %u reused, %u handshakes (last %u ms), %u failed, latency avg %u ms max %u ms\n",
+                    c.requests, c.reused, c.handshakes, c.lastHandshakeMs, c.failures,
+                    answered ? c.totalLatencyMs / answered : 0, c.maxLatencyMs);
+      Serial.printf("Supabase session: %s, %u password logins, %u token refreshes, %u failures\n",
+                    supabaseSessionValid() ? "valid" : "none", c.passwordLogins, c.tokenRefreshes, c.authFailures);
+      OfflineJournalStats j = offlineJournalStats();
+      Serial.printf("Offline journal: %u pending, %u appended in %u flash writes (%u bytes), %u replayed, %u dropped, %u overwritten, %u CRC errors\n",
+                    j.pending, j.appended, j.flashWrites, j.bytesWritten, j.replayed, j.dropped, j.overwritten, j.crcErrors);
+    }
+    metricsRecord(METRIC_NETWORK_LOOP, micros() - loopStart);
+  }
+}
+
+bool networkWorkerBegin()
+{
+  offlineJournalBegin();
+
+  telemetryQueue = xQueueCreate(NETWORK_QUEUE_LENGTH, sizeof(TelemetryRecord));
+  if (telemetryQueue == NULL)
+  {
+    Serial.println("Failed to create telemetry queue");
+    return false;
+  }
+
+  if (xTaskCreatePinnedToCore(networkTask, "Network", NETWORK_TASK_STACK, NULL, NETWORK_TASK_PRIORITY, &networkTaskHandle,
+                              TASK_CORE_NETWORK) != pdPASS)
+  {
+    Serial.println("Failed to create Network task");
+    return false;
+  }
+  return true;
+}
+
+// Never blocks: when the queue is full the value replaces any parked value for the same sensor.
+// Critical records (alarms) close the current batch window as soon as they reach the network task.
+void networkWorkerEnqueue(TelemetryId id, int value, bool critical)
+{
+  if (telemetryQueue == NULL || id >= TELEMETRY_COUNT)
+  {
+    return;
+  }
+
+  unsigned long start = micros();
+  TelemetryRecord record = {(uint8_t)id, (uint8_t)(critical ? TELEMETRY_CRITICAL : 0), value, (uint32_t)millis()};
+
+  // Once a sensor has a parked value, later values must also go to its slot to keep them in order
+  bool parked = false;
+  portENTER_CRITICAL(&workerMux);
+  parked = overflowPending[id];
+  portEXIT_CRITICAL(&workerMux);
+
+  if (parked || xQueueSend(telemetryQueue, &record, 0) != pdTRUE)
+  {
+    portENTER_CRITICAL(&workerMux);
+    if (overflowPending[id])
+    {
+      stats.dropped++;
+      record.flags |= overflowSlots[id].flags;
+    }
+    overflowSlots[id] = record;
+    overflowPending[id] = true;
+    stats.parked++;
+    portEXIT_CRITICAL(&workerMux);
+  }
+  else
+  {
+    portENTER_CRITICAL(&workerMux);
+    stats.enqueued++;
+    portEXIT_CRITICAL(&workerMux);
+  }
+
+  uint32_t elapsed = micros() - start;
+  portENTER_CRITICAL(&workerMux);
+  stats.totalEnqueueMicros += elapsed;
+  if (elapsed > stats.maxEnqueueMicros)
+  {
+    stats.maxEnqueueMicros = elapsed;
+  }
+  portEXIT_CRITICAL(&workerMux);
+}
+
+NetworkWorkerStats networkWorkerStats()
+{
+  portENTER_CRITICAL(&workerMux);
+  NetworkWorkerStats copy = stats;
+  portEXIT_CRITICAL(&workerMux);
+  return copy;
+}
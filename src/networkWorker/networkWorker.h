@@ -0,0 +1,42 @@
+#ifndef NETWORK_WORKER_H
+#define NETWORK_WORKER_H
+
+#include <Arduino.h>
+#include "../hal/hal.h"
+
+// Record flags
+#define TELEMETRY_CRITICAL 0x01 // Flush the current batch immediately instead of waiting for the window
+#define TELEMETRY_REPLAYED 0x02 // Record comes from the offline journal
+
+struct TelemetryRecord
+{
+  uint8_t id;
+  uint8_t flags;
+  int32_t value;
+  uint32_t timestamp; // millis() when the value was produced
+};
+
+struct NetworkWorkerStats
+{
+  uint32_t enqueued;           // records accepted by the queue
+  uint32_t parked;             // records stored in a per-sensor overflow slot because the queue was full
+  uint32_t dropped;            // parked records replaced by a newer value before they were sent
+  uint32_t sent;               // records written to Supabase
+  uint32_t failed;             // records whose write failed; retryable ones go to the offline journal
+  uint32_t maxEnqueueMicros;   // worst time a producer spent in networkWorkerEnqueue()
+  uint32_t totalEnqueueMicros; // divide by enqueued + parked for the mean
+  uint32_t batches;            // upsert requests made
+  uint32_t lastBatchRows;
+  uint32_t lastBatchMillis;    // request time of the last batch
+  uint32_t maxBatchMillis;
+  uint32_t lastBatchAgeMillis; // time from the oldest record in the last batch to its response
+  int lastHttpCode;
+};
+
+const char *telemetryName(uint8_t id);
+
+bool networkWorkerBegin();
+void networkWorkerEnqueue(TelemetryId id, int value, bool critical = false);
+NetworkWorkerStats networkWorkerStats();
+
+#endif
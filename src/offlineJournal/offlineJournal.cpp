@@ -0,0 +1,381 @@
+#include "offlineJournal.h"
+#include <LittleFS.h>
+#include "../logger/logger.h"
+
+#define JOURNAL_DIR "/journal"
+#define JOURNAL_SEGMENTS 8            // Segments are reused round-robin so wear spreads over all of them
+#define JOURNAL_SEGMENT_RECORDS 256   // 4 KB per segment, one flash sector
+#define JOURNAL_BUFFER_RECORDS 8      // Records gathered in RAM before one flash append
+#define JOURNAL_FLUSH_MS 5000         // Longest a record stays in RAM only
+#define JOURNAL_MIN_FLUSH_MS 1000     // At most one flash append per interval, even for critical records
+#define JOURNAL_REPLAY_PER_SECOND 10  // Replay throughput limit
+#define JOURNAL_REPLAY_BURST 20
+
+// Fixed-size record as stored in flash
+struct __attribute__((packed)) JournalEntry
+{
+  uint32_t sequence;
+  uint32_t timestamp;
+  int32_t value;
+  uint8_t id;
+  uint8_t flags;
+  uint16_t crc;
+};
+
+static bool mounted = false;
+static int readSegment = 0;
+static uint32_t readIndex = 0; // Next record to replay in readSegment
+static int writeSegment = 0;
+static uint32_t writeCount = 0; // Records stored in writeSegment
+static uint32_t nextSequence = 1;
+
+static JournalEntry buffer[JOURNAL_BUFFER_RECORDS];
+static int bufferCount = 0;
+static int bufferRead = 0; // Buffered records already handed to replay
+static unsigned long bufferSince = 0;
+static unsigned long lastFlushTime = 0;
+
+static unsigned long lastReplayTime = 0;
+static uint32_t replayCredit = JOURNAL_REPLAY_BURST;
+
+static OfflineJournalStats stats;
+
+static uint16_t crc16(const uint8_t *data, size_t length)
+{
+  uint16_t crc = 0xFFFF;
+  while (length--)
+  {
+    crc ^= (uint16_t)*data++ << 8;
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static bool entryValid(const JournalEntry &entry)
+{
+  return entry.crc == crc16((const uint8_t *)&entry, offsetof(JournalEntry, crc));
+}
+
+static void segmentPath(int segment, char *path, size_t length)
+{
+  snprintf(path, length, JOURNAL_DIR "/%d.bin", segment);
+}
+
+static uint32_t segmentRecords(int segment)
+{
+  char path[24];
+  segmentPath(segment, path, sizeof(path));
+  File file = LittleFS.open(path, "r");
+  if (!file)
+  {
+    return 0;
+  }
+  uint32_t records = file.size() / sizeof(JournalEntry);
+  file.close();
+  return records;
+}
+
+static bool readEntry(int segment, uint32_t index, JournalEntry &entry)
+{
+  char path[24];
+  segmentPath(segment, path, sizeof(path));
+  File file = LittleFS.open(path, "r");
+  if (!file)
+  {
+    return false;
+  }
+  bool ok = file.seek(index * sizeof(JournalEntry)) && file.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+  return ok;
+}
+
+static void removeSegment(int segment)
+{
+  char path[24];
+  segmentPath(segment, path, sizeof(path));
+  LittleFS.remove(path);
+}
+
+static uint32_t flashPending()
+{
+  if (readSegment == writeSegment)
+  {
+    return writeCount - readIndex;
+  }
+  uint32_t pending = segmentRecords(readSegment) - readIndex;
+  for (int s = (readSegment + 1) % JOURNAL_SEGMENTS; s != writeSegment; s = (s + 1) % JOURNAL_SEGMENTS)
+  {
+    pending += segmentRecords(s);
+  }
+  return pending + writeCount;
+}
+
+// Rebuilds the read and write positions from the segments left by the previous boot.
+// Replay progress is not stored, so a partly replayed segment is sent again; upserts make that harmless.
+static void recover()
+{
+  bool found = false;
+  uint32_t oldest = 0, newest = 0;
+
+  for (int s = 0; s < JOURNAL_SEGMENTS; s++)
+  {
+    JournalEntry first;
+    uint32_t records = segmentRecords(s);
+    if (records == 0 || !readEntry(s, 0, first) || !entryValid(first))
+    {
+      if (records > 0)
+      {
+        stats.crcErrors++;
+      }
+      removeSegment(s);
+      continue;
+    }
+    if (!found || first.sequence < oldest)
+    {
+      oldest = first.sequence;
+      readSegment = s;
+    }
+    if (!found || first.sequence > newest)
+    {
+      newest = first.sequence;
+      writeSegment = s;
+    }
+    found = true;
+  }
+
+  readIndex = 0;
+  writeCount = found ? segmentRecords(writeSegment) : 0;
+
+  JournalEntry last;
+  if (writeCount > 0 && readEntry(writeSegment, writeCount - 1, last) && entryValid(last))
+  {
+    nextSequence = last.sequence + 1;
+  }
+  else
+  {
+    nextSequence = newest + writeCount + 1;
+  }
+}
+
+bool offlineJournalBegin()
+{
+  if (!LittleFS.begin(true))
+  {
+    Serial.println("Failed to mount LittleFS, offline journal disabled");
+    return false;
+  }
+  LittleFS.mkdir(JOURNAL_DIR);
+  mounted = true;
+  recover();
+  stats.pending = flashPending();
+  Serial.printf("Offline journal: %u records waiting for replay\n", stats.pending);
+  return true;
+}
+
+// Writes the buffered records, moving to the next segment when one fills
+static bool flush(bool force)
+{
+  if (bufferCount == bufferRead)
+  {
+    bufferCount = bufferRead = 0;
+    return true;
+  }
+  if (!force && millis() - lastFlushTime < JOURNAL_MIN_FLUSH_MS)
+  {
+    return false;
+  }
+
+  int index = bufferRead;
+  while (index < bufferCount)
+  {
+    if (writeCount == JOURNAL_SEGMENT_RECORDS)
+    {
+      int next = (writeSegment + 1) % JOURNAL_SEGMENTS;
+      if (next == readSegment)
+      {
+        // Journal full: give up the oldest segment
+        uint32_t lost = segmentRecords(readSegment) - readIndex;
+        stats.overwritten += lost;
+        stats.pending -= lost;
+        removeSegment(readSegment);
+        readSegment = (readSegment + 1) % JOURNAL_SEGMENTS;
+        readIndex = 0;
+      }
+      removeSegment(next);
+      writeSegment = next;
+      writeCount = 0;
+    }
+
+    int count = bufferCount - index;
+    if ((uint32_t)count > JOURNAL_SEGMENT_RECORDS - writeCount)
+    {
+      count = JOURNAL_SEGMENT_RECORDS - writeCount;
+    }
+
+    char path[24];
+    segmentPath(writeSegment, path, sizeof(path));
+    File file = LittleFS.open(path, FILE_APPEND);
+    size_t bytes = count * sizeof(JournalEntry);
+    bool ok = file && file.write((const uint8_t *)&buffer[index], bytes) == bytes;
+    if (file)
+    {
+      file.close();
+    }
+    if (!ok)
+    {
+      LOG_ERROR(LOG_JOURNAL, "Offline journal write failed");
+      break;
+    }
+
+    stats.flashWrites++;
+    stats.bytesWritten += bytes;
+    writeCount += count;
+    index += count;
+  }
+
+  // Anything not written stays buffered for the next attempt
+  memmove(buffer, &buffer[index], (bufferCount - index) * sizeof(JournalEntry));
+  bufferCount -= index;
+  bufferRead = 0;
+  lastFlushTime = millis();
+  return bufferCount == 0;
+}
+
+bool offlineJournalAppend(const TelemetryRecord &record)
+{
+  if (!mounted)
+  {
+    stats.dropped++;
+    return false;
+  }
+  if (bufferCount == JOURNAL_BUFFER_RECORDS && !flush(false))
+  {
+    stats.dropped++;
+    return false;
+  }
+
+  JournalEntry &entry = buffer[bufferCount++];
+  entry.sequence = nextSequence++;
+  entry.timestamp = record.timestamp;
+  entry.value = record.value;
+  entry.id = record.id;
+  entry.flags = record.flags;
+  entry.crc = crc16((const uint8_t *)&entry, offsetof(JournalEntry, crc));
+
+  if (bufferCount == 1)
+  {
+    bufferSince = millis();
+  }
+  stats.appended++;
+  stats.pending++;
+
+  if ((record.flags & TELEMETRY_CRITICAL) || bufferCount == JOURNAL_BUFFER_RECORDS)
+  {
+    flush(false);
+  }
+  return true;
+}
+
+void offlineJournalPoll()
+{
+  if (mounted && bufferCount > bufferRead && millis() - bufferSince >= JOURNAL_FLUSH_MS)
+  {
+    flush(false);
+  }
+}
+
+bool offlineJournalPending()
+{
+  return stats.pending > 0;
+}
+
+int offlineJournalReplay(TelemetryRecord *out, int max)
+{
+  if (!mounted || stats.pending == 0)
+  {
+    return 0;
+  }
+
+  // Earn replay credit at the configured rate, up to one burst
+  unsigned long now = millis();
+  uint32_t earned = (now - lastReplayTime) * JOURNAL_REPLAY_PER_SECOND / 1000;
+  if (earned > 0)
+  {
+    replayCredit += earned;
+    if (replayCredit > JOURNAL_REPLAY_BURST)
+    {
+      replayCredit = JOURNAL_REPLAY_BURST;
+    }
+    lastReplayTime = now;
+  }
+  if ((uint32_t)max > replayCredit)
+  {
+    max = replayCredit;
+  }
+
+  int count = 0;
+  while (count < max && stats.pending > 0)
+  {
+    JournalEntry entry;
+    bool fromFlash = readSegment != writeSegment || readIndex < writeCount;
+
+    if (fromFlash)
+    {
+      if (readSegment != writeSegment && readIndex >= segmentRecords(readSegment))
+      {
+        // Segment fully replayed
+        removeSegment(readSegment);
+        readSegment = (readSegment + 1) % JOURNAL_SEGMENTS;
+        readIndex = 0;
+        continue;
+      }
+      bool ok = readEntry(readSegment, readIndex, entry);
+      readIndex++;
+      stats.pending--;
+      if (!ok || !entryValid(entry))
+      {
+        stats.crcErrors++;
+        continue;
+      }
+      if (readSegment == writeSegment && readIndex == writeCount)
+      {
+        // Everything on flash has been replayed, so start the next outage on an empty segment
+        removeSegment(writeSegment);
+        readIndex = writeCount = 0;
+      }
+    }
+    else if (bufferRead < bufferCount)
+    {
+      // Newest records have not reached flash yet
+      entry = buffer[bufferRead++];
+      stats.pending--;
+      if (bufferRead == bufferCount)
+      {
+        bufferCount = bufferRead = 0;
+      }
+    }
+    else
+    {
+      stats.pending = 0;
+      break;
+    }
+
+    out[count].id = entry.id;
+    out[count].flags = entry.flags & ~TELEMETRY_CRITICAL;
+    out[count].value = entry.value;
+    out[count].timestamp = entry.timestamp;
+    count++;
+  }
+
+  replayCredit -= count;
+  stats.replayed += count;
+  return count;
+}
+
+OfflineJournalStats offlineJournalStats()
+{
+  return stats;
+}
@@ -0,0 +1,31 @@
+#ifndef OFFLINE_JOURNAL_H
+#define OFFLINE_JOURNAL_H
+
+#include <Arduino.h>
+#include "../networkWorker/networkWorker.h"
+
+struct OfflineJournalStats
+{
+  uint32_t appended;    // records accepted into the journal
+  uint32_t flashWrites; // append operations on flash, each covering up to JOURNAL_BUFFER_RECORDS records
+  uint32_t bytesWritten;
+  uint32_t dropped;     // records refused because the write rate limit was reached
+  uint32_t overwritten; // unreplayed records lost because the journal wrapped
+  uint32_t crcErrors;   // records skipped during replay or recovery
+  uint32_t replayed;
+  uint32_t pending;     // records waiting for replay, in flash and in RAM
+};
+
+bool offlineJournalBegin();
+
+// Called only from the network task; none of these block on the network
+bool offlineJournalAppend(const TelemetryRecord &record);
+void offlineJournalPoll();
+bool offlineJournalPending();
+
+// Returns up to max of the oldest records, oldest first, within the replay rate limit
+int offlineJournalReplay(TelemetryRecord *out, int max);
+
+OfflineJournalStats offlineJournalStats();
+
+#endif
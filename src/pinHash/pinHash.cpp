@@ -0,0 +1,147 @@
+#include "pinHash.h"
+#include <string.h>
+
+#ifdef ESP32
+#include "sha/sha_parallel_engine.h"
+#endif
+
+#define PIN_MAX_INPUT 64 // Salt plus the longest PIN the keypad accepts
+
+static const uint32_t roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t rotr(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+static void compressBlock(uint32_t state[8], const uint8_t block[64])
+{
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+  {
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+  }
+  for (int i = 16; i < 64; i++)
+  {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int i = 0; i < 64; i++)
+  {
+    uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + roundConstants[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+void pinHashSha256Software(const uint8_t *data, size_t length, uint8_t out[PIN_HASH_BYTES])
+{
+  uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                       0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  size_t offset = 0;
+  while (length - offset >= 64)
+  {
+    compressBlock(state, data + offset);
+    offset += 64;
+  }
+
+  // Padding: 0x80, zeros, then the message length in bits as a big-endian 64-bit value
+  uint8_t block[128];
+  size_t rest = length - offset;
+  memset(block, 0, sizeof(block));
+  memcpy(block, data + offset, rest);
+  block[rest] = 0x80;
+  size_t blocks = rest < 56 ? 1 : 2;
+  uint64_t bits = (uint64_t)length * 8;
+  for (int i = 0; i < 8; i++)
+  {
+    block[blocks * 64 - 1 - i] = bits >> (i * 8);
+  }
+  for (size_t i = 0; i < blocks; i++)
+  {
+    compressBlock(state, block + i * 64);
+  }
+
+  for (int i = 0; i < 8; i++)
+  {
+    out[i * 4] = state[i] >> 24;
+    out[i * 4 + 1] = state[i] >> 16;
+    out[i * 4 + 2] = state[i] >> 8;
+    out[i * 4 + 3] = state[i];
+  }
+}
+
+bool pinHashHardwareAvailable()
+{
+#ifdef ESP32
+  return true;
+#else
+  return false;
+#endif
+}
+
+void pinHashSha256(const uint8_t *data, size_t length, uint8_t out[PIN_HASH_BYTES], bool hardware)
+{
+#ifdef ESP32
+  if (hardware)
+  {
+    // Takes the engine lock, so it is safe alongside TLS using the same accelerator
+    esp_sha(SHA2_256, data, length, out);
+    return;
+  }
+#else
+  (void)hardware; // No accelerator off the device
+#endif
+  pinHashSha256Software(data, length, out);
+}
+
+void pinHashSalted(const uint8_t salt[PIN_SALT_BYTES], const char *digits, uint8_t length,
+                   uint8_t out[PIN_HASH_BYTES], bool hardware)
+{
+  uint8_t input[PIN_MAX_INPUT];
+  if (length > PIN_MAX_INPUT - PIN_SALT_BYTES)
+  {
+    length = PIN_MAX_INPUT - PIN_SALT_BYTES;
+  }
+  memcpy(input, salt, PIN_SALT_BYTES);
+  memcpy(input + PIN_SALT_BYTES, digits, length);
+  pinHashSha256(input, PIN_SALT_BYTES + length, out, hardware);
+  memset(input, 0, sizeof(input));
+}
+
+bool pinHashEqual(const uint8_t *a, const uint8_t *b, size_t length)
+{
+  uint8_t diff = 0;
+  for (size_t i = 0; i < length; i++)
+  {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
@@ -0,0 +1,25 @@
+#ifndef PIN_HASH_H
+#define PIN_HASH_H
+
+// The hardware path needs the ESP32 SHA engine; other builds hash in software
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PIN_HASH_BYTES 32
+#define PIN_SALT_BYTES 16
+
+// True when pinHashSha256 can use the hardware accelerator on this build
+bool pinHashHardwareAvailable();
+
+void pinHashSha256Software(const uint8_t *data, size_t length, uint8_t out[PIN_HASH_BYTES]);
+void pinHashSha256(const uint8_t *data, size_t length, uint8_t out[PIN_HASH_BYTES], bool hardware);
+
+// SHA-256 over salt followed by the PIN digits
+void pinHashSalted(const uint8_t salt[PIN_SALT_BYTES], const char *digits, uint8_t length,
+                   uint8_t out[PIN_HASH_BYTES], bool hardware);
+
+// Compares every byte whatever the first mismatch, so the time taken says nothing about the hash
+bool pinHashEqual(const uint8_t *a, const uint8_t *b, size_t length);
+
+#endif
@@ -0,0 +1,47 @@
+#include "pinLockout.h"
+
+void pinLockoutInit(PinLockout &lockout)
+{
+  lockout.failures = 0;
+  lockout.lockedOut = false;
+  lockout.startMs = 0;
+  lockout.durationMs = 0;
+  lockout.nextMs = PIN_LOCKOUT_MS;
+}
+
+uint32_t pinLockoutRemaining(PinLockout &lockout, uint32_t now)
+{
+  if (!lockout.lockedOut)
+  {
+    return 0;
+  }
+  uint32_t elapsed = now - lockout.startMs;
+  if (elapsed >= lockout.durationMs)
+  {
+    lockout.lockedOut = false;
+    return 0;
+  }
+  return lockout.durationMs - elapsed;
+}
+
+void pinLockoutSuccess(PinLockout &lockout)
+{
+  lockout.failures = 0;
+  lockout.nextMs = PIN_LOCKOUT_MS;
+}
+
+bool pinLockoutFailure(PinLockout &lockout, uint32_t now)
+{
+  if (++lockout.failures < PIN_MAX_FAILURES)
+  {
+    return false;
+  }
+  lockout.failures = 0;
+  lockout.lockedOut = true;
+  lockout.startMs = now;
+  lockout.durationMs = lockout.nextMs;
+  // The next lockout, if the guessing goes on, lasts twice as long
+  uint32_t next = lockout.nextMs * 2;
+  lockout.nextMs = next > PIN_LOCKOUT_MAX_MS ? PIN_LOCKOUT_MAX_MS : next;
+  return true;
+}
@@ -0,0 +1,27 @@
+#ifndef PIN_LOCKOUT_H
+#define PIN_LOCKOUT_H
+
+#include <stdint.h>
+
+#define PIN_MAX_FAILURES 5      // Consecutive failures before a lockout
+#define PIN_LOCKOUT_MS 30000    // First lockout; each further one doubles
+#define PIN_LOCKOUT_MAX_MS 900000
+
+struct PinLockout
+{
+  uint8_t failures;
+  bool lockedOut;
+  uint32_t startMs;
+  uint32_t durationMs; // Length of the current or last lockout
+  uint32_t nextMs;     // Length of the next one
+};
+
+void pinLockoutInit(PinLockout &lockout);
+// Milliseconds left at now, 0 when entries are accepted
+uint32_t pinLockoutRemaining(PinLockout &lockout, uint32_t now);
+// An accepted PIN clears the failures and the doubling
+void pinLockoutSuccess(PinLockout &lockout);
+// Counts a rejected PIN; returns true when it started a lockout
+bool pinLockoutFailure(PinLockout &lockout, uint32_t now);
+
+#endif
@@ -0,0 +1,255 @@
+#include "pinStore.h"
+#include <Preferences.h>
+#include "../sendToSupabaseRead/sendToSupabaseRead.h"
+#include "../pinLockout/pinLockout.h"
+#include "../logger/logger.h"
+
+#define PIN_NVS_NAMESPACE "pins"
+
+struct PinUser
+{
+  int32_t id;
+  uint8_t salt[PIN_SALT_BYTES];
+  uint8_t hash[PIN_HASH_BYTES];
+};
+
+static PinUser users[PIN_STORE_MAX_USERS];
+static int userCount = 0;
+static PinUser staging[PIN_STORE_MAX_USERS]; // Sync builds the next set here, then swaps it in
+static SemaphoreHandle_t storeMutex = NULL;
+
+static PinLockout lockout;
+
+static PinStoreStats stats;
+
+static bool hexToBytes(const char *hex, uint8_t *out, size_t length)
+{
+  if (hex == NULL || strlen(hex) != length * 2)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++)
+  {
+    char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+    char *end;
+    out[i] = strtoul(byte, &end, 16);
+    if (*end != '\0')
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool loadUsers()
+{
+  Preferences prefs;
+  if (!prefs.begin(PIN_NVS_NAMESPACE, true))
+  {
+    return false;
+  }
+  size_t size = prefs.getBytes("users", users, sizeof(users));
+  prefs.end();
+  if (size == 0 || size % sizeof(PinUser) != 0)
+  {
+    return false;
+  }
+  userCount = size / sizeof(PinUser);
+  return true;
+}
+
+static bool saveUsers()
+{
+  Preferences prefs;
+  if (!prefs.begin(PIN_NVS_NAMESPACE, false))
+  {
+    LOG_ERROR(LOG_PIN, "Failed to open PIN store in NVS");
+    return false;
+  }
+  size_t size = userCount * sizeof(PinUser);
+  bool ok = prefs.putBytes("users", users, size) == size;
+  prefs.end();
+  if (!ok)
+  {
+    LOG_ERROR(LOG_PIN, "Failed to save PIN store");
+    return false;
+  }
+  stats.saves++;
+  return true;
+}
+
+bool pinStoreBegin(const char *defaultPin)
+{
+  storeMutex = xSemaphoreCreateMutex();
+  if (storeMutex == NULL)
+  {
+    Serial.println("Failed to create PIN store mutex");
+    return false;
+  }
+  pinLockoutInit(lockout);
+
+  if (loadUsers())
+  {
+    Serial.printf("PIN store: %d users from NVS\n", userCount);
+  }
+  else
+  {
+    // Not saved, so the backend's list takes over as soon as it is first read
+    PinUser &user = users[0];
+    user.id = 0;
+    esp_fill_random(user.salt, sizeof(user.salt));
+    pinHashSalted(user.salt, defaultPin, strlen(defaultPin), user.hash, pinHashHardwareAvailable());
+    userCount = 1;
+    Serial.println("PIN store: default PIN only");
+  }
+  stats.users = userCount;
+  return true;
+}
+
+// Hashes against every user whatever matches, so the time taken does not depend on which one did
+static int findUser(const char *digits, uint8_t length, bool hardware)
+{
+  int match = -1;
+  uint8_t hash[PIN_HASH_BYTES];
+  for (int i = 0; i < userCount; i++)
+  {
+    pinHashSalted(users[i].salt, digits, length, hash, hardware);
+    if (pinHashEqual(hash, users[i].hash, PIN_HASH_BYTES) && match < 0)
+    {
+      match = i;
+    }
+  }
+  memset(hash, 0, sizeof(hash));
+  return match < 0 ? -1 : users[match].id;
+}
+
+uint32_t pinStoreLockoutRemaining()
+{
+  return pinLockoutRemaining(lockout, millis());
+}
+
+PinResult pinStoreVerify(const char *digits, uint8_t length, int &userId)
+{
+  if (pinStoreLockoutRemaining() > 0)
+  {
+    stats.lockedAttempts++;
+    return PIN_LOCKED_OUT;
+  }
+
+  unsigned long start = micros();
+  xSemaphoreTake(storeMutex, portMAX_DELAY);
+  int id = findUser(digits, length, pinHashHardwareAvailable());
+  xSemaphoreGive(storeMutex);
+  uint32_t elapsed = micros() - start;
+
+  stats.verifications++;
+  if (elapsed > stats.maxVerifyMicros)
+  {
+    stats.maxVerifyMicros = elapsed;
+  }
+
+  if (id >= 0)
+  {
+    stats.accepted++;
+    pinLockoutSuccess(lockout);
+    userId = id;
+    return PIN_ACCEPTED;
+  }
+
+  stats.rejected++;
+  if (pinLockoutFailure(lockout, millis()))
+  {
+    stats.lockouts++;
+    LOG_WARN(LOG_PIN, "PIN entry locked for %u s", lockout.durationMs / 1000);
+  }
+  return PIN_REJECTED;
+}
+
+int pinStoreSync()
+{
+  stats.syncs++;
+  char path[96];
+  snprintf(path, sizeof(path), "/rest/v1/keypad_users?select=id,salt,pin_hash&active=is.true&order=id.asc&limit=%d",
+           PIN_STORE_MAX_USERS);
+  const char *fields[] = {"id", "salt", "pin_hash"};
+  SupabaseRows rows(path, fields, 3);
+
+  int count = 0;
+  while (count < PIN_STORE_MAX_USERS && rows.next())
+  {
+    JsonObjectConst row = rows.row();
+    PinUser &user = staging[count];
+    user.id = row["id"] | -1;
+    if (user.id < 0 || !hexToBytes(row["salt"], user.salt, PIN_SALT_BYTES) ||
+        !hexToBytes(row["pin_hash"], user.hash, PIN_HASH_BYTES))
+    {
+      LOG_WARN(LOG_PIN, "Bad keypad_users row");
+      continue;
+    }
+    count++;
+  }
+  // Staged users are only applied once the whole list has arrived
+  if (rows.failed())
+  {
+    LOG_WARN(LOG_PIN, "PIN store sync result: %d", rows.status());
+    stats.syncFailures++;
+    return -1;
+  }
+
+  // An empty list would lock everyone out, which is more likely a missing table than intent
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  xSemaphoreTake(storeMutex, portMAX_DELAY);
+  bool changed = count != userCount || memcmp(staging, users, count * sizeof(PinUser)) != 0;
+  if (changed)
+  {
+    memcpy(users, staging, count * sizeof(PinUser));
+    userCount = count;
+  }
+  xSemaphoreGive(storeMutex);
+
+  if (changed)
+  {
+    saveUsers();
+  }
+  stats.users = userCount;
+  return count;
+}
+
+void pinStoreBenchmark(Print &out, int iterations)
+{
+  const char wrong[] = "00000000";
+  for (int pass = 0; pass < 2; pass++)
+  {
+    bool hardware = pass == 0;
+    if (hardware && !pinHashHardwareAvailable())
+    {
+      continue;
+    }
+    uint32_t total = 0;
+    uint32_t worst = 0;
+    xSemaphoreTake(storeMutex, portMAX_DELAY);
+    for (int i = 0; i < iterations; i++)
+    {
+      unsigned long start = micros();
+      findUser(wrong, PIN_MAX_DIGITS, hardware);
+      uint32_t elapsed = micros() - start;
+      total += elapsed;
+      if (elapsed > worst)
+      {
+        worst = elapsed;
+      }
+    }
+    xSemaphoreGive(storeMutex);
+    out.printf("PIN verify (%s SHA): mean %u us, max %u us over %d runs, %d users\n",
+               hardware ? "hardware" : "software", iterations ? total / iterations : 0, worst, iterations, userCount);
+  }
+}
+
+PinStoreStats pinStoreStats()
+{
+  return stats;
+}
@@ -0,0 +1,48 @@
+#ifndef PIN_STORE_H
+#define PIN_STORE_H
+
+#include <Arduino.h>
+#include "../pinHash/pinHash.h"
+
+#define PIN_STORE_MAX_USERS 32
+#define PIN_MAX_DIGITS 8
+
+enum PinResult
+{
+  PIN_ACCEPTED,
+  PIN_REJECTED,
+  PIN_LOCKED_OUT // too many failures; the PIN was not checked
+};
+
+struct PinStoreStats
+{
+  uint32_t users;
+  uint32_t verifications;
+  uint32_t accepted;
+  uint32_t rejected;
+  uint32_t lockouts;
+  uint32_t lockedAttempts; // entries refused during a lockout
+  uint32_t maxVerifyMicros;
+  uint32_t syncs;
+  uint32_t syncFailures;
+  uint32_t saves;
+};
+
+// Loads the users saved in NVS; with none saved yet, defaultPin is the only user until the first sync
+bool pinStoreBegin(const char *defaultPin);
+
+// Checks the digits against every user; userId is set when accepted
+PinResult pinStoreVerify(const char *digits, uint8_t length, int &userId);
+// Milliseconds left in the current lockout, 0 when entries are accepted
+uint32_t pinStoreLockoutRemaining();
+
+// Replaces the users with the active keypad_users rows in one batch and saves them if they changed.
+// Call with xSupabaseMutex held. Returns the users loaded, or -1 on failure
+int pinStoreSync();
+
+// Times verification of a wrong PIN against all users with the hardware and software SHA paths
+void pinStoreBenchmark(Print &out, int iterations);
+
+PinStoreStats pinStoreStats();
+
+#endif
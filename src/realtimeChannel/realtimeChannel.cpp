@@ -0,0 +1,487 @@
+#include "realtimeChannel.h"
+#include <WiFiClientSecure.h>
+#include <ArduinoJson.h>
+#include "../supabaseConnection/supabaseConnection.h"
+#include "../wifiManager/wifiManager.h"
+#include "../configSync/configSync.h"
+#include "../jsonArena/jsonArena.h"
+#include "../taskMonitor/taskMonitor.h"
+#include "../logger/logger.h"
+#include "../wsFrame/wsFrame.h"
+
+#define REALTIME_TASK_STACK 6144 // The TLS handshake runs on this stack
+#define REALTIME_TASK_PRIORITY 1
+#define REALTIME_LOOP_MS 20
+#define REALTIME_DEADLINE_MS 30000
+#define REALTIME_TIMEOUT_MS 5000
+#define REALTIME_HEARTBEAT_MS 25000 // Phoenix closes a socket that has sent nothing for 60 s
+#define REALTIME_SILENCE_MS 60000   // Heartbeats are answered, so this long without a frame means the socket is dead
+#define REALTIME_BACKOFF_MIN_MS 1000
+#define REALTIME_BACKOFF_MAX_MS 60000
+#define REALTIME_FRAME_BYTES 2048 // One change event with its column list fits comfortably
+#define REALTIME_MESSAGE_BYTES (SUPABASE_TOKEN_BYTES + 384)
+#define REALTIME_TOPIC_BYTES 64
+#define REALTIME_LINE_BYTES 128
+
+extern SemaphoreHandle_t xSupabaseMutex;
+
+static WiFiClientSecure secureClient;
+static WiFiClient plainClient;
+static WiFiClient *client = REALTIME_TLS ? (WiFiClient *)&secureClient : &plainClient;
+
+static const char *tableName;
+static char topic[REALTIME_TOPIC_BYTES];
+static char frame[REALTIME_FRAME_BYTES + 1];
+static char message[REALTIME_MESSAGE_BYTES];
+static uint8_t outFrame[REALTIME_MESSAGE_BYTES + 8];
+static char token[SUPABASE_TOKEN_BYTES];
+static char line[REALTIME_LINE_BYTES];
+static JsonDocument filter; // Built once in realtimeBegin(), while boot-time allocations are still expected
+
+static bool connected = false;
+static volatile bool live = false;
+static volatile uint32_t joins = 0;
+static bool skipping = false; // Inside a fragmented message, which would not fit anyway
+static uint32_t tokenGeneration = 0;
+static uint32_t nextRef = 1;
+static uint32_t joinRef = 0;
+static unsigned long lastFrameAt = 0;
+static unsigned long lastHeartbeatAt = 0;
+static unsigned long nextConnectAt = 0;
+static uint32_t backoffMs = 0;
+static RealtimeStats stats;
+
+static const char *realtimeHost()
+{
+#ifdef REALTIME_HOST
+  return REALTIME_HOST;
+#else
+  return supabaseHost();
+#endif
+}
+
+// Reads exactly length bytes, waiting up to REALTIME_TIMEOUT_MS for them
+static bool readExactly(uint8_t *out, size_t length)
+{
+  unsigned long start = millis();
+  size_t got = 0;
+  while (got < length)
+  {
+    int n = client->read(&out[got], length - got);
+    if (n > 0)
+    {
+      got += n;
+      continue;
+    }
+    if (!client->connected() || millis() - start >= REALTIME_TIMEOUT_MS)
+    {
+      return false;
+    }
+    vTaskDelay(1);
+  }
+  return true;
+}
+
+static bool readLine()
+{
+  size_t length = 0;
+  uint8_t c;
+  while (readExactly(&c, 1))
+  {
+    if (c == '\n')
+    {
+      while (length > 0 && line[length - 1] == '\r')
+      {
+        length--;
+      }
+      line[length] = '\0';
+      return true;
+    }
+    if (length < sizeof(line) - 1)
+    {
+      line[length++] = c;
+    }
+  }
+  return false;
+}
+
+static void base64(const uint8_t *in, size_t length, char *out)
+{
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t o = 0;
+  for (size_t i = 0; i < length; i += 3)
+  {
+    uint32_t block = in[i] << 16 | (i + 1 < length ? in[i + 1] << 8 : 0) | (i + 2 < length ? in[i + 2] : 0);
+    out[o++] = alphabet[block >> 18 & 63];
+    out[o++] = alphabet[block >> 12 & 63];
+    out[o++] = i + 1 < length ? alphabet[block >> 6 & 63] : '=';
+    out[o++] = i + 2 < length ? alphabet[block & 63] : '=';
+  }
+  out[o] = '\0';
+}
+
+// Client frames must be masked; the whole frame goes out in one write
+static bool sendFrame(uint8_t opcode, const char *payload, size_t length)
+{
+  if (length > REALTIME_MESSAGE_BYTES)
+  {
+    return false;
+  }
+  uint32_t random = esp_random();
+  uint8_t mask[4];
+  memcpy(mask, &random, 4);
+  size_t header = wsFrameEncodeHeader(outFrame, opcode, length, mask);
+  memcpy(&outFrame[header], payload, length);
+  wsFrameMask(&outFrame[header], length, mask);
+  return client->write(outFrame, header + length) == header + length;
+}
+
+static bool sendMessage(size_t length)
+{
+  if (length >= sizeof(message))
+  {
+    LOG_ERROR(LOG_REALTIME, "Realtime message too long");
+    return false;
+  }
+  return sendFrame(WS_OPCODE_TEXT, message, length);
+}
+
+static void closeSocket(const char *reason)
+{
+  client->stop();
+  connected = false;
+  joinRef = 0;
+  if (live)
+  {
+    live = false;
+    stats.drops++;
+    LOG_WARN(LOG_REALTIME, "Realtime channel down (%s); polling takes over", reason);
+  }
+  else
+  {
+    LOG_DEBUG(LOG_REALTIME, "Realtime connection closed (%s)", reason);
+  }
+  // Exponential backoff with up to a quarter of jitter, as for WiFi
+  backoffMs = backoffMs == 0 ? REALTIME_BACKOFF_MIN_MS : min(backoffMs * 2, (uint32_t)REALTIME_BACKOFF_MAX_MS);
+  nextConnectAt = millis() + backoffMs + esp_random() % (backoffMs / 4 + 1);
+}
+
+// Copies the access token when it changed; returns false when there is nothing new to send
+static bool takeToken(TickType_t wait)
+{
+  if (xSemaphoreTake(xSupabaseMutex, wait) != pdTRUE)
+  {
+    return false;
+  }
+  uint32_t generation = supabaseSessionToken(token, sizeof(token));
+  xSemaphoreGive(xSupabaseMutex);
+  bool changed = generation != tokenGeneration;
+  tokenGeneration = generation;
+  return changed && token[0];
+}
+
+static bool join()
+{
+  takeToken(REALTIME_TIMEOUT_MS / portTICK_PERIOD_MS);
+  joinRef = nextRef++;
+  int length = snprintf(message, sizeof(message),
+                        "{\"topic\":\"%s\",\"event\":\"phx_join\",\"payload\":{\"config\":{\"broadcast\":{\"self\":false},"
+                        "\"presence\":{\"key\":\"\"},\"postgres_changes\":[{\"event\":\"*\",\"schema\":\"public\","
+                        "\"table\":\"%s\"}]},\"access_token\":\"%s\"},\"ref\":\"%u\",\"join_ref\":\"%u\"}",
+                        topic, tableName, token, joinRef, joinRef);
+  return length > 0 && sendMessage(length);
+}
+
+static bool openSocket()
+{
+  unsigned long start = millis();
+  const char *host = realtimeHost();
+  if (!client->connect(host, REALTIME_PORT))
+  {
+    closeSocket("connect failed");
+    return false;
+  }
+
+  uint8_t nonce[16];
+  esp_fill_random(nonce, sizeof(nonce));
+  char key[25];
+  base64(nonce, sizeof(nonce), key);
+  int length = snprintf(message, sizeof(message),
+                        "GET /realtime/v1/websocket?apikey=%s&vsn=1.0.0 HTTP/1.1\r\nHost: %s\r\n"
+                        "Upgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: %s\r\n"
+                        "Sec-WebSocket-Version: 13\r\n\r\n",
+                        supabaseApiKey(), host, key);
+  if (length <= 0 || (size_t)length >= sizeof(message) ||
+      client->write((const uint8_t *)message, length) != (size_t)length)
+  {
+    closeSocket("handshake not sent");
+    return false;
+  }
+
+  if (!readLine() || strncmp(line, "HTTP/1.1 101", 12) != 0)
+  {
+    LOG_WARN(LOG_REALTIME, "Realtime handshake refused: %s", logCopy(line));
+    closeSocket("handshake refused");
+    return false;
+  }
+  while (readLine() && line[0] != '\0')
+  {
+    // The Upgrade and Accept headers carry nothing the client acts on
+  }
+
+  connected = true;
+  skipping = false;
+  stats.connects++;
+  stats.lastConnectMs = millis() - start;
+  lastFrameAt = millis();
+  lastHeartbeatAt = millis();
+  tokenGeneration = 0;
+  if (!join())
+  {
+    closeSocket("join not sent");
+    return false;
+  }
+  return true;
+}
+
+static void handleMessage(size_t length)
+{
+  JsonArena arena;
+  JsonDocument doc(&arena);
+  DeserializationError error = deserializeJson(doc, frame, length, DeserializationOption::Filter(filter));
+  if (error)
+  {
+    LOG_WARN(LOG_REALTIME, "Realtime message not parsed: %s", error.c_str());
+    return;
+  }
+  const char *event = doc["event"];
+  if (event == NULL)
+  {
+    return;
+  }
+
+  if (strcmp(event, "postgres_changes") == 0)
+  {
+    stats.events++;
+    JsonObjectConst record = doc["payload"]["data"]["record"];
+    const char *name = record["name"];
+    const char *status = record["status"];
+    if (configSyncApply(name, status, record["updated_at"]))
+    {
+      stats.applied++;
+      LOG_INFO(LOG_REALTIME, "Pushed %s = %s", logCopy(name), logCopy(status));
+    }
+  }
+  else if (strcmp(event, "phx_reply") == 0)
+  {
+    const char *ref = doc["ref"];
+    const char *status = doc["payload"]["status"];
+    if (joinRef == 0 || ref == NULL || strtoul(ref, NULL, 10) != joinRef)
+    {
+      return; // Heartbeat and token replies; the frame itself already counts as a sign of life
+    }
+    joinRef = 0;
+    if (status != NULL && strcmp(status, "ok") == 0)
+    {
+      live = true;
+      joins++;
+      stats.joins++;
+      backoffMs = 0;
+      LOG_INFO(LOG_REALTIME, "Realtime subscribed to %s in %u ms", tableName, stats.lastConnectMs);
+    }
+    else
+    {
+      LOG_ERROR(LOG_REALTIME, "Realtime subscription refused");
+      closeSocket("join refused");
+    }
+  }
+  else if (strcmp(event, "phx_error") == 0 || strcmp(event, "phx_close") == 0)
+  {
+    closeSocket(event);
+  }
+}
+
+// Reads one frame; false means the connection is unusable
+static bool readFrame()
+{
+  uint8_t head[WS_HEADER_MAX_BYTES];
+  if (!readExactly(head, 2) || !readExactly(&head[2], wsFrameHeaderBytes(head) - 2))
+  {
+    return false;
+  }
+  WsFrameHeader header;
+  wsFrameDecodeHeader(head, header);
+  bool fin = header.fin;
+  uint8_t opcode = header.opcode;
+  uint64_t length = header.length;
+
+  // A payload that does not fit is read off in pieces and dropped
+  bool fits = length <= REALTIME_FRAME_BYTES;
+  uint64_t left = length;
+  while (left > 0)
+  {
+    size_t chunk = left < REALTIME_FRAME_BYTES ? left : REALTIME_FRAME_BYTES;
+    if (!readExactly((uint8_t *)frame, chunk))
+    {
+      return false;
+    }
+    left -= chunk;
+  }
+  if (fits)
+  {
+    if (header.masked)
+    {
+      wsFrameMask((uint8_t *)frame, length, header.mask);
+    }
+    frame[length] = '\0';
+  }
+  stats.frames++;
+  lastFrameAt = millis();
+
+  switch (opcode)
+  {
+  case WS_OPCODE_TEXT:
+  case WS_OPCODE_CONTINUATION:
+    // Phoenix sends each message in one frame; anything split or too large is skipped whole
+    if (opcode == WS_OPCODE_TEXT && fin && fits)
+    {
+      handleMessage(length);
+    }
+    else if (!skipping)
+    {
+      stats.oversized++;
+      LOG_WARN(LOG_REALTIME, "Realtime message of %u bytes skipped", (unsigned)length);
+    }
+    skipping = !fin;
+    return true;
+  case WS_OPCODE_PING:
+    return sendFrame(WS_OPCODE_PONG, frame, fits ? length : 0);
+  case WS_OPCODE_CLOSE:
+    // Echo the code back, as RFC 6455 asks, before the caller drops the connection
+    LOG_DEBUG(LOG_REALTIME, "Realtime close frame, code %u",
+              wsFrameCloseCode((const uint8_t *)frame, fits ? length : 0));
+    sendFrame(WS_OPCODE_CLOSE, frame, fits && length >= 2 ? 2 : 0);
+    return false;
+  default:
+    return true;
+  }
+}
+
+static void sendHeartbeat()
+{
+  lastHeartbeatAt = millis();
+  int length = snprintf(message, sizeof(message),
+                        "{\"topic\":\"phoenix\",\"event\":\"heartbeat\",\"payload\":{},\"ref\":\"%u\"}", nextRef++);
+  if (!sendMessage(length))
+  {
+    closeSocket("heartbeat not sent");
+    return;
+  }
+
+  // A refreshed session has to reach the server before the old token expires, or it closes the channel
+  if (takeToken(0))
+  {
+    length = snprintf(message, sizeof(message),
+                      "{\"topic\":\"%s\",\"event\":\"access_token\",\"payload\":{\"access_token\":\"%s\"},\"ref\":\"%u\"}",
+                      topic, token, nextRef++);
+    if (!sendMessage(length))
+    {
+      closeSocket("token not sent");
+    }
+  }
+}
+
+// One pass of the task: connect when due, read what has arrived and keep the socket alive
+static void realtimeStep()
+{
+  if (!connected)
+  {
+    if (wifiManagerConnected() && supabaseSessionValid() && (long)(millis() - nextConnectAt) >= 0)
+    {
+      openSocket();
+    }
+  }
+  else if (!wifiManagerConnected() || !client->connected())
+  {
+    closeSocket("link lost");
+  }
+  else
+  {
+    while (connected && client->available() >= 2)
+    {
+      if (!readFrame())
+      {
+        closeSocket("read failed");
+      }
+    }
+    if (connected && millis() - lastFrameAt >= REALTIME_SILENCE_MS)
+    {
+      closeSocket("silent");
+    }
+    if (connected && millis() - lastHeartbeatAt >= REALTIME_HEARTBEAT_MS)
+    {
+      sendHeartbeat();
+    }
+  }
+}
+
+static void realtimeTask(void *pvParameters)
+{
+  int monitorId = taskMonitorRegister("Realtime", REALTIME_LOOP_MS, REALTIME_DEADLINE_MS, false);
+  while (true)
+  {
+    taskMonitorCheckIn(monitorId);
+    realtimeStep();
+    vTaskDelay(REALTIME_LOOP_MS / portTICK_PERIOD_MS);
+  }
+}
+
+bool realtimeBegin(const char *table)
+{
+  tableName = table;
+  snprintf(topic, sizeof(topic), "realtime:%s", table);
+  secureClient.setInsecure();
+  secureClient.setTimeout(REALTIME_TIMEOUT_MS / 1000);
+  plainClient.setTimeout(REALTIME_TIMEOUT_MS / 1000);
+
+  // Keep only what the handlers read; the column list and old record are skipped by the parser
+  filter["event"] = true;
+  filter["ref"] = true;
+  filter["payload"]["status"] = true;
+  filter["payload"]["data"]["record"]["name"] = true;
+  filter["payload"]["data"]["record"]["status"] = true;
+  filter["payload"]["data"]["record"]["updated_at"] = true;
+
+  if (xTaskCreatePinnedToCore(realtimeTask, "Realtime", REALTIME_TASK_STACK, NULL, REALTIME_TASK_PRIORITY, NULL,
+                              TASK_CORE_NETWORK) != pdPASS)
+  {
+    Serial.println("Failed to create Realtime task");
+    return false;
+  }
+  return true;
+}
+
+bool realtimeLive()
+{
+  return live;
+}
+
+uint32_t realtimeJoins()
+{
+  return joins;
+}
+
+RealtimeStats realtimeStats()
+{
+  RealtimeStats copy = stats;
+  copy.live = live;
+  return copy;
+}
+
+void realtimePrintStats(Print &out)
+{
+  RealtimeStats s = realtimeStats();
+  out.printf("Realtime: %s, %u connects (last %u ms), %u joins, %u drops, %u frames, %u events (%u applied), %u skipped\n",
+             s.live ? "live" : "down", s.connects, s.lastConnectMs, s.joins, s.drops, s.frames, s.events, s.applied,
+             s.oversized);
+}
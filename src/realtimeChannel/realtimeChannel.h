@@ -0,0 +1,41 @@
+#ifndef REALTIME_CHANNEL_H
+#define REALTIME_CHANNEL_H
+
+#include <Arduino.h>
+
+// The Supabase project by default. Point a build at a local websocket stand-in that replays
+// change events with e.g. -DREALTIME_HOST=\"192.168.1.20\" -DREALTIME_PORT=4000 -DREALTIME_TLS=0
+#ifndef REALTIME_PORT
+#define REALTIME_PORT 443
+#endif
+#ifndef REALTIME_TLS
+#define REALTIME_TLS 1
+#endif
+
+struct RealtimeStats
+{
+  bool live;
+  uint32_t connects;      // Websocket handshakes completed
+  uint32_t joins;         // Subscriptions the server confirmed
+  uint32_t drops;         // Live subscriptions lost
+  uint32_t frames;
+  uint32_t events;        // postgres_changes messages
+  uint32_t applied;       // Events that changed a flag
+  uint32_t oversized;     // Messages too large for the frame buffer, skipped
+  uint32_t lastConnectMs; // TCP, TLS and websocket handshake
+};
+
+// Starts the task that keeps one websocket to Supabase Realtime subscribed to changes of the
+// table and applies them through configSyncApply(). It connects whenever WiFi is up and there
+// is a session, with backoff after failures. Call after supabaseSessionBegin()
+bool realtimeBegin(const char *table);
+
+// True while subscribed; polling can stand down
+bool realtimeLive();
+// Counts confirmed subscriptions; a change means events may have been missed while it was down
+uint32_t realtimeJoins();
+
+RealtimeStats realtimeStats();
+void realtimePrintStats(Print &out);
+
+#endif
@@ -0,0 +1,335 @@
+#include "rfidAllowlist.h"
+#include <Preferences.h>
+#include "../sendToSupabaseRead/sendToSupabaseRead.h"
+#include "../logger/logger.h"
+
+#define RFID_NVS_NAMESPACE "rfid"
+#define RFID_NVS_CHUNK_BYTES 1984 // NVS blobs are written in chunks well under one flash page
+#define RFID_NVS_MAX_CHUNKS 16
+#define RFID_NVS_LEGACY 0xFF // "gen" before the table was saved in generations
+#define RFID_SYNC_PAGE_ROWS 200 // Rows are parsed as they arrive, so this only bounds how long one request holds the mutex
+#define RFID_PATH_BYTES 384 // Base query plus the (updated_at, uid) cursor quoted twice
+#define RFID_CURSOR_LENGTH 40
+
+static UidTable table;
+static portMUX_TYPE tableMux = portMUX_INITIALIZER_UNLOCKED;
+static RfidAllowlistStats stats;
+
+// Last row applied, ordered by (updated_at, uid), so a page boundary inside one timestamp loses nothing
+static char cursorTime[RFID_CURSOR_LENGTH] = "";
+static char cursorUid[RFID_CURSOR_LENGTH] = "";
+
+static uint8_t chunk[RFID_NVS_CHUNK_BYTES];
+static char path[RFID_PATH_BYTES];
+
+// The table is saved in two generations, A and B, and "gen" names the one to load. A save writes
+// the other generation and switches "gen" last, so a reset halfway leaves the previous one intact
+static uint8_t liveGeneration = RFID_NVS_LEGACY;
+
+// Key of one generation, e.g. "1c3" for chunk 3 of B; the legacy layout had no prefix
+static const char *nvsKey(char *key, size_t size, uint8_t generation, const char *name, int index = -1)
+{
+  const char *prefix = generation == RFID_NVS_LEGACY ? "" : generation ? "1" : "0";
+  if (index < 0)
+  {
+    snprintf(key, size, "%s%s", prefix, name);
+  }
+  else
+  {
+    snprintf(key, size, "%s%s%d", prefix, name, index);
+  }
+  return key;
+}
+
+static bool loadTable()
+{
+  Preferences prefs;
+  if (!prefs.begin(RFID_NVS_NAMESPACE, true))
+  {
+    return false;
+  }
+  liveGeneration = prefs.getUChar("gen", RFID_NVS_LEGACY);
+  char key[16];
+  int chunks = prefs.getUChar(nvsKey(key, sizeof(key), liveGeneration, "chunks"), 0);
+  bool loaded = chunks > 0;
+  for (int c = 0; c < chunks && loaded; c++)
+  {
+    nvsKey(key, sizeof(key), liveGeneration, "c", c);
+    size_t size = prefs.getBytes(key, chunk, sizeof(chunk));
+    // Records are a length byte followed by the UID
+    size_t i = 0;
+    while (i < size)
+    {
+      uint8_t length = chunk[i++];
+      if (length == 0 || i + length > size || !uidTableInsert(table, &chunk[i], length))
+      {
+        loaded = false;
+        break;
+      }
+      i += length;
+    }
+  }
+  prefs.getString(nvsKey(key, sizeof(key), liveGeneration, "cursorTime"), cursorTime, sizeof(cursorTime));
+  prefs.getString(nvsKey(key, sizeof(key), liveGeneration, "cursorUid"), cursorUid, sizeof(cursorUid));
+  prefs.end();
+
+  if (!loaded)
+  {
+    uidTableClear(table);
+    cursorTime[0] = '\0';
+    cursorUid[0] = '\0';
+  }
+  return loaded;
+}
+
+static bool saveTable()
+{
+  Preferences prefs;
+  if (!prefs.begin(RFID_NVS_NAMESPACE, false))
+  {
+    LOG_ERROR(LOG_RFID, "Failed to open RFID allowlist in NVS");
+    return false;
+  }
+
+  uint8_t target = liveGeneration == 0 ? 1 : 0;
+  char key[16];
+  int chunks = 0;
+  size_t used = 0;
+  bool ok = true;
+  for (int slot = uidTableNext(table, 0); ok; slot = uidTableNext(table, slot + 1))
+  {
+    bool last = slot < 0;
+    if (!last && used + 1 + table.slots[slot].length > sizeof(chunk))
+    {
+      last = true; // flush the full chunk, then this slot starts the next one
+    }
+    if (last && used > 0)
+    {
+      nvsKey(key, sizeof(key), target, "c", chunks++);
+      ok = chunks <= RFID_NVS_MAX_CHUNKS && prefs.putBytes(key, chunk, used) == used;
+      used = 0;
+    }
+    if (slot < 0)
+    {
+      break;
+    }
+    const UidSlot &entry = table.slots[slot];
+    chunk[used++] = entry.length;
+    memcpy(&chunk[used], entry.uid, entry.length);
+    used += entry.length;
+  }
+
+  // The cursor belongs to the generation, so a reset never pairs the new cursor with the old table
+  ok = ok && prefs.putUChar(nvsKey(key, sizeof(key), target, "chunks"), chunks) == 1;
+  ok = ok && prefs.putString(nvsKey(key, sizeof(key), target, "cursorTime"), cursorTime) == strlen(cursorTime);
+  ok = ok && prefs.putString(nvsKey(key, sizeof(key), target, "cursorUid"), cursorUid) == strlen(cursorUid);
+  ok = ok && prefs.putUChar("gen", target) == 1;
+  if (ok && liveGeneration == RFID_NVS_LEGACY)
+  {
+    // The legacy copy is no longer read; free its space
+    prefs.remove("chunks");
+    prefs.remove("cursorTime");
+    prefs.remove("cursorUid");
+    for (int c = 0; c < RFID_NVS_MAX_CHUNKS; c++)
+    {
+      prefs.remove(nvsKey(key, sizeof(key), RFID_NVS_LEGACY, "c", c));
+    }
+  }
+  prefs.end();
+  if (!ok)
+  {
+    LOG_ERROR(LOG_RFID, "Failed to save RFID allowlist");
+    return false;
+  }
+  liveGeneration = target;
+  stats.saves++;
+  return true;
+}
+
+bool rfidAllowlistBegin(const char *const *defaultUids, int count)
+{
+  uidTableClear(table);
+  if (loadTable())
+  {
+    Serial.printf("RFID allowlist: %u cards from NVS\n", table.count);
+  }
+  else
+  {
+    for (int i = 0; i < count; i++)
+    {
+      uint8_t uid[UID_MAX_LENGTH];
+      uint8_t length;
+      if (uidParseHex(defaultUids[i], uid, length))
+      {
+        uidTableInsert(table, uid, length);
+      }
+    }
+    Serial.printf("RFID allowlist: %u default cards\n", table.count);
+  }
+  stats.cards = table.count;
+  return true;
+}
+
+bool rfidAllowlistContains(const uint8_t *uid, uint8_t length)
+{
+  unsigned long start = micros();
+  portENTER_CRITICAL(&tableMux);
+  bool found = uidTableContains(table, uid, length);
+  uint32_t elapsed = micros() - start;
+  stats.lookups++;
+  if (found)
+  {
+    stats.granted++;
+  }
+  if (elapsed > stats.maxLookupMicros)
+  {
+    stats.maxLookupMicros = elapsed;
+  }
+  portEXIT_CRITICAL(&tableMux);
+  return found;
+}
+
+// PostgREST needs quotes around values with reserved characters inside or=(...), and the
+// timestamp's '+' must not reach the server as a space
+static size_t appendQuoted(size_t length, const char *value)
+{
+  length += snprintf(&path[length], sizeof(path) - length, "%%22");
+  for (const char *c = value; *c && length < sizeof(path) - 4; c++)
+  {
+    if (*c == '+')
+    {
+      length += snprintf(&path[length], sizeof(path) - length, "%%2B");
+    }
+    else
+    {
+      path[length++] = *c;
+    }
+  }
+  length += snprintf(&path[length], sizeof(path) - length, "%%22");
+  return length;
+}
+
+static void clearTable(bool &changed)
+{
+  if (table.count > 0)
+  {
+    portENTER_CRITICAL(&tableMux);
+    uidTableClear(table);
+    portEXIT_CRITICAL(&tableMux);
+    changed = true;
+  }
+}
+
+// Fetches one page; returns the rows in it, or -1 on failure
+static int syncPage(bool &changed)
+{
+  size_t length = snprintf(path, sizeof(path),
+                           "/rest/v1/rfid_cards?select=uid,active,updated_at&order=updated_at.asc,uid.asc&limit=%d",
+                           RFID_SYNC_PAGE_ROWS);
+  bool full = cursorTime[0] == '\0';
+  if (!full)
+  {
+    length += snprintf(&path[length], sizeof(path) - length, "&or=(updated_at.gt.");
+    length = appendQuoted(length, cursorTime);
+    length += snprintf(&path[length], sizeof(path) - length, ",and(updated_at.eq.");
+    length = appendQuoted(length, cursorTime);
+    length += snprintf(&path[length], sizeof(path) - length, ",uid.gt.");
+    length = appendQuoted(length, cursorUid);
+    snprintf(&path[length], sizeof(path) - length, "))");
+  }
+
+  const char *fields[] = {"uid", "active", "updated_at"};
+  SupabaseRows rows(path, fields, 3);
+  if (rows.status() != 200)
+  {
+    LOG_WARN(LOG_RFID, "RFID allowlist sync result: %d", rows.status());
+    return -1;
+  }
+
+  // The first sync replaces the boot defaults with the backend's list. Rows are applied as they
+  // are parsed, so the defaults stay until the first one has arrived, and for good when the
+  // rfid_cards table is empty: a backend not filled in yet must not lock every card out
+  bool cleared = !full;
+  while (rows.next())
+  {
+    if (!cleared)
+    {
+      clearTable(changed);
+      cleared = true;
+    }
+    JsonObjectConst row = rows.row();
+    const char *hex = row["uid"];
+    const char *updatedAt = row["updated_at"];
+    bool active = row["active"] | true;
+    uint8_t uid[UID_MAX_LENGTH];
+    uint8_t length;
+    if (hex == NULL || updatedAt == NULL)
+    {
+      continue;
+    }
+    strncpy(cursorTime, updatedAt, sizeof(cursorTime) - 1);
+    strncpy(cursorUid, hex, sizeof(cursorUid) - 1);
+    changed = true;
+    if (!uidParseHex(hex, uid, length))
+    {
+      LOG_WARN(LOG_RFID, "Bad RFID UID: %s", logCopy(hex));
+      continue;
+    }
+
+    portENTER_CRITICAL(&tableMux);
+    bool applied = active ? uidTableInsert(table, uid, length) : (uidTableRemove(table, uid, length), true);
+    portEXIT_CRITICAL(&tableMux);
+    if (!applied)
+    {
+      LOG_WARN(LOG_RFID, "RFID allowlist is full");
+    }
+  }
+  if (rows.failed())
+  {
+    LOG_WARN(LOG_RFID, "RFID allowlist sync cut short after %d rows", rows.count());
+    return -1;
+  }
+  return rows.count();
+}
+
+int rfidAllowlistSync()
+{
+  stats.syncs++;
+  bool changed = false;
+  int total = 0;
+  while (true)
+  {
+    int rows = syncPage(changed);
+    if (rows < 0)
+    {
+      stats.syncFailures++;
+      total = -1;
+      break;
+    }
+    total += rows;
+    if (rows < RFID_SYNC_PAGE_ROWS)
+    {
+      break;
+    }
+  }
+
+  // Rows applied before a failure are kept; the cursor resumes after them next time
+  if (changed)
+  {
+    saveTable();
+  }
+  if (total > 0)
+  {
+    stats.syncedRows += total;
+  }
+  stats.cards = table.count;
+  return total;
+}
+
+RfidAllowlistStats rfidAllowlistStats()
+{
+  portENTER_CRITICAL(&tableMux);
+  RfidAllowlistStats copy = stats;
+  portEXIT_CRITICAL(&tableMux);
+  return copy;
+}
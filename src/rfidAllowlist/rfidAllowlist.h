@@ -0,0 +1,32 @@
+#ifndef RFID_ALLOWLIST_H
+#define RFID_ALLOWLIST_H
+
+#include <Arduino.h>
+#include "../uidTable/uidTable.h"
+
+struct RfidAllowlistStats
+{
+  uint32_t cards;
+  uint32_t lookups;
+  uint32_t granted;
+  uint32_t maxLookupMicros;
+  uint32_t syncs;
+  uint32_t syncedRows;   // rows applied from the backend since boot
+  uint32_t syncFailures;
+  uint32_t saves;        // times the table was written to NVS
+};
+
+// Loads the copy saved in NVS; with none saved yet, starts from defaultUids (hex strings),
+// which the first sync replaces only once rfid_cards returns a row
+bool rfidAllowlistBegin(const char *const *defaultUids, int count);
+
+// Allocation free and safe from any task
+bool rfidAllowlistContains(const uint8_t *uid, uint8_t length);
+
+// Applies the rfid_cards rows changed since the last sync and saves the table if it changed.
+// Call with xSupabaseMutex held. Returns the rows applied, or -1 on failure
+int rfidAllowlistSync();
+
+RfidAllowlistStats rfidAllowlistStats();
+
+#endif
@@ -1,40 +1,85 @@
 #include "sendToSupabaseRead.h"
 #include "../confidential.h"
+#include "../logger/logger.h"
 
-extern const char *readJSON;
-extern Supabase db;
-extern String table;
+#define SUPABASE_PATH_BYTES 128
 
-String sendToSupabaseRead(String name, String column)
+extern const char *table;
+
+static char path[SUPABASE_PATH_BYTES];
+
+SupabaseRows::SupabaseRows(const char *requestPath, const char *const *fields, int fieldCount)
+    : parser(fields, fieldCount)
+{
+  code = supabaseStreamBegin("GET", requestPath, NULL, NULL);
+}
+
+SupabaseRows::~SupabaseRows()
 {
-  // Allocate the JSON document
-  JsonDocument doc;
+  supabaseStreamEnd();
+}
 
+bool sendToSupabaseRead(const char *name, const char *column, char *out, size_t size)
+{
   // Validate inputs
-  if (name.isEmpty() || column.isEmpty())
+  if (name == NULL || column == NULL || !name[0] || !column[0] || size == 0)
   {
     // Handle invalid inputs
-    return "";
+    return false;
+  }
+  out[0] = '\0';
+
+  snprintf(path, sizeof(path), "/rest/v1/%s?select=%s&name=eq.%s&limit=1", table, column, name);
+  SupabaseRows rows(path, &column, 1);
+  if (!rows.next())
+  {
+    return false;
   }
 
-  String read = db.from(table).select(column).eq("name", name).limit(1).doSelect();
-  // Serial.println(read);
+  // Copy out, since the row's memory is reused by the next read
+  const char *value = rows.row()[column];
+  if (value == NULL)
+  {
+    return false;
+  }
+  strncpy(out, value, size - 1);
+  out[size - 1] = '\0';
+  LOG_DEBUG(LOG_SUPABASE, "Read %s", logCopy(out));
 
-  // Deserialize the JSON document
-  DeserializationError error = deserializeJson(doc, read);
+  return true;
+}
 
-  if (error)
+// Reads the column of every row in one request and passes each name/value pair to onRow; the
+// strings are only valid during the call. Returns the number of rows handled, or -1 if the
+// response could not be read.
+int sendToSupabaseReadAll(const char *column, void (*onRow)(const char *name, const char *value))
+{
+  // Validate inputs
+  if (column == NULL || !column[0] || onRow == NULL)
   {
-    Serial.print("deserializeJson() failed: ");
-    Serial.println(error.c_str());
-    return ""; // Return empty string to indicate failure
+    return -1;
   }
 
-  readJSON = doc[0][column];
-  // Serial.print(name + ": ");
-  Serial.println(readJSON);
+  snprintf(path, sizeof(path), "/rest/v1/%s?select=name,%s", table, column);
+  const char *fields[] = {"name", column};
+  SupabaseRows rows(path, fields, 2);
 
-  db.urlQuery_reset();
+  int handled = 0;
+  while (rows.next())
+  {
+    const char *name = rows.row()["name"];
+    const char *value = rows.row()[column];
+    if (name && value)
+    {
+      onRow(name, value);
+      handled++;
+    }
+  }
+  if (rows.failed())
+  {
+    LOG_WARN(LOG_SUPABASE, "SupabaseRead all result: %d", rows.status());
+    return -1;
+  }
 
-  return readJSON;
-}
\ No newline at end of file
+  return handled;
+}
@@ -2,9 +2,35 @@
 #define SEND_TO_SUPABASE_READ_H
 
 #include <Arduino.h>
-#include <ESP32_Supabase.h>
-#include <ArduinoJson.h>
+#include "../supabaseConnection/supabaseConnection.h"
+#include "../jsonRows/jsonRows.h"
 
-String sendToSupabaseRead(String name, String column);
+// Streams the JSON array a PostgREST GET returns and parses it one row at a time straight off
+// the socket. Only the named fields are kept, so memory does not grow with the response:
+//   const char *fields[] = {"uid", "active"};
+//   SupabaseRows rows(path, fields, 2);
+//   while (rows.next()) { const char *uid = rows.row()["uid"]; }
+// Values in row() are valid until the next call to next(); copy what must outlive it. The
+// caller holds xSupabaseMutex for the lifetime of the reader, which uses both JSON arenas
+class SupabaseRows
+{
+public:
+  SupabaseRows(const char *path, const char *const *fields, int fieldCount);
+  ~SupabaseRows();
 
-#endif
\ No newline at end of file
+  int status() const { return code; } // HTTP status, or -1 when there was no answer
+  bool next() { return code == 200 && parser.next(supabaseStreamBody()); }
+  JsonObjectConst row() const { return parser.row(); }
+  int count() const { return parser.count(); }
+  bool failed() const { return code != 200 || parser.failed(); }
+
+private:
+  JsonRows parser;
+  int code;
+};
+
+// Copies the column of the named row into out; returns false when it could not be read
+bool sendToSupabaseRead(const char *name, const char *column, char *out, size_t size);
+int sendToSupabaseReadAll(const char *column, void (*onRow)(const char *name, const char *value));
+
+#endif
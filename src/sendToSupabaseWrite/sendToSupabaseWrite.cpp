@@ -1,34 +1,73 @@
 #include "sendToSupabaseWrite.h"
 #include "../confidential.h"
+#include "../logger/logger.h"
 
-extern const char *readJSON;
-extern Supabase db;
-extern String table;
+#define SUPABASE_PATH_BYTES 128
 
-void sendToSupabaseWrite(String name, String column, int value)
+extern const char *table;
+
+// Bodies and paths are built in place; requests are serialised by xSupabaseMutex
+static char writtenJSON[SUPABASE_WRITE_BODY_BYTES];
+static char path[SUPABASE_PATH_BYTES];
+
+static int patchRow(const char *name)
 {
-  // Create JSON payload
-  JsonDocument doc;
-  doc[column] = value;
+  snprintf(path, sizeof(path), "/rest/v1/%s?name=eq.%s", table, name);
+  return supabaseRequest("PATCH", path, writtenJSON, "return=minimal", NULL);
+}
 
-  String writtenJSON;
-  serializeJson(doc, writtenJSON);
+int sendToSupabaseWrite(const char *name, const char *column, int value)
+{
+  // Create JSON payload
+  snprintf(writtenJSON, sizeof(writtenJSON), "{\"%s\":%d}", column, value);
 
-  int code = db.update(table).eq("name", name).doUpdate(writtenJSON);
-  Serial.println((String) "SupabaseWrite int result: " + code);
-  db.urlQuery_reset();
+  int code = patchRow(name);
+  LOG_DEBUG(LOG_SUPABASE, "SupabaseWrite int result: %d", code);
+  return code;
 }
 
-void sendToSupabaseWrite(String name, String column, String value)
+int sendToSupabaseWrite(const char *name, const char *column, const char *value)
 {
   // Create JSON payload
-  JsonDocument doc;
-  doc[column] = value;
+  int length = snprintf(writtenJSON, sizeof(writtenJSON), "{\"%s\":", column);
+  size_t quoted = supabaseJsonString(&writtenJSON[length], sizeof(writtenJSON) - length - 1, value);
+  if (quoted == 0)
+  {
+    LOG_ERROR(LOG_SUPABASE, "SupabaseWrite string value too long");
+    return -1;
+  }
+  length += quoted;
+  writtenJSON[length++] = '}';
+  writtenJSON[length] = '\0';
+
+  int code = patchRow(name);
+  LOG_DEBUG(LOG_SUPABASE, "SupabaseWrite string result: %d", code);
+  return code;
+}
 
-  String writtenJSON;
-  serializeJson(doc, writtenJSON);
+// Upserts count rows keyed by name in a single request and returns the HTTP status.
+// Each name may appear only once, since one upsert cannot update the same row twice.
+// on_conflict=name needs a unique constraint on the name column, or PostgREST rejects the upsert.
+int sendToSupabaseWriteBatch(const char *const *names, const int *values, int count, const char *column)
+{
+  // Create JSON array payload
+  size_t length = 0;
+  writtenJSON[length++] = '[';
+  for (int i = 0; i < count; i++)
+  {
+    int written = snprintf(&writtenJSON[length], sizeof(writtenJSON) - length, "%s{\"name\":\"%s\",\"%s\":%d}",
+                           i ? "," : "", names[i], column, values[i]);
+    if (written < 0 || length + written + 2 > sizeof(writtenJSON))
+    {
+      LOG_ERROR(LOG_SUPABASE, "SupabaseWrite batch too large");
+      return -1;
+    }
+    length += written;
+  }
+  writtenJSON[length++] = ']';
+  writtenJSON[length] = '\0';
 
-  int code = db.update(table).eq("name", name).doUpdate(writtenJSON);
-  Serial.println((String) "SupabaseWrite string result: " + code);
-  db.urlQuery_reset();
+  snprintf(path, sizeof(path), "/rest/v1/%s?on_conflict=name", table);
+  int code = supabaseRequest("POST", path, writtenJSON, "resolution=merge-duplicates,return=minimal", NULL);
+  return code;
 }
\ No newline at end of file
@@ -2,10 +2,13 @@
 #define SEND_TO_SUPABASE_WRITE_H
 
 #include <Arduino.h>
-#include <ESP32_Supabase.h>
-#include <ArduinoJson.h>
+#include "../supabaseConnection/supabaseConnection.h"
 
-void sendToSupabaseWrite(String name, String column, int value);
-void sendToSupabaseWrite(String name, String column, String value);
+#define SUPABASE_WRITE_BODY_BYTES 512
+
+// Names and columns are table identifiers and go into the JSON unescaped
+int sendToSupabaseWrite(const char *name, const char *column, int value);
+int sendToSupabaseWrite(const char *name, const char *column, const char *value);
+int sendToSupabaseWriteBatch(const char *const *names, const int *values, int count, const char *column);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "sensorReporter.h"
+
+void digitalReporterInit(DigitalReporter &reporter, unsigned long debounceMs, unsigned long heartbeatMs)
+{
+  reporter.debounceMs = debounceMs;
+  reporter.heartbeatMs = heartbeatMs;
+  reporter.stableLevel = -1;
+  reporter.candidateLevel = -1;
+  reporter.candidateSince = 0;
+  reporter.lastReportTime = 0;
+}
+
+ReportReason digitalReporterUpdate(DigitalReporter &reporter, int level, unsigned long now)
+{
+  // Restart the debounce window whenever the raw level moves
+  if (level != reporter.candidateLevel)
+  {
+    reporter.candidateLevel = level;
+    reporter.candidateSince = now;
+  }
+
+  if (reporter.candidateLevel != reporter.stableLevel && now - reporter.candidateSince >= reporter.debounceMs)
+  {
+    reporter.stableLevel = reporter.candidateLevel;
+    reporter.lastReportTime = now;
+    return REPORT_CHANGE;
+  }
+
+  // Signed difference: edges captured by interrupt can carry a time slightly before the last report
+  if (reporter.stableLevel >= 0 && (long)(now - reporter.lastReportTime) >= (long)reporter.heartbeatMs)
+  {
+    reporter.lastReportTime = now;
+    return REPORT_HEARTBEAT;
+  }
+  return REPORT_NONE;
+}
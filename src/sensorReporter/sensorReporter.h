@@ -0,0 +1,28 @@
+#ifndef SENSOR_REPORTER_H
+#define SENSOR_REPORTER_H
+
+#include <stdint.h>
+
+// Why a reporter asked for a value to be sent
+enum ReportReason
+{
+  REPORT_NONE,
+  REPORT_CHANGE,
+  REPORT_HEARTBEAT
+};
+
+// Two-level input that must hold a new level for debounceMs before it counts as an edge
+struct DigitalReporter
+{
+  unsigned long debounceMs;
+  unsigned long heartbeatMs;
+  int stableLevel; // -1 until the first level has settled
+  int candidateLevel;
+  unsigned long candidateSince;
+  unsigned long lastReportTime;
+};
+
+void digitalReporterInit(DigitalReporter &reporter, unsigned long debounceMs, unsigned long heartbeatMs);
+ReportReason digitalReporterUpdate(DigitalReporter &reporter, int level, unsigned long now);
+
+#endif
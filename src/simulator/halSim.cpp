@@ -0,0 +1,206 @@
+#include "simulator.h"
+#include <stdio.h>
+#include <string.h>
+#include "../vibrationKernel/vibrationKernel.h"
+#include "../logger/logger.h"
+
+const char *const simTelemetryNames[TELEMETRY_COUNT] = {"motion", "vibration", "magnetic", "keypad", "rfid"};
+
+static const char levelNames[] = {'D', 'I', 'W', 'E'};
+static const char *moduleNames[LOG_MODULE_COUNT] = {"main",    "sensors",  "keypad",  "rfid",    "pin",
+                                                    "network", "supabase", "journal", "realtime"};
+
+// Every sensor starts switched on
+int sirenStatus = 1;
+int rfidStatus = 1;
+int keypadStatus = 1;
+int vibrationStatus = 1;
+int magneticStatus = 1;
+int motionStatus = 1;
+
+SimState sim;
+
+uint32_t simMillis()
+{
+  return (uint32_t)(sim.nowMicros / 1000);
+}
+
+void simStimulus(SimLatency &latency)
+{
+  latency.pending = true;
+  latency.pendingAt = simMillis();
+}
+
+void simRecord(SimLatency &latency)
+{
+  if (!latency.pending)
+  {
+    return;
+  }
+  latency.pending = false;
+  uint32_t ms = simMillis() - latency.pendingAt;
+  latency.count++;
+  latency.totalMs += ms;
+  if (ms > latency.maxMs)
+  {
+    latency.maxMs = ms;
+  }
+}
+
+uint32_t halMillis()
+{
+  return simMillis();
+}
+
+uint32_t halMicros()
+{
+  return (uint32_t)sim.nowMicros;
+}
+
+int halDigitalRead(uint8_t pin)
+{
+  return pin < SIM_PIN_COUNT ? sim.levels[pin] : 0;
+}
+
+// A linear congruential generator with a fixed seed keeps the noise identical between runs
+uint16_t halAnalogRead(uint8_t pin)
+{
+  if (pin != SIM_VIBRATION_PIN)
+  {
+    return 0;
+  }
+  if (sim.vibrationSpike)
+  {
+    uint16_t spike = sim.vibrationSpike;
+    sim.vibrationSpike = 0;
+    return spike;
+  }
+  uint16_t level = simMillis() < sim.vibrationUntil ? sim.vibrationLevel : sim.vibrationBaseline;
+  sim.noiseSeed = sim.noiseSeed * 1664525 + 1013904223;
+  int noise = sim.vibrationNoise ? (int)(sim.noiseSeed >> 16) % (2 * sim.vibrationNoise + 1) - sim.vibrationNoise : 0;
+  int sample = level + noise;
+  return sample < 0 ? 0 : sample > VIBRATION_SAMPLE_MASK ? VIBRATION_SAMPLE_MASK : sample;
+}
+
+char halKeypadKey()
+{
+  if (sim.keyCount == 0 || sim.keys[0].at > simMillis())
+  {
+    return 0;
+  }
+  char key = sim.keys[0].key;
+  memmove(&sim.keys[0], &sim.keys[1], (sim.keyCount - 1) * sizeof(SimKey));
+  sim.keyCount--;
+  if (key == '#')
+  {
+    simStimulus(sim.telemetry[TELEMETRY_KEYPAD]);
+    simStimulus(sim.accessLatency);
+  }
+  return key;
+}
+
+void halDisplay(const char *line0, const char *line1)
+{
+  snprintf(sim.display[0], sizeof(sim.display[0]), "%-16s", line0);
+  snprintf(sim.display[1], sizeof(sim.display[1]), "%-16s", line1);
+}
+
+void halDisplayAt(uint8_t col, uint8_t row, const char *text)
+{
+  for (; *text && col < 16 && row < 2; text++, col++)
+  {
+    sim.display[row][col] = *text;
+  }
+}
+
+bool halRfidRead(uint8_t *uid, uint8_t &length)
+{
+  if (!sim.cardPresent)
+  {
+    return false;
+  }
+  sim.cardPresent = false;
+  length = sim.cardLength;
+  memcpy(uid, sim.card, length);
+  return true;
+}
+
+void halSiren(bool on)
+{
+  if (on && !sim.siren)
+  {
+    sim.sirenStarts++;
+    simRecord(sim.sirenLatency);
+  }
+  sim.siren = on;
+}
+
+void halChime()
+{
+  sim.chimes++;
+  simRecord(sim.accessLatency);
+}
+
+void halBackendSend(TelemetryId id, int32_t value, bool critical)
+{
+  sim.sent[id]++;
+  simRecord(sim.telemetry[id]);
+  if (!sim.quiet)
+  {
+    printf("%9.3f   -> %s %d%s\n", sim.nowMicros / 1e6, simTelemetryNames[id], (int)value,
+           critical ? " (critical)" : "");
+  }
+}
+
+// Same hashing and lockout as the PIN store, in software, so its cost shows in the host timings
+HalPinResult halCheckPin(const char *digits, uint8_t length, int &userId)
+{
+  if (pinLockoutRemaining(sim.pinLockout, simMillis()) > 0)
+  {
+    return HAL_PIN_LOCKED_OUT;
+  }
+  uint8_t hash[PIN_HASH_BYTES];
+  pinHashSalted(sim.salt, digits, length, hash, false);
+  for (uint8_t i = 0; i < sim.users; i++)
+  {
+    if (pinHashEqual(hash, sim.pinHashes[i], PIN_HASH_BYTES))
+    {
+      userId = i;
+      pinLockoutSuccess(sim.pinLockout);
+      return HAL_PIN_ACCEPTED;
+    }
+  }
+  pinLockoutFailure(sim.pinLockout, simMillis());
+  return HAL_PIN_REJECTED;
+}
+
+bool halCheckCard(const uint8_t *uid, uint8_t length)
+{
+  return uidTableContains(sim.cards, uid, length);
+}
+
+// The device's logger queues records for its own task; here they are formatted at once,
+// stamped with the virtual clock
+uint8_t logLevel(LogModule)
+{
+  return LOG_LEVEL_INFO;
+}
+
+void logRecord(uint8_t level, LogModule module, const char *format, const uintptr_t *args, int textIndex,
+               const char *text)
+{
+  uintptr_t a[LOG_MAX_ARGS + 1];
+  memcpy(a, args, sizeof(a));
+  if (textIndex >= 0)
+  {
+    a[textIndex] = (uintptr_t)text;
+  }
+  sim.logLines++;
+  if (sim.quiet)
+  {
+    return;
+  }
+  printf("%9.3f %c %s: ", sim.nowMicros / 1e6, levelNames[level], moduleNames[module]);
+  printf(format, a[0], a[1], a[2], a[3]);
+  printf("\n");
+}
@@ -0,0 +1,433 @@
+// The trace runner. Unit tests bring their own main() and drive the simulated peripherals directly
+#ifndef PIO_UNIT_TESTING
+
+#include "simulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "../alarmLogic/alarmLogic.h"
+
+#define SIM_MAX_EVENTS 512
+#define SIM_LINE_BYTES 128
+#define SIM_KEY_GAP_MS 200 // Time between scripted key presses unless the trace gives one
+#define SIM_TAIL_MS 10000  // Run on after the last event so access timeouts show
+
+// A scripted input: "<ms> <command> [arguments]", see defaultTrace
+struct SimEvent
+{
+  uint32_t at;
+  char command[12];
+  char argument[40];
+  uint32_t value;
+};
+
+// Host time spent in each pass; unlike everything else these vary between runs
+struct SimHostTiming
+{
+  uint32_t passes;
+  uint64_t totalNs;
+  uint64_t maxNs;
+};
+
+static const char *defaultTrace =
+    "# Door opened by an intruder, a knock, then a resident with a card and with the keypad\n"
+    "0 allow 7A77C7B2\n"
+    "0 allow 43 10 73 0E\n"
+    "0 pin 123456\n"
+    "0 noise 40\n"
+    "1000 motion 1\n"
+    "1040 motion 0\n" // A glitch shorter than the debounce window
+    "2000 motion 1\n"
+    "4000 motion 0\n"
+    "5000 door 1\n"
+    "9000 door 0\n"
+    "11000 spike 4095\n" // One noisy ADC sample
+    "12000 vibration 4095 400\n"
+    "16000 card 7A77C7B2\n"
+    "16500 door 1\n"
+    "19000 door 0\n"
+    "26000 card DEADBEEF\n"
+    "32000 keys 654321#\n"
+    "36000 keys 123456#\n"
+    "38000 door 1\n"
+    "40000 door 0\n"
+    "44000 status siren 0\n"
+    "45000 door 1\n"
+    "47000 door 0\n"
+    "48000 status siren 1\n";
+
+static SimEvent events[SIM_MAX_EVENTS];
+static int eventCount = 0;
+static SimHostTiming sensorTiming;
+static SimHostTiming accessTiming;
+
+static bool parseLine(const char *line, int number)
+{
+  while (*line == ' ' || *line == '\t')
+  {
+    line++;
+  }
+  if (*line == '#' || *line == '\n' || *line == '\0')
+  {
+    return true;
+  }
+  if (eventCount >= SIM_MAX_EVENTS)
+  {
+    fprintf(stderr, "line %d: more than %d events\n", number, SIM_MAX_EVENTS);
+    return false;
+  }
+  SimEvent &event = events[eventCount];
+  memset(&event, 0, sizeof(event));
+  int consumed = 0;
+  if (sscanf(line, "%u %11s %n", &event.at, event.command, &consumed) < 2)
+  {
+    fprintf(stderr, "line %d: expected \"<ms> <command> [arguments]\"\n", number);
+    return false;
+  }
+  // The rest of the line is the argument; a trailing number is also kept as the value
+  snprintf(event.argument, sizeof(event.argument), "%s", line + consumed);
+  event.argument[strcspn(event.argument, "\r\n")] = '\0';
+  const char *last = strrchr(event.argument, ' ');
+  event.value = strtoul(last ? last + 1 : event.argument, NULL, 10);
+  eventCount++;
+  return true;
+}
+
+static bool loadTrace(FILE *file, const char *text)
+{
+  char line[SIM_LINE_BYTES];
+  int number = 0;
+  while (file ? fgets(line, sizeof(line), file) != NULL : *text != '\0')
+  {
+    if (!file)
+    {
+      size_t length = strcspn(text, "\n");
+      snprintf(line, sizeof(line), "%.*s", (int)length, text);
+      text += length + (text[length] == '\n');
+    }
+    if (!parseLine(line, ++number))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void setLevel(uint8_t pin, int level, TelemetryId id, bool sirenCause)
+{
+  if (sim.levels[pin] == level)
+  {
+    return;
+  }
+  sim.levels[pin] = level;
+  if (sim.edgeCount < SIM_MAX_EDGES)
+  {
+    sim.edges[sim.edgeCount++] = {pin, level, simMillis()};
+  }
+  simStimulus(sim.telemetry[id]);
+  if (sirenCause && level)
+  {
+    simStimulus(sim.sirenLatency);
+  }
+}
+
+static int *statusFlag(const char *name)
+{
+  static const struct
+  {
+    const char *name;
+    int *value;
+  } flags[] = {{"siren", &sirenStatus},       {"rfid", &rfidStatus},         {"keypad", &keypadStatus},
+               {"vibration", &vibrationStatus}, {"magnetic", &magneticStatus}, {"motion", &motionStatus}};
+  for (const auto &flag : flags)
+  {
+    if (strncmp(name, flag.name, strlen(flag.name)) == 0)
+    {
+      return flag.value;
+    }
+  }
+  return NULL;
+}
+
+static bool applyEvent(const SimEvent &event)
+{
+  const char *command = event.command;
+  if (strcmp(command, "motion") == 0)
+  {
+    setLevel(SIM_MOTION_PIN, event.value ? 1 : 0, TELEMETRY_MOTION, false);
+  }
+  else if (strcmp(command, "door") == 0)
+  {
+    setLevel(SIM_MAGNETIC_PIN, event.value ? 1 : 0, TELEMETRY_MAGNETIC, true);
+  }
+  else if (strcmp(command, "vibration") == 0)
+  {
+    // "vibration <level> <ms>": the ADC reads level for ms, then the baseline again
+    unsigned level = 0;
+    unsigned duration = 0;
+    sscanf(event.argument, "%u %u", &level, &duration);
+    sim.vibrationLevel = level;
+    sim.vibrationUntil = event.at + duration;
+    simStimulus(sim.telemetry[TELEMETRY_VIBRATION]);
+    simStimulus(sim.sirenLatency);
+  }
+  else if (strcmp(command, "spike") == 0)
+  {
+    // "spike <level>": one ADC sample at level, which must not sound the siren
+    sim.vibrationSpike = event.value;
+  }
+  else if (strcmp(command, "noise") == 0)
+  {
+    sim.vibrationNoise = event.value;
+  }
+  else if (strcmp(command, "card") == 0)
+  {
+    if (!uidParseHex(event.argument, sim.card, sim.cardLength))
+    {
+      return false;
+    }
+    sim.cardPresent = true;
+    simStimulus(sim.telemetry[TELEMETRY_RFID]);
+    simStimulus(sim.accessLatency);
+  }
+  else if (strcmp(command, "keys") == 0)
+  {
+    // "keys <digits>[#] [gap ms]": one press every gap
+    char digits[SIM_MAX_KEYS];
+    unsigned gap = SIM_KEY_GAP_MS;
+    sscanf(event.argument, "%63s %u", digits, &gap);
+    uint32_t at = event.at;
+    for (const char *c = digits; *c && sim.keyCount < SIM_MAX_KEYS; c++, at += gap)
+    {
+      sim.keys[sim.keyCount++] = {*c, at};
+    }
+  }
+  else if (strcmp(command, "status") == 0)
+  {
+    int *flag = statusFlag(event.argument);
+    if (flag == NULL)
+    {
+      return false;
+    }
+    *flag = event.value ? 1 : 0;
+  }
+  else if (strcmp(command, "allow") == 0)
+  {
+    uint8_t uid[UID_MAX_LENGTH];
+    uint8_t length;
+    if (!uidParseHex(event.argument, uid, length) || !uidTableInsert(sim.cards, uid, length))
+    {
+      return false;
+    }
+  }
+  else if (strcmp(command, "pin") == 0)
+  {
+    // A repeated trace adds the same users again; they are only stored once
+    uint8_t hash[PIN_HASH_BYTES];
+    pinHashSalted(sim.salt, event.argument, strlen(event.argument), hash, false);
+    for (uint8_t i = 0; i < sim.users; i++)
+    {
+      if (pinHashEqual(hash, sim.pinHashes[i], PIN_HASH_BYTES))
+      {
+        return true;
+      }
+    }
+    if (sim.users >= SIM_MAX_USERS || strlen(event.argument) > ALARM_PIN_MAX_DIGITS)
+    {
+      return false;
+    }
+    memcpy(sim.pinHashes[sim.users++], hash, PIN_HASH_BYTES);
+  }
+  else if (strcmp(command, "end") != 0)
+  {
+    return false;
+  }
+  return true;
+}
+
+template <typename Pass>
+static void timed(SimHostTiming &timing, Pass pass)
+{
+  auto start = std::chrono::steady_clock::now();
+  pass();
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  timing.passes++;
+  timing.totalNs += ns;
+  if (ns > timing.maxNs)
+  {
+    timing.maxNs = ns;
+  }
+}
+
+// The two tasks of the device, interleaved on the virtual clock. Each wakes at the end of its
+// period or, as with the GPIO and keypad interrupts, as soon as its input changes
+static void run(uint32_t endMs, int repeats, uint32_t traceMs)
+{
+  uint32_t nextSensor = 0;
+  uint32_t nextAccess = 0;
+  int next = 0;
+  int round = 0;
+  while (true)
+  {
+    uint32_t offset = round * traceMs;
+    uint32_t eventAt = next < eventCount ? events[next].at + offset : UINT32_MAX;
+    uint32_t keyAt = sim.keyCount ? sim.keys[0].at : UINT32_MAX;
+    uint32_t now = nextSensor;
+    now = nextAccess < now ? nextAccess : now;
+    now = eventAt < now ? eventAt : now;
+    now = keyAt < now ? keyAt : now;
+    if (now > endMs)
+    {
+      break;
+    }
+    if ((uint64_t)now * 1000 > sim.nowMicros)
+    {
+      sim.nowMicros = (uint64_t)now * 1000;
+    }
+
+    while (next < eventCount && events[next].at + offset <= now)
+    {
+      SimEvent event = events[next++];
+      event.at += offset;
+      if (!applyEvent(event))
+      {
+        fprintf(stderr, "Bad trace event at %u ms: %s %s\n", event.at, event.command, event.argument);
+        exit(1);
+      }
+      if (next == eventCount && round + 1 < repeats)
+      {
+        next = 0;
+        round++;
+        offset = round * traceMs;
+      }
+    }
+
+    if (now >= nextSensor || sim.edgeCount > 0)
+    {
+      timed(sensorTiming, [] {
+        for (uint8_t i = 0; i < sim.edgeCount; i++)
+        {
+          alarmSensorEdge(sim.edges[i].pin, sim.edges[i].level, sim.edges[i].at);
+        }
+        sim.edgeCount = 0;
+        alarmSensorsStep(NULL);
+      });
+      nextSensor = now + (alarmSensorsDebouncing() ? ALARM_DEBOUNCE_POLL_MS : ALARM_SENSOR_LOOP_MS);
+    }
+
+    bool keyDue = sim.keyCount && sim.keys[0].at <= now;
+    if (now >= nextAccess || keyDue)
+    {
+      timed(accessTiming, [] {
+        // A press while the keypad is switched off is lost, as on the device
+        char key = halKeypadKey();
+        alarmAccessStep(keypadStatus ? key : 0);
+      });
+      nextAccess = now + (sim.keyCount ? SIM_ACTIVE_SCAN_MS : ALARM_ACCESS_LOOP_MS);
+    }
+
+    // Each pass is charged a microsecond, so two wakes in the same millisecond stay ordered
+    sim.nowMicros++;
+  }
+}
+
+static void printLatency(const char *name, const SimLatency &latency)
+{
+  printf("  %-22s %5u  avg %6.1f ms  max %5u ms\n", name, latency.count,
+         latency.count ? (double)latency.totalMs / latency.count : 0.0, latency.maxMs);
+}
+
+static void printTiming(const char *name, const SimHostTiming &timing)
+{
+  printf("  %-22s %8u passes  avg %7.0f ns  max %7llu ns\n", name, timing.passes,
+         timing.passes ? (double)timing.totalNs / timing.passes : 0.0, (unsigned long long)timing.maxNs);
+}
+
+static void printReport(uint32_t endMs, double wallSeconds)
+{
+  uint32_t records = 0;
+  for (int i = 0; i < TELEMETRY_COUNT; i++)
+  {
+    records += sim.sent[i];
+  }
+  printf("\nSimulated %.3f s: %u telemetry records (%.1f per minute), %u sirens, %u welcomes, %u log lines\n",
+         endMs / 1000.0, records, endMs ? records * 60000.0 / endMs : 0.0, sim.sirenStarts, sim.chimes, sim.logLines);
+  printf("Latency on the virtual clock (reproducible)\n");
+  for (int i = 0; i < TELEMETRY_COUNT; i++)
+  {
+    char name[24];
+    snprintf(name, sizeof(name), "%s record", simTelemetryNames[i]);
+    printLatency(name, sim.telemetry[i]);
+  }
+  printLatency("siren on", sim.sirenLatency);
+  printLatency("access granted", sim.accessLatency);
+  printf("Host time per pass (varies with the machine)\n");
+  printTiming("sensor pass", sensorTiming);
+  printTiming("keypad pass", accessTiming);
+  printf("  %.0f passes per second, %.0fx real time\n",
+         wallSeconds > 0 ? (sensorTiming.passes + accessTiming.passes) / wallSeconds : 0.0,
+         wallSeconds > 0 ? endMs / 1000.0 / wallSeconds : 0.0);
+}
+
+// Usage: program [-q] [trace file] [repeats]. Without a file the built-in trace runs
+int main(int argc, char **argv)
+{
+  int arg = 1;
+  if (arg < argc && strcmp(argv[arg], "-q") == 0)
+  {
+    sim.quiet = true;
+    arg++;
+  }
+  bool loaded;
+  if (arg < argc)
+  {
+    FILE *file = fopen(argv[arg], "r");
+    if (file == NULL)
+    {
+      fprintf(stderr, "Cannot open %s\n", argv[arg]);
+      return 1;
+    }
+    loaded = loadTrace(file, NULL);
+    fclose(file);
+    arg++;
+  }
+  else
+  {
+    loaded = loadTrace(NULL, defaultTrace);
+  }
+  if (!loaded)
+  {
+    return 1;
+  }
+  int repeats = arg < argc ? atoi(argv[arg]) : 1;
+  repeats = repeats > 0 ? repeats : 1;
+
+  // Events need not be in order in the file
+  qsort(events, eventCount, sizeof(SimEvent), [](const void *a, const void *b) {
+    uint32_t x = ((const SimEvent *)a)->at;
+    uint32_t y = ((const SimEvent *)b)->at;
+    return x < y ? -1 : x > y ? 1 : 0;
+  });
+  uint32_t traceMs = (eventCount ? events[eventCount - 1].at : 0) + SIM_TAIL_MS;
+  uint32_t endMs = traceMs * repeats;
+
+  uidTableClear(sim.cards);
+  for (int i = 0; i < PIN_SALT_BYTES; i++)
+  {
+    sim.salt[i] = i * 37 + 11;
+  }
+  pinLockoutInit(sim.pinLockout);
+  sim.noiseSeed = 1;
+  sim.vibrationBaseline = 0;
+  alarmLogicBegin({SIM_MOTION_PIN, SIM_MAGNETIC_PIN, SIM_VIBRATION_PIN});
+  alarmAccessBegin();
+
+  auto start = std::chrono::steady_clock::now();
+  run(endMs, repeats, traceMs);
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printReport(endMs, wallSeconds);
+  return 0;
+}
+
+#endif
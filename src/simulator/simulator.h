@@ -0,0 +1,100 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+// Native build only: the peripherals behind the HAL, simulated on a virtual clock and driven
+// by a scripted trace, so runs are reproducible to the microsecond
+
+#include <stdint.h>
+#include "../hal/hal.h"
+#include "../uidTable/uidTable.h"
+#include "../pinHash/pinHash.h"
+#include "../pinLockout/pinLockout.h"
+
+// Same wiring as the device
+#define SIM_MOTION_PIN 16
+#define SIM_MAGNETIC_PIN 14
+#define SIM_VIBRATION_PIN 35
+#define SIM_PIN_COUNT 40
+
+#define SIM_MAX_EDGES 64
+#define SIM_MAX_KEYS 64
+#define SIM_MAX_USERS 4
+#define SIM_ACTIVE_SCAN_MS 20 // Keypad pass period while a key is down, as on the device
+
+// Virtual time from a stimulus in the trace to the reaction it should cause
+struct SimLatency
+{
+  uint32_t count;
+  uint32_t maxMs;
+  uint64_t totalMs;
+  uint32_t pendingAt;
+  bool pending;
+};
+
+struct SimEdge
+{
+  uint8_t pin;
+  int level;
+  uint32_t at;
+};
+
+struct SimKey
+{
+  char key;
+  uint32_t at;
+};
+
+struct SimState
+{
+  uint64_t nowMicros;
+  int levels[SIM_PIN_COUNT];
+  uint16_t vibrationLevel; // ADC value the sensor settles at
+  uint16_t vibrationNoise; // Peak of the deterministic noise added to each sample
+  uint32_t vibrationUntil; // A burst returns to the baseline at this time
+  uint16_t vibrationBaseline;
+  uint16_t vibrationSpike; // The next ADC read returns this once, as a noisy sample would
+  uint32_t noiseSeed;
+
+  SimEdge edges[SIM_MAX_EDGES]; // Captured edges not yet seen by a sensor pass
+  uint8_t edgeCount;
+  SimKey keys[SIM_MAX_KEYS]; // Pending presses, oldest first
+  uint8_t keyCount;
+  uint8_t card[UID_MAX_LENGTH];
+  uint8_t cardLength;
+  bool cardPresent;
+
+  UidTable cards;
+  uint8_t salt[PIN_SALT_BYTES];
+  uint8_t pinHashes[SIM_MAX_USERS][PIN_HASH_BYTES];
+  uint8_t users;
+  PinLockout pinLockout;
+
+  bool siren;
+  uint32_t sirenStarts;
+  uint32_t chimes;
+  uint32_t sent[TELEMETRY_COUNT];
+  char display[2][17];
+
+  SimLatency telemetry[TELEMETRY_COUNT]; // Input change to the record it produces
+  SimLatency sirenLatency;               // Door opened or struck to siren on
+  SimLatency accessLatency;              // Card shown or '#' pressed to access granted
+  uint32_t logLines;
+  bool quiet;
+};
+
+// Status flags, as configSync keeps them on the device
+extern int sirenStatus;
+extern int rfidStatus;
+extern int keypadStatus;
+extern int vibrationStatus;
+extern int magneticStatus;
+extern int motionStatus;
+
+extern SimState sim;
+extern const char *const simTelemetryNames[TELEMETRY_COUNT];
+
+uint32_t simMillis();
+void simStimulus(SimLatency &latency);
+void simRecord(SimLatency &latency);
+
+#endif
@@ -0,0 +1,713 @@
+#include "supabaseConnection.h"
+#include <Preferences.h>
+#include "../logger/logger.h"
+#include "../metrics/metrics.h"
+
+#define SUPABASE_PORT 443
+#define SUPABASE_RESPONSE_TIMEOUT 5000
+#define SUPABASE_TOKEN_MARGIN 60000 // Requests refresh the token inline this long before it expires
+#define SUPABASE_REFRESH_AHEAD 300000 // supabaseSessionDue() asks for a refresh this long before that
+#define SUPABASE_NVS_NAMESPACE "supabase"
+#define SUPABASE_HOST_BYTES 96
+#define SUPABASE_KEY_BYTES 512
+#define SUPABASE_LOGIN_BYTES 128
+#define SUPABASE_REFRESH_BYTES 128
+#define SUPABASE_HEADER_BYTES (SUPABASE_KEY_BYTES + SUPABASE_TOKEN_BYTES + 512)
+#define SUPABASE_LINE_BYTES 128 // Longer header lines are cut; only the short ones are parsed
+#define SUPABASE_BODY_BUFFER_BYTES 128
+
+// Response body in the framing the headers announced, read through a small buffer. Buffered
+// requests drain it into a SupabaseResponse; streamed ones hand it to the parser as a Stream
+class SupabaseBody : public Stream
+{
+public:
+  void begin(long contentLength, bool chunked);
+  bool drain(SupabaseResponse *response);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t) override { return 0; }
+
+private:
+  bool fill();
+
+  char buffer[SUPABASE_BODY_BUFFER_BYTES];
+  size_t position;
+  size_t filled;
+  long remaining; // Of the body, or of the current chunk; -1 when the body runs to the close
+  bool isChunked;
+  uint32_t chunks;
+  bool finished;
+  bool broken;
+};
+
+static WiFiClientSecure client;
+static char host[SUPABASE_HOST_BYTES];
+static char apiKey[SUPABASE_KEY_BYTES];
+static char accessToken[SUPABASE_TOKEN_BYTES];
+static char loginEmail[SUPABASE_LOGIN_BYTES];
+static char loginPassword[SUPABASE_LOGIN_BYTES];
+static char refreshToken[SUPABASE_REFRESH_BYTES];
+static unsigned long tokenExpiresAt = 0;
+static bool authenticating = false; // Token requests go out with the anon key and must not refresh themselves
+static unsigned long nextInlineRefresh = 0;
+static uint32_t sessionGeneration = 0; // Bumped with every new access token
+static SupabaseConnectionStats stats;
+
+// Requests are serialised by xSupabaseMutex, so one set of buffers serves them all
+static char header[SUPABASE_HEADER_BYTES];
+static char line[SUPABASE_LINE_BYTES];
+static SupabaseResponse sharedResponse;
+static SupabaseBody responseBody;
+static bool keepAlive = true;
+static unsigned long requestStart;
+static unsigned long requestStartMicros;
+static const char *streamMethod;
+static const char *streamPath;
+static int streamCode = -1;
+
+static void copyString(char *out, size_t size, const char *value, size_t length)
+{
+  if (length >= size)
+  {
+    length = size - 1;
+  }
+  memcpy(out, value, length);
+  out[length] = '\0';
+}
+
+void supabaseConnectionBegin(const char *url, const char *key)
+{
+  // Keep only the host name of e.g. https://xyz.supabase.co/
+  const char *start = strstr(url, "://");
+  start = start ? start + 3 : url;
+  const char *end = strchr(start, '/');
+  copyString(host, sizeof(host), start, end ? end - start : strlen(start));
+
+  copyString(apiKey, sizeof(apiKey), key, strlen(key));
+  client.setInsecure();
+  client.setTimeout(SUPABASE_RESPONSE_TIMEOUT / 1000);
+}
+
+const char *supabaseHost()
+{
+  return host;
+}
+
+const char *supabaseApiKey()
+{
+  return apiKey;
+}
+
+SupabaseResponse &supabaseResponse()
+{
+  return sharedResponse;
+}
+
+size_t supabaseJsonString(char *out, size_t size, const char *value)
+{
+  size_t length = 0;
+  if (size < 3)
+  {
+    return 0;
+  }
+  out[length++] = '"';
+  for (const char *c = value; *c; c++)
+  {
+    char escaped = 0;
+    if (*c == '"' || *c == '\\')
+    {
+      escaped = *c;
+    }
+    else if (*c == '\n')
+    {
+      escaped = 'n';
+    }
+    else if (*c == '\r')
+    {
+      escaped = 'r';
+    }
+    else if (*c == '\t')
+    {
+      escaped = 't';
+    }
+    if (length + (escaped ? 2 : 1) + 2 > size)
+    {
+      return 0;
+    }
+    if (escaped)
+    {
+      out[length++] = '\\';
+      out[length++] = escaped;
+    }
+    else
+    {
+      out[length++] = *c;
+    }
+  }
+  out[length++] = '"';
+  out[length] = '\0';
+  return length;
+}
+
+static bool ensureConnected(bool *reused)
+{
+  if (client.connected())
+  {
+    *reused = true;
+    return true;
+  }
+  *reused = false;
+  client.stop();
+
+  unsigned long start = millis();
+  if (!client.connect(host, SUPABASE_PORT))
+  {
+    LOG_WARN(LOG_SUPABASE, "Supabase connection failed");
+    return false;
+  }
+  stats.handshakes++;
+  stats.lastHandshakeMs = millis() - start;
+  return true;
+}
+
+// Reads one line without its line ending; the part that does not fit in line is dropped
+static bool readLine()
+{
+  size_t length = 0;
+  char c;
+  while (client.readBytes(&c, 1) == 1)
+  {
+    if (c == '\n')
+    {
+      break;
+    }
+    if (length < sizeof(line) - 1)
+    {
+      line[length++] = c;
+    }
+  }
+  while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' '))
+  {
+    length--;
+  }
+  line[length] = '\0';
+  return length > 0 || client.connected();
+}
+
+static void appendResponse(SupabaseResponse *response, const char *data, size_t length)
+{
+  if (response == NULL)
+  {
+    return;
+  }
+  size_t room = SUPABASE_RESPONSE_BYTES - response->length;
+  if (length > room)
+  {
+    length = room;
+    response->truncated = true;
+  }
+  memcpy(&response->data[response->length], data, length);
+  response->length += length;
+  response->data[response->length] = '\0';
+}
+
+void SupabaseBody::begin(long contentLength, bool chunked)
+{
+  setTimeout(0); // read() already waits on the socket; Stream's own retry loop would only spin
+  remaining = contentLength;
+  isChunked = chunked;
+  chunks = 0;
+  position = 0;
+  filled = 0;
+  finished = !chunked && contentLength == 0;
+  broken = false;
+}
+
+// Refills the buffer from the socket, never reading past the end of the body
+bool SupabaseBody::fill()
+{
+  if (finished || broken)
+  {
+    return false;
+  }
+  if (isChunked && remaining == 0)
+  {
+    // The line ending after the previous chunk, then the size of the next one
+    if ((chunks > 0 && !readLine()) || !readLine())
+    {
+      broken = true;
+      return false;
+    }
+    remaining = strtol(line, NULL, 16);
+    chunks++;
+    if (remaining <= 0)
+    {
+      readLine(); // Blank line after the last chunk
+      finished = true;
+      return false;
+    }
+  }
+
+  size_t want = sizeof(buffer);
+  if (remaining >= 0 && (size_t)remaining < want)
+  {
+    want = remaining;
+  }
+  if (remaining < 0)
+  {
+    // No length given, so the body ends when the server closes the connection
+    int ready = client.available();
+    if (ready <= 0 && !client.connected())
+    {
+      finished = true;
+      return false;
+    }
+    if (ready <= 0)
+    {
+      want = 1;
+    }
+    else if ((size_t)ready < want)
+    {
+      want = ready;
+    }
+  }
+
+  size_t got = client.readBytes(buffer, want);
+  if (got == 0)
+  {
+    finished = remaining < 0;
+    broken = !finished;
+    return false;
+  }
+  position = 0;
+  filled = got;
+  if (remaining > 0)
+  {
+    remaining -= got;
+    finished = !isChunked && remaining == 0;
+  }
+  return true;
+}
+
+int SupabaseBody::available()
+{
+  return filled - position;
+}
+
+int SupabaseBody::read()
+{
+  if (position == filled && !fill())
+  {
+    return -1;
+  }
+  return (uint8_t)buffer[position++];
+}
+
+int SupabaseBody::peek()
+{
+  if (position == filled && !fill())
+  {
+    return -1;
+  }
+  return (uint8_t)buffer[position];
+}
+
+// Reads whatever is left of the body, appending it to response when given
+bool SupabaseBody::drain(SupabaseResponse *response)
+{
+  while (position < filled || fill())
+  {
+    appendResponse(response, &buffer[position], filled - position);
+    position = filled;
+  }
+  return !broken;
+}
+
+// Writes the request and reads the status line and headers, leaving the body to responseBody;
+// -1 means the connection gave no answer
+static int sendRequest(const char *method, const char *path, const char *body, const char *prefer)
+{
+  // Build the header block so it goes out in as few TLS records as possible
+  size_t bodyLength = body ? strlen(body) : 0;
+  int headerLength = snprintf(header, sizeof(header),
+                              "%s %s HTTP/1.1\r\nHost: %s\r\napikey: %s\r\nAuthorization: Bearer %s\r\n"
+                              "Connection: keep-alive\r\nContent-Type: application/json\r\n%s%s%s"
+                              "Content-Length: %u\r\n\r\n",
+                              method, path, host, apiKey, accessToken[0] && !authenticating ? accessToken : apiKey,
+                              prefer ? "Prefer: " : "", prefer ? prefer : "", prefer ? "\r\n" : "",
+                              (unsigned)bodyLength);
+  if (headerLength < 0 || (size_t)headerLength >= sizeof(header))
+  {
+    LOG_ERROR(LOG_SUPABASE, "Supabase request header too long");
+    return -1;
+  }
+
+  if (client.write((const uint8_t *)header, headerLength) != (size_t)headerLength ||
+      (bodyLength && client.write((const uint8_t *)body, bodyLength) != bodyLength))
+  {
+    return -1;
+  }
+
+  if (!readLine() || strncmp(line, "HTTP/1.1 ", 9) != 0)
+  {
+    return -1;
+  }
+  int code = atoi(&line[9]);
+
+  long contentLength = -1;
+  bool chunked = false;
+  keepAlive = true;
+  while (readLine() && line[0] != '\0')
+  {
+    for (char *c = line; *c; c++)
+    {
+      *c = tolower(*c);
+    }
+    if (strncmp(line, "content-length:", 15) == 0)
+    {
+      contentLength = atol(&line[15]);
+    }
+    else if (strncmp(line, "transfer-encoding:", 18) == 0 && strstr(line, "chunked"))
+    {
+      chunked = true;
+    }
+    else if (strncmp(line, "connection:", 11) == 0 && strstr(line, "close"))
+    {
+      keepAlive = false;
+    }
+  }
+  if (!chunked && contentLength < 0)
+  {
+    keepAlive = false;
+  }
+  responseBody.begin(contentLength, chunked);
+  return code;
+}
+
+// Reads the rest of the body; a half-read response would corrupt the next one on this socket
+static void finishResponse(SupabaseResponse *response)
+{
+  bool complete = responseBody.drain(response);
+  if (response && response->truncated)
+  {
+    LOG_WARN(LOG_SUPABASE, "Supabase response cut to %u bytes", SUPABASE_RESPONSE_BYTES);
+  }
+  if (!complete || !keepAlive)
+  {
+    client.stop();
+  }
+}
+
+static void refreshLoginIfExpired()
+{
+  // After a failure, requests go on with the old token for a while instead of each retrying the login
+  if (!authenticating && loginEmail[0] && (long)(millis() - tokenExpiresAt) >= 0 &&
+      (long)(millis() - nextInlineRefresh) >= 0)
+  {
+    supabaseSessionRefresh();
+  }
+}
+
+// Sends the request and reads up to the body, which is read into response when buffered is set.
+// The server may have dropped an idle connection, so a reused one gets a second try on a fresh one
+static int openRequest(const char *method, const char *path, const char *body, const char *prefer,
+                       SupabaseResponse *response, bool buffered)
+{
+  refreshLoginIfExpired();
+  requestStart = millis();
+  requestStartMicros = micros();
+  stats.requests++;
+
+  int code = -1;
+  for (int attempt = 0; attempt < 2 && code < 0; attempt++)
+  {
+    bool reused = false;
+    if (!ensureConnected(&reused))
+    {
+      break;
+    }
+    if (response)
+    {
+      response->length = 0;
+      response->truncated = false;
+      response->data[0] = '\0';
+    }
+    code = sendRequest(method, path, body, prefer);
+    if (code < 0)
+    {
+      client.stop();
+      if (!reused)
+      {
+        break;
+      }
+    }
+    else if (reused)
+    {
+      stats.reused++;
+    }
+  }
+  if (code >= 0 && buffered)
+  {
+    finishResponse(response);
+  }
+  return code;
+}
+
+static void recordRequest(const char *method, const char *path, int code)
+{
+  metricsRecordRequest(method, path, micros() - requestStartMicros);
+  if (code < 0)
+  {
+    stats.failures++;
+    return;
+  }
+  if (code == 401 && !authenticating && accessToken[0])
+  {
+    // Revoked or expired early; the next request (or the Supabase task) gets a new token
+    tokenExpiresAt = millis();
+  }
+
+  uint32_t elapsed = millis() - requestStart;
+  stats.lastLatencyMs = elapsed;
+  stats.totalLatencyMs += elapsed;
+  if (elapsed > stats.maxLatencyMs)
+  {
+    stats.maxLatencyMs = elapsed;
+  }
+}
+
+int supabaseRequest(const char *method, const char *path, const char *body, const char *prefer, SupabaseResponse *response)
+{
+  int code = openRequest(method, path, body, prefer, response, true);
+  recordRequest(method, path, code);
+  return code;
+}
+
+int supabaseStreamBegin(const char *method, const char *path, const char *body, const char *prefer)
+{
+  streamMethod = method;
+  streamPath = path;
+  streamCode = openRequest(method, path, body, prefer, NULL, false);
+  if (streamCode < 0)
+  {
+    recordRequest(method, path, streamCode);
+  }
+  return streamCode;
+}
+
+Stream &supabaseStreamBody()
+{
+  return responseBody;
+}
+
+void supabaseStreamEnd()
+{
+  if (streamCode < 0)
+  {
+    return;
+  }
+  finishResponse(NULL);
+  recordRequest(streamMethod, streamPath, streamCode);
+  streamCode = -1;
+}
+
+// Copies the string value of "key": from a GoTrue token response. Tokens have no characters
+// that need escaping, so the fields are picked out directly instead of parsing the user object
+static bool copyField(const char *json, const char *key, char *out, size_t size)
+{
+  const char *value = strstr(json, key);
+  if (value == NULL)
+  {
+    return false;
+  }
+  value += strlen(key);
+  const char *end = strchr(value, '"');
+  if (end == NULL || (size_t)(end - value) >= size)
+  {
+    return false;
+  }
+  copyString(out, size, value, end - value);
+  return true;
+}
+
+static void saveRefreshToken()
+{
+  Preferences prefs;
+  if (!prefs.begin(SUPABASE_NVS_NAMESPACE, false))
+  {
+    LOG_ERROR(LOG_SUPABASE, "Failed to open Supabase session in NVS");
+    return;
+  }
+  if (refreshToken[0])
+  {
+    prefs.putString("refresh", refreshToken);
+  }
+  else
+  {
+    prefs.remove("refresh");
+  }
+  prefs.end();
+}
+
+// Sends a token request with body and keeps the tokens it returns; returns the HTTP status
+static int requestToken(const char *path, const char *body)
+{
+  authenticating = true;
+  SupabaseResponse &response = supabaseResponse();
+  int code = supabaseRequest("POST", path, body, NULL, &response);
+  authenticating = false;
+  if (code != 200)
+  {
+    return code;
+  }
+
+  char token[SUPABASE_TOKEN_BYTES];
+  if (!copyField(response.data, "\"access_token\":\"", token, sizeof(token)))
+  {
+    LOG_ERROR(LOG_SUPABASE, "Supabase token response could not be parsed");
+    return -1;
+  }
+  copyString(accessToken, sizeof(accessToken), token, strlen(token));
+  sessionGeneration++;
+  const char *expires = strstr(response.data, "\"expires_in\":");
+  unsigned long expiresIn = expires ? strtoul(expires + 13, NULL, 10) : 3600;
+  tokenExpiresAt = millis() + expiresIn * 1000 - SUPABASE_TOKEN_MARGIN;
+
+  // The refresh token is single use, so every new one replaces the cached one
+  if (copyField(response.data, "\"refresh_token\":\"", refreshToken, sizeof(refreshToken)))
+  {
+    saveRefreshToken();
+  }
+  return code;
+}
+
+static bool refreshSession()
+{
+  char body[SUPABASE_REFRESH_BYTES + 32];
+  size_t length = snprintf(body, sizeof(body), "{\"refresh_token\":");
+  size_t value = supabaseJsonString(&body[length], sizeof(body) - length - 1, refreshToken);
+  if (value == 0)
+  {
+    return false;
+  }
+  length += value;
+  body[length++] = '}';
+  body[length] = '\0';
+
+  int code = requestToken("/auth/v1/token?grant_type=refresh_token", body);
+  if (code == 200)
+  {
+    stats.tokenRefreshes++;
+    return true;
+  }
+  if (code == 400 || code == 401)
+  {
+    // Rejected (used, revoked or the user signed out); only the password can start a new session
+    LOG_WARN(LOG_SUPABASE, "Supabase refresh token rejected: HTTP %d", code);
+    refreshToken[0] = '\0';
+    saveRefreshToken();
+  }
+  else if (code > 0)
+  {
+    // Rate limited or a server error; the token is still good for the next attempt
+    LOG_WARN(LOG_SUPABASE, "Supabase token refresh failed: HTTP %d", code);
+  }
+  return false;
+}
+
+static bool passwordLogin()
+{
+  char body[2 * SUPABASE_LOGIN_BYTES + 32];
+  size_t length = snprintf(body, sizeof(body), "{\"email\":");
+  size_t value = supabaseJsonString(&body[length], sizeof(body) - length, loginEmail);
+  length += value;
+  if (value == 0 || length + 12 >= sizeof(body))
+  {
+    LOG_ERROR(LOG_SUPABASE, "Supabase login credentials too long");
+    return false;
+  }
+  length += snprintf(&body[length], sizeof(body) - length, ",\"password\":");
+  value = supabaseJsonString(&body[length], sizeof(body) - length - 1, loginPassword);
+  if (value == 0)
+  {
+    LOG_ERROR(LOG_SUPABASE, "Supabase login credentials too long");
+    return false;
+  }
+  length += value;
+  body[length++] = '}';
+  body[length] = '\0';
+
+  int code = requestToken("/auth/v1/token?grant_type=password", body);
+  memset(body, 0, sizeof(body));
+  if (code != 200)
+  {
+    LOG_ERROR(LOG_SUPABASE, "Supabase login failed: HTTP %d", code);
+    return false;
+  }
+  stats.passwordLogins++;
+  return true;
+}
+
+bool supabaseSessionBegin(const char *email, const char *password)
+{
+  copyString(loginEmail, sizeof(loginEmail), email, strlen(email));
+  copyString(loginPassword, sizeof(loginPassword), password, strlen(password));
+  accessToken[0] = '\0';
+  refreshToken[0] = '\0';
+  tokenExpiresAt = millis();
+
+  Preferences prefs;
+  if (prefs.begin(SUPABASE_NVS_NAMESPACE, true))
+  {
+    prefs.getString("refresh", refreshToken, sizeof(refreshToken));
+    prefs.end();
+  }
+  return refreshToken[0] != '\0';
+}
+
+bool supabaseSessionDue()
+{
+  return loginEmail[0] && (accessToken[0] == '\0' || (long)(millis() - tokenExpiresAt + SUPABASE_REFRESH_AHEAD) >= 0);
+}
+
+bool supabaseSessionValid()
+{
+  return accessToken[0] && (long)(millis() - tokenExpiresAt) < (long)SUPABASE_TOKEN_MARGIN;
+}
+
+uint32_t supabaseSessionToken(char *out, size_t size)
+{
+  copyString(out, size, accessToken, strlen(accessToken));
+  return sessionGeneration;
+}
+
+bool supabaseSessionRefresh()
+{
+  // A warm reboot or an hourly refresh costs one small request and never sends the password
+  bool ok;
+  if (refreshToken[0] && refreshSession())
+  {
+    ok = true;
+  }
+  else if (refreshToken[0])
+  {
+    ok = false; // No answer, rate limited or a server error; the token is tried again rather than the password
+  }
+  else
+  {
+    ok = passwordLogin();
+  }
+  if (!ok)
+  {
+    stats.authFailures++;
+    nextInlineRefresh = millis() + SUPABASE_TOKEN_MARGIN;
+  }
+  return ok;
+}
+
+SupabaseConnectionStats supabaseConnectionStats()
+{
+  return stats;
+}
@@ -0,0 +1,72 @@
+#ifndef SUPABASE_CONNECTION_H
+#define SUPABASE_CONNECTION_H
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+
+struct SupabaseConnectionStats
+{
+  uint32_t requests;
+  uint32_t handshakes;       // TLS connections opened
+  uint32_t reused;           // requests sent over an already open connection
+  uint32_t failures;         // requests that got no HTTP response
+  uint32_t lastHandshakeMs;
+  uint32_t lastLatencyMs;    // request written to response fully read
+  uint32_t maxLatencyMs;
+  uint32_t totalLatencyMs;   // divide by requests - failures for the mean
+  uint32_t passwordLogins;
+  uint32_t tokenRefreshes;   // sessions renewed with the refresh token, warm reboots included
+  uint32_t authFailures;
+};
+
+#define SUPABASE_RESPONSE_BYTES 6144
+#define SUPABASE_TOKEN_BYTES 1536 // Access token (a JWT) plus its NUL
+
+// Response body in a fixed buffer; anything past the capacity is read off the socket and dropped
+struct SupabaseResponse
+{
+  char data[SUPABASE_RESPONSE_BYTES + 1]; // always NUL terminated
+  size_t length;
+  bool truncated;
+};
+
+void supabaseConnectionBegin(const char *url, const char *apiKey);
+const char *supabaseHost();
+const char *supabaseApiKey();
+
+// Keeps the credentials and loads the refresh token the last session cached in NVS. Sends
+// nothing; returns true when a cached session was found
+bool supabaseSessionBegin(const char *email, const char *password);
+// True when there is no access token yet or it is due for a refresh
+bool supabaseSessionDue();
+bool supabaseSessionValid();
+// Renews the session with the cached refresh token, or logs in with the password when there is
+// none or it was rejected; the new refresh token is written to NVS. Caller holds xSupabaseMutex
+bool supabaseSessionRefresh();
+// Copies the current access token, for connections made outside supabaseRequest(). The caller
+// holds xSupabaseMutex. Returns a generation number that changes with every new token
+uint32_t supabaseSessionToken(char *out, size_t size);
+
+// Sends one request over the kept-alive connection, opening it first if needed.
+// path starts at the API root, e.g. "/rest/v1/sensor_data?select=name"; body may be NULL.
+// Returns the HTTP status code, or -1 when no response was received.
+int supabaseRequest(const char *method, const char *path, const char *body, const char *prefer, SupabaseResponse *response);
+
+// Streamed variant for reads that parse the body as it arrives instead of buffering it:
+//   if (supabaseStreamBegin("GET", path, NULL, NULL) == 200) { deserializeJson(doc, supabaseStreamBody()); }
+//   supabaseStreamEnd();
+// Every begin needs its end, which reads off whatever the parser left so the connection can be
+// reused. The caller holds xSupabaseMutex throughout
+int supabaseStreamBegin(const char *method, const char *path, const char *body, const char *prefer);
+Stream &supabaseStreamBody();
+void supabaseStreamEnd();
+
+// Shared response buffer for callers holding xSupabaseMutex; valid until the next request
+SupabaseResponse &supabaseResponse();
+
+// Writes value as a quoted, escaped JSON string; returns the length, or 0 if it does not fit
+size_t supabaseJsonString(char *out, size_t size, const char *value);
+
+SupabaseConnectionStats supabaseConnectionStats();
+
+#endif
@@ -0,0 +1,166 @@
+#include "taskMonitor.h"
+#include <esp_task_wdt.h>
+#include "../latencyHistogram/latencyHistogram.h"
+#include "../logger/logger.h"
+
+#define TASK_MONITOR_MS 100
+#define TASK_MONITOR_STACK 2048
+#define TASK_MONITOR_PRIORITY 4 // Above every monitored task, so a busy core cannot hide a stall
+
+struct MonitoredTask
+{
+  TaskMonitorStats stats;
+  LatencyHistogram lateness; // How far past its period each check-in came
+  uint32_t lastCheckIn;      // micros()
+  bool stalled;
+};
+
+static MonitoredTask tasks[TASK_MONITOR_MAX_TASKS];
+static volatile int taskCount = 0;
+static portMUX_TYPE monitorMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void monitorTask(void *pvParameters)
+{
+  while (true)
+  {
+    vTaskDelay(TASK_MONITOR_MS / portTICK_PERIOD_MS);
+    uint32_t now = micros();
+    for (int i = 0; i < taskCount; i++)
+    {
+      MonitoredTask &task = tasks[i];
+      portENTER_CRITICAL(&monitorMux);
+      uint32_t silent = now - task.lastCheckIn;
+      bool missed = !task.stalled && silent > task.stats.deadlineMs * 1000;
+      if (missed)
+      {
+        task.stalled = true;
+        task.stats.stalls++;
+      }
+      portEXIT_CRITICAL(&monitorMux);
+
+      if (missed && task.stats.critical)
+      {
+        LOG_ERROR(LOG_MAIN, "%s missed its %u ms deadline; reset in %u s", task.stats.name, task.stats.deadlineMs,
+                  TASK_WATCHDOG_TIMEOUT_S);
+      }
+      else if (missed)
+      {
+        LOG_WARN(LOG_MAIN, "%s missed its %u ms deadline", task.stats.name, task.stats.deadlineMs);
+      }
+
+      // Only a critical task that stays stuck resets the device. Straight to the console,
+      // since the logger task may be the one that is stuck
+      if (task.stats.critical && silent > (task.stats.deadlineMs + TASK_WATCHDOG_TIMEOUT_S * 1000) * 1000)
+      {
+        Serial.printf("%s stuck for %u s past its deadline, restarting\n", task.stats.name, TASK_WATCHDOG_TIMEOUT_S);
+        Serial.flush();
+        esp_restart();
+      }
+    }
+  }
+}
+
+bool taskMonitorBegin()
+{
+  // Already set up by the Arduino core for the idle tasks. The panic flag would apply to every
+  // subscribed task, idle tasks included, so the watchdog only reports and the monitor resets
+  // the device for critical tasks
+  esp_task_wdt_init(TASK_WATCHDOG_TIMEOUT_S, false);
+  if (xTaskCreatePinnedToCore(monitorTask, "Monitor", TASK_MONITOR_STACK, NULL, TASK_MONITOR_PRIORITY, NULL,
+                              TASK_CORE_NETWORK) != pdPASS)
+  {
+    Serial.println("Failed to create Monitor task");
+    return false;
+  }
+  return true;
+}
+
+int taskMonitorRegister(const char *name, uint32_t periodMs, uint32_t deadlineMs, bool critical)
+{
+  portENTER_CRITICAL(&monitorMux);
+  int id = taskCount < TASK_MONITOR_MAX_TASKS ? taskCount : -1;
+  if (id >= 0)
+  {
+    MonitoredTask &task = tasks[id];
+    memset(&task.stats, 0, sizeof(task.stats));
+    task.stats.name = name;
+    task.stats.periodMs = periodMs;
+    task.stats.deadlineMs = deadlineMs;
+    task.stats.critical = critical;
+    latencyHistogramInit(task.lateness, name);
+    task.lastCheckIn = micros();
+    task.stalled = false;
+    taskCount = id + 1;
+  }
+  portEXIT_CRITICAL(&monitorMux);
+
+  if (id < 0)
+  {
+    Serial.printf("Task monitor full, %s is not watched\n", name);
+  }
+  else if (critical)
+  {
+    esp_task_wdt_add(NULL);
+  }
+  return id;
+}
+
+void taskMonitorCheckIn(int id)
+{
+  if (id < 0)
+  {
+    return;
+  }
+  MonitoredTask &task = tasks[id];
+  uint32_t now = micros();
+
+  portENTER_CRITICAL(&monitorMux);
+  uint32_t interval = now - task.lastCheckIn;
+  uint32_t period = task.stats.periodMs * 1000;
+  uint32_t late = interval > period ? interval - period : 0;
+  latencyHistogramRecord(task.lateness, late);
+  if (late > task.stats.maxLateMicros)
+  {
+    task.stats.maxLateMicros = late;
+  }
+  if (interval > task.stats.deadlineMs * 1000)
+  {
+    task.stats.overruns++;
+  }
+  task.stats.passes++;
+  task.lastCheckIn = now;
+  task.stalled = false;
+  portEXIT_CRITICAL(&monitorMux);
+
+  if (task.stats.critical)
+  {
+    esp_task_wdt_reset();
+  }
+}
+
+int taskMonitorCount()
+{
+  return taskCount;
+}
+
+TaskMonitorStats taskMonitorStats(int id)
+{
+  portENTER_CRITICAL(&monitorMux);
+  TaskMonitorStats copy = tasks[id].stats;
+  portEXIT_CRITICAL(&monitorMux);
+  return copy;
+}
+
+void taskMonitorPrint(Print &out)
+{
+  for (int i = 0; i < taskCount; i++)
+  {
+    portENTER_CRITICAL(&monitorMux);
+    TaskMonitorStats s = tasks[i].stats;
+    LatencyHistogram lateness = tasks[i].lateness;
+    portEXIT_CRITICAL(&monitorMux);
+    out.printf("%s%s: %u passes (period %u ms, deadline %u ms), late p99<=%u us max %u us, %u overruns, %u stalls\n",
+               s.name, s.critical ? " (critical)" : "", s.passes, s.periodMs, s.deadlineMs,
+               latencyHistogramPercentile(lateness, 99), s.maxLateMicros, s.overruns, s.stalls);
+  }
+}
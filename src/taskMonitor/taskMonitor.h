@@ -0,0 +1,47 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+
+// Core 0 also runs the WiFi and lwIP tasks, so everything that talks TLS is pinned there;
+// core 1 keeps the sensors, keypad, RFID, display and buzzer clear of handshakes
+#ifndef TASK_CORE_NETWORK
+#define TASK_CORE_NETWORK 0
+#endif
+#ifndef TASK_CORE_IO
+#define TASK_CORE_IO 1
+#endif
+
+#define TASK_MONITOR_MAX_TASKS 8
+#define TASK_WATCHDOG_TIMEOUT_S 5 // A critical task this long past its deadline resets the device
+
+struct TaskMonitorStats
+{
+  const char *name;
+  uint32_t periodMs;
+  uint32_t deadlineMs;
+  bool critical;
+  uint32_t passes;
+  uint32_t overruns; // Passes that started more than deadlineMs after the previous one
+  uint32_t stalls;   // Times the monitor saw the deadline pass with no check-in
+  uint32_t maxLateMicros;
+};
+
+// Starts the monitor task and sets the task watchdog timeout; the watchdog reports stalls,
+// and the monitor restarts the device when a critical task stays stuck
+bool taskMonitorBegin();
+
+// Called by a task before its loop. periodMs is how often it expects to pass its check-in,
+// deadlineMs how long a pass may take before it counts as overrun. Critical tasks are also
+// subscribed to the task watchdog, and only they can reset the device. Returns the id for
+// taskMonitorCheckIn(), or -1
+int taskMonitorRegister(const char *name, uint32_t periodMs, uint32_t deadlineMs, bool critical);
+
+// Once per pass of the task's loop; records jitter and feeds the watchdog
+void taskMonitorCheckIn(int id);
+
+int taskMonitorCount();
+TaskMonitorStats taskMonitorStats(int id);
+void taskMonitorPrint(Print &out);
+
+#endif
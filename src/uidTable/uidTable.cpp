@@ -0,0 +1,161 @@
+#include "uidTable.h"
+#include <string.h>
+
+#define UID_TABLE_MASK (UID_TABLE_SLOTS - 1)
+
+// FNV-1a; card UIDs are close to random already, this only spreads them over the slots
+static uint32_t uidHash(const uint8_t *uid, uint8_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (uint8_t i = 0; i < length; i++)
+  {
+    hash = (hash ^ uid[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static bool slotMatches(const UidSlot &slot, const uint8_t *uid, uint8_t length)
+{
+  return slot.length == length && memcmp(slot.uid, uid, length) == 0;
+}
+
+// Slot holding the UID, or the empty slot that ends its probe sequence
+static uint32_t findSlot(const UidTable &table, const uint8_t *uid, uint8_t length)
+{
+  uint32_t i = uidHash(uid, length) & UID_TABLE_MASK;
+  while (table.slots[i].length != 0 && !slotMatches(table.slots[i], uid, length))
+  {
+    i = (i + 1) & UID_TABLE_MASK;
+  }
+  return i;
+}
+
+void uidTableClear(UidTable &table)
+{
+  memset(&table, 0, sizeof(table));
+}
+
+bool uidTableContains(const UidTable &table, const uint8_t *uid, uint8_t length)
+{
+  if (length == 0 || length > UID_MAX_LENGTH)
+  {
+    return false;
+  }
+  return table.slots[findSlot(table, uid, length)].length != 0;
+}
+
+bool uidTableInsert(UidTable &table, const uint8_t *uid, uint8_t length)
+{
+  if (length == 0 || length > UID_MAX_LENGTH)
+  {
+    return false;
+  }
+  uint32_t i = findSlot(table, uid, length);
+  if (table.slots[i].length != 0)
+  {
+    return true;
+  }
+  if (table.count >= UID_TABLE_MAX_ENTRIES)
+  {
+    return false;
+  }
+  table.slots[i].length = length;
+  memcpy(table.slots[i].uid, uid, length);
+  table.count++;
+  return true;
+}
+
+bool uidTableRemove(UidTable &table, const uint8_t *uid, uint8_t length)
+{
+  if (length == 0 || length > UID_MAX_LENGTH)
+  {
+    return false;
+  }
+  uint32_t hole = findSlot(table, uid, length);
+  if (table.slots[hole].length == 0)
+  {
+    return false;
+  }
+
+  // Backward shift: move later entries of the cluster into the hole unless that would put
+  // them before their home slot
+  uint32_t i = hole;
+  while (true)
+  {
+    i = (i + 1) & UID_TABLE_MASK;
+    const UidSlot &slot = table.slots[i];
+    if (slot.length == 0)
+    {
+      break;
+    }
+    uint32_t home = uidHash(slot.uid, slot.length) & UID_TABLE_MASK;
+    bool movable = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+    if (movable)
+    {
+      table.slots[hole] = slot;
+      hole = i;
+    }
+  }
+  table.slots[hole].length = 0;
+  table.count--;
+  return true;
+}
+
+int uidTableNext(const UidTable &table, int slot)
+{
+  for (int i = slot < 0 ? 0 : slot; i < UID_TABLE_SLOTS; i++)
+  {
+    if (table.slots[i].length != 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int hexDigit(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool uidParseHex(const char *hex, uint8_t *uid, uint8_t &length)
+{
+  length = 0;
+  int high = -1;
+  for (const char *c = hex; *c; c++)
+  {
+    if (*c == ' ' || *c == ':')
+    {
+      continue;
+    }
+    int digit = hexDigit(*c);
+    if (digit < 0)
+    {
+      return false;
+    }
+    if (high < 0)
+    {
+      high = digit;
+      continue;
+    }
+    if (length >= UID_MAX_LENGTH)
+    {
+      return false;
+    }
+    uid[length++] = (high << 4) | digit;
+    high = -1;
+  }
+  return high < 0 && length > 0;
+}
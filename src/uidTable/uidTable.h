@@ -0,0 +1,38 @@
+#ifndef UID_TABLE_H
+#define UID_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UID_MAX_LENGTH 10        // ISO 14443 UIDs are 4, 7 or 10 bytes
+#define UID_TABLE_SLOTS 2048     // Power of two
+#define UID_TABLE_MAX_ENTRIES 1536 // 3/4 load keeps linear probes short
+
+// A slot with length 0 is empty
+struct UidSlot
+{
+  uint8_t length;
+  uint8_t uid[UID_MAX_LENGTH];
+};
+
+// Open addressing with linear probing. Removal shifts the following entries back instead
+// of leaving tombstones, so lookups never slow down as cards come and go
+struct UidTable
+{
+  UidSlot slots[UID_TABLE_SLOTS];
+  uint16_t count;
+};
+
+void uidTableClear(UidTable &table);
+bool uidTableContains(const UidTable &table, const uint8_t *uid, uint8_t length);
+// Returns false when the table is full or the UID is too long; inserting a present UID is a no-op
+bool uidTableInsert(UidTable &table, const uint8_t *uid, uint8_t length);
+bool uidTableRemove(UidTable &table, const uint8_t *uid, uint8_t length);
+
+// Index of the first occupied slot at or after slot, or -1
+int uidTableNext(const UidTable &table, int slot);
+
+// Parses hex such as "7A 77 C7 B2" or "7a77c7b2"; returns false on bad digits or length
+bool uidParseHex(const char *hex, uint8_t *uid, uint8_t &length);
+
+#endif
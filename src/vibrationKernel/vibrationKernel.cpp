@@ -0,0 +1,106 @@
+#include "vibrationKernel.h"
+#include <string.h>
+
+uint32_t vibrationIsqrt(uint64_t value)
+{
+  // Bit-by-bit integer square root, no floating point
+  uint64_t result = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit)
+  {
+    if (value >= result + bit)
+    {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    }
+    else
+    {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)result;
+}
+
+void vibrationBlockFeatures(const uint16_t *samples, size_t count, VibrationFeatures &out)
+{
+  uint32_t peak = 0;
+  uint64_t energy = 0;
+  size_t i = 0;
+
+  // Squares of 12-bit samples are below 2^24, so 64 of them fit a 32-bit partial sum.
+  // The inner loop is unrolled by four; Xtensa LX6 has no SIMD, but this keeps the
+  // multiply-accumulate and MAXU units busy and lets SIMD targets vectorize it.
+  while (i < count)
+  {
+    size_t end = count - i > 64 ? i + 64 : count;
+    uint32_t partial = 0;
+    for (; i + 4 <= end; i += 4)
+    {
+      uint32_t s0 = samples[i] & VIBRATION_SAMPLE_MASK;
+      uint32_t s1 = samples[i + 1] & VIBRATION_SAMPLE_MASK;
+      uint32_t s2 = samples[i + 2] & VIBRATION_SAMPLE_MASK;
+      uint32_t s3 = samples[i + 3] & VIBRATION_SAMPLE_MASK;
+      partial += s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+      uint32_t m01 = s0 > s1 ? s0 : s1;
+      uint32_t m23 = s2 > s3 ? s2 : s3;
+      uint32_t m = m01 > m23 ? m01 : m23;
+      peak = m > peak ? m : peak;
+    }
+    for (; i < end; i++)
+    {
+      uint32_t s = samples[i] & VIBRATION_SAMPLE_MASK;
+      partial += s * s;
+      peak = s > peak ? s : peak;
+    }
+    energy += partial;
+  }
+
+  out.peak = peak;
+  out.energy = energy;
+  out.samples = count;
+  out.rms = count ? vibrationIsqrt(energy / count) : 0;
+}
+
+void vibrationDetectorInit(VibrationDetector &detector, const VibrationThresholds &thresholds)
+{
+  memset(&detector, 0, sizeof(detector));
+  detector.thresholds = thresholds;
+}
+
+bool vibrationDetectorUpdate(VibrationDetector &detector, const uint16_t *samples, size_t count)
+{
+  vibrationBlockFeatures(samples, count, detector.block);
+
+  detector.blockEnergy[detector.next] = detector.block.energy;
+  detector.blockPeak[detector.next] = detector.block.peak;
+  detector.blockSamples[detector.next] = detector.block.samples;
+  detector.next = (detector.next + 1) % VIBRATION_WINDOW_BLOCKS;
+
+  VibrationFeatures &window = detector.window;
+  window.peak = 0;
+  window.energy = 0;
+  window.samples = 0;
+  for (int b = 0; b < VIBRATION_WINDOW_BLOCKS; b++)
+  {
+    window.energy += detector.blockEnergy[b];
+    window.samples += detector.blockSamples[b];
+    window.peak = detector.blockPeak[b] > window.peak ? detector.blockPeak[b] : window.peak;
+  }
+  window.rms = window.samples ? vibrationIsqrt(window.energy / window.samples) : 0;
+
+  // A single noisy sample raises the peak but not the RMS, so both must cross to start a hit
+  if (!detector.hit)
+  {
+    detector.hit = window.peak >= detector.thresholds.peakOn && window.rms >= detector.thresholds.rmsOn;
+  }
+  else if (window.peak < detector.thresholds.peakOff)
+  {
+    detector.hit = false;
+  }
+  return detector.hit;
+}
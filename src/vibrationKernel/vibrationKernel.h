@@ -0,0 +1,46 @@
+#ifndef VIBRATION_KERNEL_H
+#define VIBRATION_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VIBRATION_WINDOW_BLOCKS 8  // Blocks in the sliding analysis window
+#define VIBRATION_SAMPLE_MASK 0x0FFF // 12-bit ADC value; the I2S ADC puts the channel in the top bits
+
+struct VibrationFeatures
+{
+  uint16_t peak;   // largest sample
+  uint16_t rms;    // root mean square of the samples
+  uint64_t energy; // sum of squared samples
+  uint32_t samples;
+};
+
+// A hit starts when the window has both a peak of at least peakOn and an RMS of at least rmsOn,
+// and ends when the window peak falls below peakOff
+struct VibrationThresholds
+{
+  uint16_t peakOn;
+  uint16_t peakOff;
+  uint16_t rmsOn;
+};
+
+struct VibrationDetector
+{
+  VibrationThresholds thresholds;
+  uint64_t blockEnergy[VIBRATION_WINDOW_BLOCKS];
+  uint16_t blockPeak[VIBRATION_WINDOW_BLOCKS];
+  uint32_t blockSamples[VIBRATION_WINDOW_BLOCKS];
+  uint8_t next;
+  bool hit;
+  VibrationFeatures block;  // features of the last block
+  VibrationFeatures window; // features of the whole window
+};
+
+uint32_t vibrationIsqrt(uint64_t value);
+void vibrationBlockFeatures(const uint16_t *samples, size_t count, VibrationFeatures &out);
+
+void vibrationDetectorInit(VibrationDetector &detector, const VibrationThresholds &thresholds);
+// Adds one block to the window; returns true while a hit is in progress
+bool vibrationDetectorUpdate(VibrationDetector &detector, const uint16_t *samples, size_t count);
+
+#endif
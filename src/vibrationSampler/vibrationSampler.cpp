@@ -0,0 +1,120 @@
+#include "vibrationSampler.h"
+#include <driver/i2s.h>
+#include <driver/adc.h>
+#include "../taskMonitor/taskMonitor.h"
+
+#define VIBRATION_I2S_PORT I2S_NUM_0
+#define VIBRATION_SAMPLE_RATE 8000    // Hz
+#define VIBRATION_BLOCK_SAMPLES 256   // 32 ms per block; the window spans 8 blocks
+#define VIBRATION_DMA_BUFFERS 2       // Double buffer: one fills while the other is analysed
+#define VIBRATION_TASK_STACK 4096
+#define VIBRATION_TASK_PRIORITY 2
+#define VIBRATION_DEADLINE_MS 250 // Eight blocks; the door alarm depends on this task, so a stall resets the device
+
+static bool running = false;
+static VibrationDetector detector;
+static uint16_t block[VIBRATION_BLOCK_SAMPLES];
+static VibrationSamplerStats stats;
+static volatile bool hit = false;
+static portMUX_TYPE samplerMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void vibrationTask(void *pvParameters)
+{
+  int monitorId = taskMonitorRegister("Vibration", VIBRATION_BLOCK_SAMPLES * 1000 / VIBRATION_SAMPLE_RATE,
+                                      VIBRATION_DEADLINE_MS, true);
+  while (true)
+  {
+    taskMonitorCheckIn(monitorId);
+    size_t bytesRead = 0;
+    i2s_read(VIBRATION_I2S_PORT, block, sizeof(block), &bytesRead, portMAX_DELAY);
+    size_t count = bytesRead / sizeof(block[0]);
+    if (count == 0)
+    {
+      continue;
+    }
+
+    unsigned long start = micros();
+    bool wasHit = detector.hit;
+    bool isHit = vibrationDetectorUpdate(detector, block, count);
+    uint32_t elapsed = micros() - start;
+
+    portENTER_CRITICAL(&samplerMux);
+    hit = isHit;
+    stats.blocks++;
+    if (isHit && !wasHit)
+    {
+      stats.hits++;
+    }
+    if (count < VIBRATION_BLOCK_SAMPLES)
+    {
+      stats.shortReads++;
+    }
+    if (elapsed > stats.maxKernelMicros)
+    {
+      stats.maxKernelMicros = elapsed;
+    }
+    stats.last = detector.window;
+    portEXIT_CRITICAL(&samplerMux);
+  }
+}
+
+bool vibrationSamplerBegin(int pin, const VibrationThresholds &thresholds)
+{
+  // The I2S peripheral can only sample ADC1 channels
+  int8_t channel = digitalPinToAnalogChannel(pin);
+  if (channel < 0 || channel >= ADC1_CHANNEL_MAX)
+  {
+    Serial.println("Vibration pin is not on ADC1, using analogRead");
+    return false;
+  }
+
+  i2s_config_t config = {};
+  config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+  config.sample_rate = VIBRATION_SAMPLE_RATE;
+  config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+  config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+  config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+  config.dma_buf_count = VIBRATION_DMA_BUFFERS;
+  config.dma_buf_len = VIBRATION_BLOCK_SAMPLES;
+
+  if (i2s_driver_install(VIBRATION_I2S_PORT, &config, 0, NULL) != ESP_OK)
+  {
+    Serial.println("Failed to install I2S ADC driver, using analogRead");
+    return false;
+  }
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  adc1_config_channel_atten((adc1_channel_t)channel, ADC_ATTEN_DB_11);
+  i2s_set_adc_mode(ADC_UNIT_1, (adc1_channel_t)channel);
+  i2s_adc_enable(VIBRATION_I2S_PORT);
+
+  vibrationDetectorInit(detector, thresholds);
+  if (xTaskCreatePinnedToCore(vibrationTask, "Vibration", VIBRATION_TASK_STACK, NULL, VIBRATION_TASK_PRIORITY, NULL,
+                              TASK_CORE_IO) != pdPASS)
+  {
+    Serial.println("Failed to create Vibration task");
+    i2s_adc_disable(VIBRATION_I2S_PORT);
+    i2s_driver_uninstall(VIBRATION_I2S_PORT);
+    return false;
+  }
+
+  running = true;
+  return true;
+}
+
+bool vibrationSamplerRunning()
+{
+  return running;
+}
+
+bool vibrationSamplerHit()
+{
+  return hit;
+}
+
+VibrationSamplerStats vibrationSamplerStats()
+{
+  portENTER_CRITICAL(&samplerMux);
+  VibrationSamplerStats copy = stats;
+  portEXIT_CRITICAL(&samplerMux);
+  return copy;
+}
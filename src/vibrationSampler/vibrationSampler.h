@@ -0,0 +1,25 @@
+#ifndef VIBRATION_SAMPLER_H
+#define VIBRATION_SAMPLER_H
+
+#include <Arduino.h>
+#include "../vibrationKernel/vibrationKernel.h"
+
+struct VibrationSamplerStats
+{
+  uint32_t blocks;       // blocks analysed
+  uint32_t hits;         // hit events raised
+  uint32_t shortReads;   // DMA reads that returned less than a full block
+  uint32_t maxKernelMicros;
+  VibrationFeatures last; // window features after the last block
+};
+
+// Starts continuous ADC sampling of an ADC1 pin through I2S DMA and a task that analyses each block.
+// Returns false when the driver could not be installed; callers then fall back to analogRead().
+bool vibrationSamplerBegin(int pin, const VibrationThresholds &thresholds);
+bool vibrationSamplerRunning();
+
+// Latest detector state, safe to call from any task
+bool vibrationSamplerHit();
+VibrationSamplerStats vibrationSamplerStats();
+
+#endif
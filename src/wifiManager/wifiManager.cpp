@@ -0,0 +1,423 @@
+#include "wifiManager.h"
+#include <Preferences.h>
+#include <limits.h>
+#include <time.h>
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+#include <lwip/dhcp.h>
+#include "../logger/logger.h"
+#include "../taskMonitor/taskMonitor.h"
+
+#define WIFI_NVS_NAMESPACE "wifi"
+#define WIFI_TASK_STACK 3072
+#define WIFI_TASK_PRIORITY 2
+#define WIFI_ATTEMPT_TIMEOUT_MS 10000
+#define WIFI_CACHED_ATTEMPTS 2     // Attempts with the cached BSSID and channel before falling back to a scan
+#define WIFI_LEASE_MARGIN_S 60     // A cached address is dropped this long before the lease's renewal time
+#define WIFI_LEASE_CHECK_MS 10000  // While up on a reused address, or with the lease not yet stamped
+#define WIFI_CLOCK_VALID 1700000000 // SNTP has set the wall clock once it is past this
+#define WIFI_BACKOFF_MIN_MS 1000
+#define WIFI_BACKOFF_MAX_MS 60000
+#define WIFI_EVENT_GOT_IP 0x01
+#define WIFI_EVENT_DISCONNECTED 0x02
+
+// What the last good connection used; stored as one blob so it is read and written whole
+struct WifiCache
+{
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t leaseSeconds; // 0 when the address must not be reused
+  uint32_t acquiredAt;   // Wall clock when the lease was granted; 0 until SNTP has set the clock
+};
+
+enum WifiState
+{
+  WIFI_STATE_CONNECTING,
+  WIFI_STATE_UP,
+  WIFI_STATE_BACKOFF
+};
+
+static const char *networkSsid;
+static const char *networkPassword;
+static WifiCache cache;
+static bool cacheValid = false;
+
+static TaskHandle_t wifiTask = NULL;
+static WifiState state = WIFI_STATE_CONNECTING;
+static bool attemptCached = false;
+static bool attemptStatic = false; // This attempt reuses the cached address instead of asking DHCP
+static bool leaseTimed = false;    // leaseAtMs holds when the cached lease was granted, by millis()
+static unsigned long leaseAtMs = 0;
+static int failuresSinceUp = 0;
+static uint32_t backoffMs = 0;
+static unsigned long attemptStart = 0;
+static unsigned long nextAttempt = 0;
+static unsigned long downSince = 0; // When the link was lost, or wifiManagerBegin() for the first connection
+static bool everConnected = false;
+
+static WifiLinkCallback listeners[WIFI_MAX_LISTENERS];
+static int listenerCount = 0;
+static WifiManagerStats stats;
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void loadCache()
+{
+  Preferences prefs;
+  if (!prefs.begin(WIFI_NVS_NAMESPACE, true))
+  {
+    return;
+  }
+  cacheValid = prefs.getBytes("link", &cache, sizeof(cache)) == sizeof(cache) &&
+               strncmp(cache.ssid, networkSsid, sizeof(cache.ssid)) == 0 && cache.channel != 0;
+  prefs.end();
+}
+
+static bool writeCache(const WifiCache &current)
+{
+  Preferences prefs;
+  if (!prefs.begin(WIFI_NVS_NAMESPACE, false))
+  {
+    LOG_ERROR(LOG_NETWORK, "Failed to open WiFi cache in NVS");
+    return false;
+  }
+  bool ok = prefs.putBytes("link", &current, sizeof(current)) == sizeof(current);
+  prefs.end();
+  if (ok)
+  {
+    cache = current;
+    cacheValid = true;
+    portENTER_CRITICAL(&statsMux);
+    stats.cacheSaves++;
+    portEXIT_CRITICAL(&statsMux);
+  }
+  return ok;
+}
+
+// Lease time lwIP's DHCP client was granted; 0 when it holds no lease
+static uint32_t dhcpLeaseSeconds()
+{
+  esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  struct netif *lwip = netif != NULL ? (struct netif *)esp_netif_get_netif_impl(netif) : NULL;
+  struct dhcp *dhcp = lwip != NULL ? netif_dhcp_data(lwip) : NULL;
+  return dhcp != NULL && dhcp->state == DHCP_STATE_BOUND ? dhcp->offered_t0_lease : 0;
+}
+
+// Seconds since the cached lease was granted; false when that cannot be known, e.g. after a power cut
+static bool leaseAge(uint32_t &age)
+{
+  if (leaseTimed)
+  {
+    age = (millis() - leaseAtMs) / 1000;
+    return true;
+  }
+  time_t now = time(NULL);
+  if (cache.acquiredAt == 0 || now < WIFI_CLOCK_VALID || now < (time_t)cache.acquiredAt)
+  {
+    return false;
+  }
+  age = now - cache.acquiredAt;
+  return true;
+}
+
+// A DHCP client renews at half the lease, so the address is only reused up to then
+static bool leaseUsable()
+{
+  uint32_t age;
+  return cacheValid && cache.leaseSeconds > 0 && leaseAge(age) && age + WIFI_LEASE_MARGIN_S < cache.leaseSeconds / 2;
+}
+
+// Records a lease just granted by DHCP, with the link it came over
+static void saveCache()
+{
+  WifiCache current = {};
+  strncpy(current.ssid, networkSsid, sizeof(current.ssid) - 1);
+  const uint8_t *bssid = WiFi.BSSID();
+  if (bssid != NULL)
+  {
+    memcpy(current.bssid, bssid, sizeof(current.bssid));
+  }
+  current.channel = WiFi.channel();
+  current.ip = WiFi.localIP();
+  current.gateway = WiFi.gatewayIP();
+  current.subnet = WiFi.subnetMask();
+  current.dns = WiFi.dnsIP(0);
+  current.leaseSeconds = dhcpLeaseSeconds();
+  time_t now = time(NULL);
+  current.acquiredAt = now >= WIFI_CLOCK_VALID ? now : 0;
+  leaseTimed = true;
+  leaseAtMs = millis();
+  writeCache(current);
+}
+
+// The first lease usually comes before SNTP has set the clock; stamp it once the clock is known,
+// so the address can also be reused after a restart
+static void stampLease()
+{
+  time_t now = time(NULL);
+  if (!cacheValid || cache.acquiredAt != 0 || cache.leaseSeconds == 0 || !leaseTimed || now < WIFI_CLOCK_VALID)
+  {
+    return;
+  }
+  WifiCache stamped = cache;
+  stamped.acquiredAt = now - (millis() - leaseAtMs) / 1000;
+  writeCache(stamped);
+}
+
+static void onWifiEvent(arduino_event_id_t event, arduino_event_info_t info)
+{
+  // Runs in the Arduino event task; the WiFi task does the work
+  if (wifiTask == NULL)
+  {
+    return;
+  }
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+  {
+    xTaskNotify(wifiTask, WIFI_EVENT_GOT_IP, eSetBits);
+  }
+  else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED && info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE)
+  {
+    // ASSOC_LEAVE is our own WiFi.disconnect(); only a lost link or a failed attempt counts
+    xTaskNotify(wifiTask, WIFI_EVENT_DISCONNECTED, eSetBits);
+  }
+}
+
+static void notifyListeners(bool up)
+{
+  for (int i = 0; i < listenerCount; i++)
+  {
+    listeners[i](up);
+  }
+}
+
+static void startAttempt()
+{
+  attemptCached = cacheValid && failuresSinceUp < WIFI_CACHED_ATTEMPTS;
+  // Only the first try reuses the address; a failure may mean it has gone to another host
+  attemptStatic = attemptCached && failuresSinceUp == 0 && leaseUsable();
+  WiFi.disconnect();
+  if (attemptStatic)
+  {
+    // A lease still in its first half also skips DHCP
+    uint32_t age = 0;
+    leaseAge(age);
+    leaseTimed = true;
+    leaseAtMs = millis() - age * 1000;
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+  }
+  else
+  {
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+  }
+  if (attemptCached)
+  {
+    WiFi.begin(networkSsid, networkPassword, cache.channel, cache.bssid);
+  }
+  else
+  {
+    WiFi.begin(networkSsid, networkPassword);
+  }
+  state = WIFI_STATE_CONNECTING;
+  attemptStart = millis();
+  portENTER_CRITICAL(&statsMux);
+  stats.attempts++;
+  portEXIT_CRITICAL(&statsMux);
+}
+
+static void attemptFailed()
+{
+  failuresSinceUp++;
+  portENTER_CRITICAL(&statsMux);
+  stats.failedAttempts++;
+  portEXIT_CRITICAL(&statsMux);
+
+  // Exponential backoff with up to a quarter of jitter, so several devices do not retry in step
+  backoffMs = backoffMs == 0 ? WIFI_BACKOFF_MIN_MS : min(backoffMs * 2, (uint32_t)WIFI_BACKOFF_MAX_MS);
+  uint32_t wait = backoffMs + esp_random() % (backoffMs / 4 + 1);
+  LOG_WARN(LOG_NETWORK, "WiFi attempt %d failed (%s), retrying in %u ms", failuresSinceUp,
+           attemptStatic ? "cached address" : attemptCached ? "cached" : "scan", wait);
+  WiFi.disconnect();
+  state = WIFI_STATE_BACKOFF;
+  nextAttempt = millis() + wait;
+}
+
+static void linkUp()
+{
+  uint32_t elapsed = millis() - downSince;
+  portENTER_CRITICAL(&statsMux);
+  stats.connected = true;
+  if (!everConnected)
+  {
+    stats.bootConnectMs = elapsed;
+  }
+  else
+  {
+    stats.reconnects++;
+    stats.lastReconnectMs = elapsed;
+    if (elapsed > stats.maxReconnectMs)
+    {
+      stats.maxReconnectMs = elapsed;
+    }
+  }
+  if (attemptCached)
+  {
+    stats.cachedConnects++;
+  }
+  if (attemptStatic)
+  {
+    stats.leaseReuses++;
+  }
+  portEXIT_CRITICAL(&statsMux);
+
+  LOG_INFO(LOG_NETWORK, "WiFi up in %u ms (%s, channel %d)", elapsed,
+           attemptStatic ? "cached address" : attemptCached ? "cached" : "scan", WiFi.channel());
+  everConnected = true;
+  state = WIFI_STATE_UP;
+  failuresSinceUp = 0;
+  backoffMs = 0;
+  // A reused address is not a new lease; the cache keeps the one DHCP granted
+  if (!attemptStatic)
+  {
+    saveCache();
+  }
+  notifyListeners(true);
+}
+
+static void linkDown()
+{
+  portENTER_CRITICAL(&statsMux);
+  stats.connected = false;
+  portEXIT_CRITICAL(&statsMux);
+  downSince = millis();
+  notifyListeners(false);
+  // The AP is most likely still there, so the first retry is immediate and uses the cache
+  startAttempt();
+}
+
+// Nothing renews an address set with WiFi.config(), so at its renewal time the link is brought up
+// again through DHCP, on the cached channel
+static void checkLease()
+{
+  uint32_t age;
+  if (attemptStatic && (!leaseAge(age) || age + WIFI_LEASE_MARGIN_S >= cache.leaseSeconds / 2))
+  {
+    LOG_INFO(LOG_NETWORK, "WiFi lease due for renewal, reconnecting through DHCP");
+    linkDown();
+    return;
+  }
+  stampLease();
+}
+
+static void linkLost()
+{
+  LOG_WARN(LOG_NETWORK, "WiFi link lost");
+  linkDown();
+}
+
+static void wifiManagerTask(void *pvParameters)
+{
+  startAttempt();
+  while (true)
+  {
+    TickType_t wait = portMAX_DELAY;
+    long remaining = 0;
+    if (state == WIFI_STATE_CONNECTING)
+    {
+      remaining = WIFI_ATTEMPT_TIMEOUT_MS - (long)(millis() - attemptStart);
+    }
+    else if (state == WIFI_STATE_BACKOFF)
+    {
+      remaining = (long)(nextAttempt - millis());
+    }
+    if (state != WIFI_STATE_UP)
+    {
+      wait = remaining > 0 ? remaining / portTICK_PERIOD_MS : 0;
+    }
+    else if (attemptStatic || (cacheValid && cache.acquiredAt == 0 && cache.leaseSeconds > 0))
+    {
+      wait = WIFI_LEASE_CHECK_MS / portTICK_PERIOD_MS;
+    }
+
+    uint32_t events = 0;
+    xTaskNotifyWait(0, ULONG_MAX, &events, wait);
+
+    if (state == WIFI_STATE_UP && (events & WIFI_EVENT_DISCONNECTED))
+    {
+      linkLost();
+    }
+    else if (state == WIFI_STATE_UP)
+    {
+      checkLease();
+    }
+    else if (state == WIFI_STATE_CONNECTING && (events & WIFI_EVENT_GOT_IP))
+    {
+      linkUp();
+    }
+    else if (state == WIFI_STATE_CONNECTING &&
+             ((events & WIFI_EVENT_DISCONNECTED) || millis() - attemptStart >= WIFI_ATTEMPT_TIMEOUT_MS))
+    {
+      attemptFailed();
+    }
+    else if (state == WIFI_STATE_BACKOFF && (long)(millis() - nextAttempt) >= 0)
+    {
+      startAttempt();
+    }
+  }
+}
+
+bool wifiManagerBegin(const char *ssid, const char *password)
+{
+  networkSsid = ssid;
+  networkPassword = password;
+  loadCache();
+  downSince = millis();
+
+  // The manager decides when and how to reconnect, and keeps its own copy of the link settings
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.onEvent(onWifiEvent);
+
+  if (xTaskCreatePinnedToCore(wifiManagerTask, "WiFi", WIFI_TASK_STACK, NULL, WIFI_TASK_PRIORITY, &wifiTask,
+                              TASK_CORE_NETWORK) != pdPASS)
+  {
+    Serial.println("Failed to create WiFi task");
+    return false;
+  }
+  return true;
+}
+
+bool wifiManagerOnLink(WifiLinkCallback callback)
+{
+  if (listenerCount == WIFI_MAX_LISTENERS)
+  {
+    return false;
+  }
+  listeners[listenerCount++] = callback;
+  return true;
+}
+
+bool wifiManagerConnected()
+{
+  return stats.connected;
+}
+
+WifiManagerStats wifiManagerStats()
+{
+  portENTER_CRITICAL(&statsMux);
+  WifiManagerStats copy = stats;
+  portEXIT_CRITICAL(&statsMux);
+  return copy;
+}
+
+void wifiManagerPrintStats(Print &out)
+{
+  WifiManagerStats s = wifiManagerStats();
+  out.printf("WiFi: %s, boot connect %u ms, %u reconnects (last %u ms, max %u ms), %u attempts (%u failed), %u cached connects (%u reused a lease), %u cache saves\n",
+             s.connected ? "up" : "down", s.bootConnectMs, s.reconnects, s.lastReconnectMs, s.maxReconnectMs,
+             s.attempts, s.failedAttempts, s.cachedConnects, s.leaseReuses, s.cacheSaves);
+}
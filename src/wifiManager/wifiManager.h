@@ -0,0 +1,37 @@
+#ifndef WIFI_MANAGER_H
+#define WIFI_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define WIFI_MAX_LISTENERS 4
+
+struct WifiManagerStats
+{
+  bool connected;
+  uint32_t bootConnectMs;    // wifiManagerBegin() to the first address; 0 until then
+  uint32_t lastReconnectMs;  // Link loss to address, backoff included
+  uint32_t maxReconnectMs;
+  uint32_t reconnects;
+  uint32_t attempts;
+  uint32_t failedAttempts;
+  uint32_t cachedConnects;   // Connections that skipped the scan using the NVS cache
+  uint32_t leaseReuses;      // Of those, connections that also skipped DHCP with a lease still in its first half
+  uint32_t cacheSaves;
+};
+
+// Called from the WiFi task whenever the link goes up (with an address) or down.
+// Register listeners before wifiManagerBegin()
+typedef void (*WifiLinkCallback)(bool up);
+
+// Starts connecting in the background and returns at once. The first attempts use the BSSID and
+// channel cached in NVS by the last connection, if there is one. The first also reuses its DHCP
+// address while the lease is known to be in its first half, and renews it through DHCP after that
+bool wifiManagerBegin(const char *ssid, const char *password);
+bool wifiManagerOnLink(WifiLinkCallback callback);
+bool wifiManagerConnected();
+
+WifiManagerStats wifiManagerStats();
+void wifiManagerPrintStats(Print &out);
+
+#endif
@@ -0,0 +1,74 @@
+#include "wsFrame.h"
+#include <string.h>
+
+size_t wsFrameEncodeHeader(uint8_t *out, uint8_t opcode, uint64_t length, const uint8_t mask[4])
+{
+  size_t size = 0;
+  out[size++] = 0x80 | opcode;
+  if (length < 126)
+  {
+    out[size++] = 0x80 | length;
+  }
+  else if (length <= 0xFFFF)
+  {
+    out[size++] = 0x80 | 126;
+    out[size++] = length >> 8;
+    out[size++] = length & 0xFF;
+  }
+  else
+  {
+    out[size++] = 0x80 | 127;
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+      out[size++] = length >> shift & 0xFF;
+    }
+  }
+  memcpy(&out[size], mask, 4);
+  return size + 4;
+}
+
+void wsFrameMask(uint8_t *data, size_t length, const uint8_t mask[4])
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    data[i] ^= mask[i & 3];
+  }
+}
+
+size_t wsFrameHeaderBytes(const uint8_t head[2])
+{
+  uint8_t length = head[1] & 0x7F;
+  size_t size = 2 + (length == 126 ? 2 : length == 127 ? 8 : 0);
+  return head[1] & 0x80 ? size + 4 : size;
+}
+
+void wsFrameDecodeHeader(const uint8_t *bytes, WsFrameHeader &out)
+{
+  out.fin = bytes[0] & 0x80;
+  out.opcode = bytes[0] & 0x0F;
+  out.masked = bytes[1] & 0x80;
+  out.length = bytes[1] & 0x7F;
+  size_t size = 2;
+  if (out.length >= 126)
+  {
+    size_t extended = out.length == 126 ? 2 : 8;
+    out.length = 0;
+    for (size_t i = 0; i < extended; i++)
+    {
+      out.length = out.length << 8 | bytes[size++];
+    }
+  }
+  if (out.masked)
+  {
+    memcpy(out.mask, &bytes[size], 4);
+  }
+  else
+  {
+    memset(out.mask, 0, 4);
+  }
+}
+
+uint16_t wsFrameCloseCode(const uint8_t *payload, size_t length)
+{
+  return length >= 2 ? payload[0] << 8 | payload[1] : WS_CLOSE_NO_STATUS;
+}
@@ -0,0 +1,42 @@
+#ifndef WS_FRAME_H
+#define WS_FRAME_H
+
+// Websocket (RFC 6455) frame headers and masking for realtimeChannel
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE 0x8
+#define WS_OPCODE_PING 0x9
+#define WS_OPCODE_PONG 0xA
+
+#define WS_HEADER_MAX_BYTES 14 // Two bytes, a 64-bit length and the mask key
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_NO_STATUS 1005 // A close frame without a code
+
+struct WsFrameHeader
+{
+  bool fin;
+  uint8_t opcode;
+  bool masked;
+  uint8_t mask[4]; // All zero when not masked
+  uint64_t length;
+};
+
+// Writes the header of a final, masked frame, as a client must send them; returns its size
+size_t wsFrameEncodeHeader(uint8_t *out, uint8_t opcode, uint64_t length, const uint8_t mask[4]);
+// Masks or unmasks in place; the operation is its own inverse
+void wsFrameMask(uint8_t *data, size_t length, const uint8_t mask[4]);
+
+// Header size announced by its first two bytes, those included
+size_t wsFrameHeaderBytes(const uint8_t head[2]);
+// Decodes a header of wsFrameHeaderBytes() bytes
+void wsFrameDecodeHeader(const uint8_t *bytes, WsFrameHeader &out);
+
+// Status code of a close frame's payload
+uint16_t wsFrameCloseCode(const uint8_t *payload, size_t length);
+
+#endif
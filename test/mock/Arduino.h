@@ -0,0 +1,168 @@
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino core, and the FreeRTOS it brings in on the
+// ESP32, that the keypad libraries, the JSON row parser and the realtime channel use. The
+// clock is virtual: the test sets it, and the mock bus and task delays advance it
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+extern unsigned long mockMicros;
+
+inline unsigned long micros()
+{
+  return mockMicros;
+}
+
+inline unsigned long millis()
+{
+  return mockMicros / 1000;
+}
+
+// Keypad_I2C drives the matrix through the expander, never through these
+inline void pinMode(uint8_t, uint8_t)
+{
+}
+
+inline void digitalWrite(uint8_t, uint8_t)
+{
+}
+
+inline int digitalRead(uint8_t)
+{
+  return HIGH;
+}
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+
+  size_t printf(const char *format, ...)
+  {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    size_t count = 0;
+    for (int i = 0; i < length && i < (int)sizeof(text) - 1; i++)
+    {
+      count += write((uint8_t)text[i]);
+    }
+    return count;
+  }
+
+  size_t println(const char *text)
+  {
+    return printf("%s\n", text);
+  }
+};
+
+class MockSerial : public Print
+{
+public:
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+};
+
+inline MockSerial Serial;
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  size_t readBytes(char *buffer, size_t length)
+  {
+    size_t count = 0;
+    int c;
+    while (count < length && (c = read()) >= 0)
+    {
+      buffer[count++] = (char)c;
+    }
+    return count;
+  }
+};
+
+// One test thread, so the critical sections have nothing to exclude and a mutex is always free
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+typedef uint32_t TickType_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY 0xFFFFFFFF
+
+inline int xSemaphoreTake(SemaphoreHandle_t, TickType_t)
+{
+  return pdTRUE;
+}
+
+inline int xSemaphoreGive(SemaphoreHandle_t)
+{
+  return pdTRUE;
+}
+
+// A task waiting for the wire lets the virtual clock run
+inline void vTaskDelay(TickType_t ticks)
+{
+  mockMicros += (unsigned long)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+// Tasks are never started; the test calls their steps itself
+inline int xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, unsigned, TaskHandle_t *, int)
+{
+  return pdPASS;
+}
+
+// Repeatable, so a failing run can be replayed
+inline uint32_t esp_random()
+{
+  static uint32_t state = 0x12345678;
+  state = state * 1664525 + 1013904223;
+  return state;
+}
+
+inline void esp_fill_random(void *out, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    ((uint8_t *)out)[i] = (uint8_t)(esp_random() >> 24);
+  }
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef MOCK_WIFI_H
+#define MOCK_WIFI_H
+
+// Host stand-in for the WiFiClient the realtime channel talks through. Every client shares one
+// socket, whose far end is the test: it queues the bytes the server sends and reads back what
+// the client wrote
+
+#include <Arduino.h>
+#include <string>
+
+struct MockSocket
+{
+  std::string incoming; // Server to client, consumed from position
+  size_t position = 0;
+  std::string written;  // Client to server
+  bool open = false;
+  bool refuse = false; // The next connect() fails
+  std::string host;
+  uint16_t port = 0;
+};
+
+extern MockSocket mockSocket;
+
+class WiFiClient
+{
+public:
+  virtual ~WiFiClient() {}
+
+  int connect(const char *host, uint16_t port)
+  {
+    mockSocket.host = host;
+    mockSocket.port = port;
+    mockSocket.open = !mockSocket.refuse;
+    return mockSocket.open;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    if (!mockSocket.open)
+    {
+      return 0;
+    }
+    mockSocket.written.append((const char *)buffer, size);
+    return size;
+  }
+
+  int available() { return mockSocket.open ? mockSocket.incoming.size() - mockSocket.position : 0; }
+
+  int read(uint8_t *buffer, size_t size)
+  {
+    size_t count = min(size, (size_t)available());
+    memcpy(buffer, &mockSocket.incoming[mockSocket.position], count);
+    mockSocket.position += count;
+    return count ? (int)count : -1;
+  }
+
+  uint8_t connected() { return mockSocket.open; }
+  void stop() { mockSocket.open = false; }
+  void setTimeout(uint32_t) {}
+};
+
+#endif
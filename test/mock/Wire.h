@@ -0,0 +1,120 @@
+#ifndef MOCK_WIRE_H
+#define MOCK_WIRE_H
+
+// Host stand-in for TwoWire with a PCF8574/PCF8575 and a key matrix on the other end.
+// It counts transactions and charges each one its time on a 100 kHz bus
+
+#include "Arduino.h"
+
+#define MOCK_WIRE_BIT_MICROS 10 // 100 kHz
+#define MOCK_WIRE_MAX_KEYS 4
+
+class TwoWire
+{
+public:
+  uint8_t address = 0x20;
+  uint16_t latch = 0xFFFF; // Written port value; a 0 drives the pin low, a 1 is a weak pull-up
+  unsigned long writes = 0;
+  unsigned long reads = 0;
+
+  // A held key joins its row pin to its column pin
+  void press(uint8_t rowPin, uint8_t colPin)
+  {
+    if (keyCount < MOCK_WIRE_MAX_KEYS)
+    {
+      rowPins[keyCount] = rowPin;
+      colPins[keyCount++] = colPin;
+    }
+  }
+
+  void releaseAll()
+  {
+    keyCount = 0;
+  }
+
+  unsigned long transactions()
+  {
+    return writes + reads;
+  }
+
+  void beginTransmission(int to)
+  {
+    target = to;
+    sent = 0;
+  }
+
+  size_t write(uint8_t data)
+  {
+    if (sent < 2)
+    {
+      pending[sent] = data;
+    }
+    sent++;
+    return 1;
+  }
+
+  uint8_t endTransmission()
+  {
+    writes++;
+    busTime(sent);
+    if (target != address)
+    {
+      return 2; // Address not acknowledged
+    }
+    latch = sent > 1 ? pending[0] | pending[1] << 8 : (latch & 0xFF00) | pending[0];
+    return 0;
+  }
+
+  uint8_t requestFrom(int from, int quantity)
+  {
+    reads++;
+    busTime(quantity);
+    if (from != address)
+    {
+      available = 0;
+      return 0;
+    }
+    uint16_t port = latch;
+    for (uint8_t k = 0; k < keyCount; k++)
+    {
+      if (!(latch & 1 << colPins[k]))
+      {
+        port &= ~(1 << rowPins[k]);
+      }
+    }
+    received = port;
+    available = quantity;
+    next = 0;
+    return quantity;
+  }
+
+  int read()
+  {
+    if (next >= available)
+    {
+      return -1;
+    }
+    return (received >> (8 * next++)) & 0xFF;
+  }
+
+private:
+  int target = 0;
+  uint8_t pending[2] = {0xFF, 0xFF};
+  uint8_t sent = 0;
+  uint16_t received = 0xFFFF;
+  uint8_t available = 0;
+  uint8_t next = 0;
+  uint8_t rowPins[MOCK_WIRE_MAX_KEYS];
+  uint8_t colPins[MOCK_WIRE_MAX_KEYS];
+  uint8_t keyCount = 0;
+
+  // Start, address byte, data bytes with their acknowledge bits, stop
+  void busTime(int bytes)
+  {
+    mockMicros += (2 + 9 * (1 + bytes)) * MOCK_WIRE_BIT_MICROS;
+  }
+};
+
+extern TwoWire Wire;
+
+#endif
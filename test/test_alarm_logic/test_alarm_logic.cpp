@@ -0,0 +1,330 @@
+#include <unity.h>
+#include <string.h>
+#include "../../src/alarmLogic/alarmLogic.h"
+#include "../../src/simulator/simulator.h"
+
+// As in alarmLogic.cpp
+#define ACCESS_HOLD_MS 5000
+#define ACCESS_MESSAGE_MS 2000
+#define MOTION_DEBOUNCE_MS 100
+#define SENSOR_HEARTBEAT_MS 60000
+
+// Passes every 10 ms, finer than the device's, so each timing shows to the step
+#define STEP_MS 10
+#define START_MS 100000
+
+static const uint8_t card[] = {0x7A, 0x77, 0xC7, 0xB2};
+static const uint8_t unknownCard[] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+static void runAccess(uint32_t untilMs)
+{
+  while (simMillis() < untilMs)
+  {
+    alarmAccessStep(0);
+    sim.nowMicros += STEP_MS * 1000;
+  }
+}
+
+static void runSensors(uint32_t untilMs)
+{
+  while (simMillis() < untilMs)
+  {
+    alarmSensorsStep(NULL);
+    sim.nowMicros += STEP_MS * 1000;
+  }
+}
+
+// Presses every key in one pass each, at the current time
+static void enter(const char *keys)
+{
+  for (; *keys; keys++)
+  {
+    alarmAccessStep(*keys);
+  }
+}
+
+static void showCard(const uint8_t *uid, uint8_t length)
+{
+  memcpy(sim.card, uid, length);
+  sim.cardLength = length;
+  sim.cardPresent = true;
+}
+
+static bool shows(const char *line0)
+{
+  return strncmp(sim.display[0], line0, strlen(line0)) == 0;
+}
+
+// Opens the door and runs one sensor pass; true when that sounds the siren
+static bool openDoorSoundsSiren()
+{
+  sim.levels[SIM_MAGNETIC_PIN] = 1;
+  alarmSensorsStep(NULL);
+  return sim.siren;
+}
+
+void setUp()
+{
+  memset(&sim, 0, sizeof(sim));
+  sim.quiet = true;
+  sim.nowMicros = (uint64_t)START_MS * 1000;
+  sirenStatus = rfidStatus = keypadStatus = vibrationStatus = magneticStatus = motionStatus = 1;
+
+  uidTableClear(sim.cards);
+  uidTableInsert(sim.cards, card, sizeof(card));
+  for (int i = 0; i < PIN_SALT_BYTES; i++)
+  {
+    sim.salt[i] = i * 37 + 11;
+  }
+  pinHashSalted(sim.salt, "123456", 6, sim.pinHashes[sim.users++], false);
+  pinLockoutInit(sim.pinLockout);
+
+  alarmLogicBegin({SIM_MOTION_PIN, SIM_MAGNETIC_PIN, SIM_VIBRATION_PIN});
+  alarmAccessBegin();
+
+  // Let the first levels settle, then count only what the test causes
+  runSensors(START_MS + MOTION_DEBOUNCE_MS + STEP_MS);
+  memset(sim.sent, 0, sizeof(sim.sent));
+}
+
+void tearDown()
+{
+}
+
+void test_prompt_shows_at_begin()
+{
+  TEST_ASSERT_TRUE(shows("Enter password:"));
+  TEST_ASSERT_FALSE(sim.siren);
+}
+
+void test_pin_disarms_the_door_for_the_hold_time()
+{
+  uint32_t grantedAt = simMillis();
+  enter("123456#");
+  TEST_ASSERT_TRUE(shows("Access granted"));
+  TEST_ASSERT_EQUAL(1, sim.chimes);
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_KEYPAD]);
+  TEST_ASSERT_FALSE(openDoorSoundsSiren());
+
+  runAccess(grantedAt + ACCESS_HOLD_MS);
+  TEST_ASSERT_FALSE(openDoorSoundsSiren());
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_KEYPAD]);
+
+  // The door re-arms on the pass at the end of the hold
+  alarmAccessStep(0);
+  TEST_ASSERT_EQUAL(2, sim.sent[TELEMETRY_KEYPAD]);
+  TEST_ASSERT_TRUE(shows("Enter password:"));
+  TEST_ASSERT_TRUE(openDoorSoundsSiren());
+}
+
+void test_card_disarms_the_door_for_the_hold_time()
+{
+  uint32_t shownAt = simMillis();
+  showCard(card, sizeof(card));
+  alarmAccessStep(0);
+  TEST_ASSERT_FALSE(sim.cardPresent);
+  TEST_ASSERT_TRUE(shows("Access granted"));
+  TEST_ASSERT_EQUAL(1, sim.chimes);
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_RFID]);
+  TEST_ASSERT_FALSE(openDoorSoundsSiren());
+
+  runAccess(shownAt + ACCESS_HOLD_MS);
+  TEST_ASSERT_FALSE(openDoorSoundsSiren());
+  alarmAccessStep(0);
+  TEST_ASSERT_EQUAL(2, sim.sent[TELEMETRY_RFID]);
+  TEST_ASSERT_TRUE(openDoorSoundsSiren());
+}
+
+void test_unknown_card_is_refused()
+{
+  showCard(unknownCard, sizeof(unknownCard));
+  alarmAccessStep(0);
+  TEST_ASSERT_FALSE(sim.cardPresent);
+  TEST_ASSERT_EQUAL(0, sim.chimes);
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_RFID]);
+  TEST_ASSERT_TRUE(shows("Enter password:"));
+}
+
+void test_star_clears_the_digits()
+{
+  enter("99*123456#");
+  TEST_ASSERT_EQUAL(1, sim.chimes);
+}
+
+// The message replaces the 2 s delay the task used to block in; keys pressed meanwhile are lost
+void test_rejected_pin_holds_the_keypad_for_the_message_time()
+{
+  uint32_t rejectedAt = simMillis();
+  enter("654321#");
+  TEST_ASSERT_TRUE(shows("Incorrect"));
+  TEST_ASSERT_EQUAL(0, sim.chimes);
+
+  runAccess(rejectedAt + ACCESS_MESSAGE_MS / 2);
+  enter("1");
+  runAccess(rejectedAt + ACCESS_MESSAGE_MS);
+  TEST_ASSERT_TRUE(shows("Incorrect"));
+
+  enter("123456#");
+  TEST_ASSERT_EQUAL(1, sim.chimes);
+}
+
+void test_rejected_pin_holds_the_reader_for_the_message_time()
+{
+  uint32_t rejectedAt = simMillis();
+  enter("654321#");
+  showCard(card, sizeof(card));
+  runAccess(rejectedAt + ACCESS_MESSAGE_MS);
+  TEST_ASSERT_TRUE(sim.cardPresent);
+  TEST_ASSERT_EQUAL(0, sim.chimes);
+
+  alarmAccessStep(0);
+  TEST_ASSERT_FALSE(sim.cardPresent);
+  TEST_ASSERT_EQUAL(1, sim.chimes);
+}
+
+void test_repeated_failures_lock_the_keypad()
+{
+  for (int i = 0; i < PIN_MAX_FAILURES; i++)
+  {
+    enter("654321#");
+    TEST_ASSERT_TRUE(shows("Incorrect"));
+    runAccess(simMillis() + ACCESS_MESSAGE_MS);
+  }
+  uint32_t lockedAt = simMillis() - ACCESS_MESSAGE_MS;
+
+  // Even the right PIN is refused without being checked
+  enter("123456#");
+  TEST_ASSERT_TRUE(shows("Keypad locked"));
+  TEST_ASSERT_EQUAL(0, sim.chimes);
+
+  // A card still works during the lockout
+  runAccess(simMillis() + ACCESS_MESSAGE_MS);
+  showCard(card, sizeof(card));
+  alarmAccessStep(0);
+  TEST_ASSERT_EQUAL(1, sim.chimes);
+
+  runAccess(lockedAt + PIN_LOCKOUT_MS);
+  enter("123456#");
+  TEST_ASSERT_EQUAL(2, sim.chimes);
+}
+
+void test_switched_off_inputs_are_ignored()
+{
+  keypadStatus = 0;
+  rfidStatus = 0;
+  enter("123456#");
+  showCard(card, sizeof(card));
+  alarmAccessStep(0);
+  TEST_ASSERT_EQUAL(0, sim.chimes);
+  TEST_ASSERT_TRUE(sim.cardPresent);
+}
+
+void test_open_door_sounds_the_siren_until_switched_off()
+{
+  TEST_ASSERT_TRUE(openDoorSoundsSiren());
+  TEST_ASSERT_EQUAL(1, sim.sirenStarts);
+  sirenStatus = 0;
+  alarmSensorsStep(NULL);
+  TEST_ASSERT_FALSE(sim.siren);
+  sirenStatus = 1;
+  sim.levels[SIM_MAGNETIC_PIN] = 0;
+  alarmSensorsStep(NULL);
+  TEST_ASSERT_FALSE(sim.siren);
+}
+
+// With the door sensor switched off the vibration decision drives the siren on its own
+void test_single_vibration_spike_does_not_alarm()
+{
+  magneticStatus = 0;
+  sim.vibrationSpike = VIBRATION_SAMPLE_MASK;
+  runSensors(simMillis() + 1000);
+  TEST_ASSERT_EQUAL(0, sim.sirenStarts);
+  TEST_ASSERT_EQUAL(0, sim.sent[TELEMETRY_VIBRATION]);
+}
+
+void test_knock_sounds_the_siren()
+{
+  magneticStatus = 0;
+  sim.vibrationLevel = VIBRATION_SAMPLE_MASK;
+  sim.vibrationUntil = simMillis() + 400;
+  alarmSensorsStep(NULL);
+  TEST_ASSERT_TRUE(sim.siren);
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_VIBRATION]);
+}
+
+// The sampler's hit decides, not the window peak it reports alongside
+void test_sampled_peak_without_a_hit_does_not_alarm()
+{
+  magneticStatus = 0;
+  AlarmVibration spike = {false, VIBRATION_SAMPLE_MASK};
+  alarmSensorsStep(&spike);
+  TEST_ASSERT_FALSE(sim.siren);
+  AlarmVibration knock = {true, VIBRATION_SAMPLE_MASK};
+  alarmSensorsStep(&knock);
+  TEST_ASSERT_TRUE(sim.siren);
+}
+
+void test_motion_is_reported_after_the_debounce_time()
+{
+  uint32_t edgeAt = simMillis();
+  sim.levels[SIM_MOTION_PIN] = 1;
+  alarmSensorEdge(SIM_MOTION_PIN, 1, edgeAt);
+  runSensors(edgeAt + MOTION_DEBOUNCE_MS);
+  TEST_ASSERT_EQUAL(0, sim.sent[TELEMETRY_MOTION]);
+  TEST_ASSERT_TRUE(alarmSensorsDebouncing());
+  alarmSensorsStep(NULL);
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_MOTION]);
+  TEST_ASSERT_FALSE(alarmSensorsDebouncing());
+}
+
+void test_motion_glitch_is_not_reported()
+{
+  uint32_t edgeAt = simMillis();
+  alarmSensorEdge(SIM_MOTION_PIN, 1, edgeAt);
+  alarmSensorEdge(SIM_MOTION_PIN, 0, edgeAt + 40);
+  runSensors(edgeAt + 10 * MOTION_DEBOUNCE_MS);
+  TEST_ASSERT_EQUAL(0, sim.sent[TELEMETRY_MOTION]);
+}
+
+// Each sensor's heartbeat falls due a minute after its first report in setUp: the vibration
+// flag at once, the door after 30 ms and motion after 100 ms of debounce
+void test_unchanged_sensors_send_a_heartbeat()
+{
+  runSensors(START_MS + SENSOR_HEARTBEAT_MS);
+  TEST_ASSERT_EQUAL(0, sim.sent[TELEMETRY_MOTION] + sim.sent[TELEMETRY_MAGNETIC] + sim.sent[TELEMETRY_VIBRATION]);
+  alarmSensorsStep(NULL);
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_VIBRATION]);
+
+  runSensors(START_MS + MOTION_DEBOUNCE_MS + SENSOR_HEARTBEAT_MS);
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_MAGNETIC]);
+  TEST_ASSERT_EQUAL(0, sim.sent[TELEMETRY_MOTION]);
+  alarmSensorsStep(NULL);
+  TEST_ASSERT_EQUAL(1, sim.sent[TELEMETRY_MOTION]);
+
+  runSensors(START_MS + MOTION_DEBOUNCE_MS + 2 * SENSOR_HEARTBEAT_MS + STEP_MS);
+  TEST_ASSERT_EQUAL(2, sim.sent[TELEMETRY_MOTION]);
+  TEST_ASSERT_EQUAL(2, sim.sent[TELEMETRY_MAGNETIC]);
+  TEST_ASSERT_EQUAL(2, sim.sent[TELEMETRY_VIBRATION]);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_prompt_shows_at_begin);
+  RUN_TEST(test_pin_disarms_the_door_for_the_hold_time);
+  RUN_TEST(test_card_disarms_the_door_for_the_hold_time);
+  RUN_TEST(test_unknown_card_is_refused);
+  RUN_TEST(test_star_clears_the_digits);
+  RUN_TEST(test_rejected_pin_holds_the_keypad_for_the_message_time);
+  RUN_TEST(test_rejected_pin_holds_the_reader_for_the_message_time);
+  RUN_TEST(test_repeated_failures_lock_the_keypad);
+  RUN_TEST(test_switched_off_inputs_are_ignored);
+  RUN_TEST(test_open_door_sounds_the_siren_until_switched_off);
+  RUN_TEST(test_single_vibration_spike_does_not_alarm);
+  RUN_TEST(test_knock_sounds_the_siren);
+  RUN_TEST(test_sampled_peak_without_a_hit_does_not_alarm);
+  RUN_TEST(test_motion_is_reported_after_the_debounce_time);
+  RUN_TEST(test_motion_glitch_is_not_reported);
+  RUN_TEST(test_unchanged_sensors_send_a_heartbeat);
+  return UNITY_END();
+}
@@ -0,0 +1,269 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "../../src/jsonRows/jsonRows.h"
+#include "../../src/logger/logger.h"
+
+#define LARGE_ROWS 2000
+
+unsigned long mockMicros = 0;
+static int loggedErrors;
+
+// The device's logger queues records for its own task; here errors are only counted
+uint8_t logLevel(LogModule)
+{
+  return LOG_LEVEL_ERROR;
+}
+
+void logRecord(uint8_t level, LogModule, const char *, const uintptr_t *, int, const char *)
+{
+  loggedErrors += level >= LOG_LEVEL_ERROR;
+}
+
+// sensor_data as PostgREST returns it for select=*: status is the "on"/"off" switch configSync
+// reads, value what the network worker last reported (null until then), and timestamptz keeps
+// trailing zeros off its fraction
+static const char *recordedStatuses =
+    "[{\"id\":1,\"created_at\":\"2024-03-02T10:11:12.345678+00:00\",\"name\":\"siren\",\"status\":\"on\","
+    "\"value\":null,\"updated_at\":\"2026-10-17T08:00:01.123456+00:00\"},"
+    "{\"id\":2,\"created_at\":\"2024-03-02T10:11:12.345678+00:00\",\"name\":\"rfid\",\"status\":\"off\","
+    "\"value\":0,\"updated_at\":\"2026-10-17T08:00:02.5+00:00\"},"
+    "{\"id\":3,\"created_at\":\"2024-03-02T10:11:12.345678+00:00\",\"name\":\"keypad\",\"status\":\"on\","
+    "\"value\":1,\"updated_at\":\"2026-10-17T08:00:03+00:00\"},"
+    "{\"id\":4,\"created_at\":\"2024-03-02T10:11:12.345678+00:00\",\"name\":\"vibration\",\"status\":\"on\","
+    "\"value\":2731,\"updated_at\":\"2026-10-17T08:00:04.000001+00:00\"},"
+    "{\"id\":5,\"created_at\":\"2024-03-02T10:11:12.345678+00:00\",\"name\":\"magnetic\",\"status\":\"off\","
+    "\"value\":1,\"updated_at\":\"2026-10-17T08:00:05.75+00:00\"},"
+    "{\"id\":6,\"created_at\":\"2024-03-02T10:11:12.345678+00:00\",\"name\":\"motion\",\"status\":\"on\","
+    "\"value\":0,\"updated_at\":\"2026-10-17T08:00:06.25+00:00\"}]";
+
+static const char *const statusFields[] = {"name", "status", "updated_at"};
+static const char *const cardFields[] = {"uid", "active", "updated_at"};
+
+// A recorded response, read a byte at a time as from the socket
+class RecordedStream : public Stream
+{
+public:
+  explicit RecordedStream(const char *body) : body(body), position(0) {}
+
+  int available() override { return strlen(&body[position]); }
+  int read() override { return body[position] ? (uint8_t)body[position++] : -1; }
+  int peek() override { return body[position] ? (uint8_t)body[position] : -1; }
+  size_t write(uint8_t) override { return 0; }
+
+private:
+  const char *body;
+  size_t position;
+};
+
+// An allowlist response of any length, made up a row at a time so the test holds no more of it
+// than the device would
+class CardStream : public Stream
+{
+public:
+  explicit CardStream(int rows) : rows(rows), next(0), position(0), bytes(0) { fill(); }
+
+  int available() override { return line[position] ? 1 : 0; }
+  int read() override
+  {
+    int c = peek();
+    if (c >= 0)
+    {
+      position++;
+      bytes++;
+    }
+    return c;
+  }
+  int peek() override
+  {
+    if (!line[position])
+    {
+      fill();
+    }
+    return line[position] ? (uint8_t)line[position] : -1;
+  }
+  size_t write(uint8_t) override { return 0; }
+  size_t total() const { return bytes; }
+
+private:
+  int rows;
+  int next;
+  size_t position;
+  size_t bytes;
+  char line[160];
+
+  void fill()
+  {
+    position = 0;
+    if (next > rows)
+    {
+      line[0] = '\0';
+      return;
+    }
+    if (next == rows)
+    {
+      snprintf(line, sizeof(line), "%s]", rows ? "" : "[");
+    }
+    else
+    {
+      snprintf(line, sizeof(line),
+               "%s{\"id\":%d,\"uid\":\"04A1%06X\",\"active\":%s,\"label\":\"Resident card %04d\","
+               "\"updated_at\":\"2026-10-17T08:%02d:%02d.%06d+00:00\"}",
+               next ? "," : "[", next + 1, next * 7919, next % 9 ? "true" : "false", next, next / 60 % 60, next % 60,
+               next * 37 % 1000000);
+    }
+    next++;
+  }
+};
+
+void setUp()
+{
+  loggedErrors = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_recorded_rows_keep_only_requested_fields()
+{
+  static const char *names[] = {"siren", "rfid", "keypad", "vibration", "magnetic", "motion"};
+  static const char *statuses[] = {"on", "off", "on", "on", "off", "on"};
+  RecordedStream body(recordedStatuses);
+  JsonRows rows(statusFields, 3);
+  int i = 0;
+  while (rows.next(body))
+  {
+    JsonObjectConst row = rows.row();
+    TEST_ASSERT_EQUAL_STRING(names[i], row["name"].as<const char *>());
+    TEST_ASSERT_EQUAL_STRING(statuses[i], row["status"].as<const char *>());
+    TEST_ASSERT_NOT_NULL(row["updated_at"].as<const char *>());
+    TEST_ASSERT_TRUE(row["id"].isNull());
+    TEST_ASSERT_TRUE(row["created_at"].isNull());
+    TEST_ASSERT_TRUE(row["value"].isNull());
+    i++;
+  }
+  TEST_ASSERT_EQUAL(6, i);
+  TEST_ASSERT_EQUAL(6, rows.count());
+  TEST_ASSERT_FALSE(rows.failed());
+  TEST_ASSERT_EQUAL(-1, body.peek()); // The closing bracket was consumed
+  TEST_ASSERT_EQUAL_STRING("2026-10-17T08:00:06.25+00:00", rows.row()["updated_at"].as<const char *>());
+}
+
+void test_empty_array_has_no_rows()
+{
+  RecordedStream body(" [ ]\r\n");
+  JsonRows rows(statusFields, 3);
+  TEST_ASSERT_FALSE(rows.next(body));
+  TEST_ASSERT_FALSE(rows.failed());
+  TEST_ASSERT_EQUAL(0, rows.count());
+}
+
+void test_error_object_is_not_rows()
+{
+  RecordedStream body("{\"code\":\"42P01\",\"message\":\"relation does not exist\"}");
+  JsonRows rows(statusFields, 3);
+  TEST_ASSERT_FALSE(rows.next(body));
+  TEST_ASSERT_TRUE(rows.failed());
+  TEST_ASSERT_EQUAL(1, loggedErrors);
+}
+
+void test_response_cut_inside_a_row_fails()
+{
+  RecordedStream body("[{\"name\":\"siren\",\"status\":\"on\"},{\"name\":\"rf");
+  JsonRows rows(statusFields, 3);
+  TEST_ASSERT_TRUE(rows.next(body));
+  TEST_ASSERT_FALSE(rows.next(body));
+  TEST_ASSERT_TRUE(rows.failed());
+  TEST_ASSERT_EQUAL(1, rows.count());
+}
+
+void test_response_cut_between_rows_fails()
+{
+  RecordedStream body("[{\"name\":\"siren\",\"status\":\"on\"}");
+  JsonRows rows(statusFields, 3);
+  TEST_ASSERT_TRUE(rows.next(body));
+  TEST_ASSERT_FALSE(rows.next(body));
+  TEST_ASSERT_TRUE(rows.failed());
+}
+
+// An arena holds the first variant pool and one row's strings; a response a hundred times longer
+// must not need more
+void test_arena_high_water_does_not_grow_with_the_response()
+{
+  {
+    // Both readers at once would need four arenas, one more than the pool has
+    CardStream first(1);
+    JsonRows one(cardFields, 3);
+    TEST_ASSERT_TRUE(one.next(first));
+    TEST_ASSERT_FALSE(one.next(first));
+  }
+  size_t oneRow = jsonArenaHighWater();
+  uint32_t failures = jsonArenaFailures();
+
+  CardStream body(LARGE_ROWS);
+  JsonRows rows(cardFields, 3);
+  int active = 0;
+  while (rows.next(body))
+  {
+    active += rows.row()["active"].as<bool>();
+  }
+  TEST_ASSERT_FALSE(rows.failed());
+  TEST_ASSERT_EQUAL(LARGE_ROWS, rows.count());
+  TEST_ASSERT_EQUAL(LARGE_ROWS - (LARGE_ROWS + 8) / 9, active);
+  TEST_ASSERT_EQUAL(oneRow, jsonArenaHighWater());
+  TEST_ASSERT_EQUAL(failures, jsonArenaFailures());
+  TEST_ASSERT_LESS_THAN(JSON_ARENA_BYTES, oneRow);
+
+  char line[96];
+  snprintf(line, sizeof(line), "%d rows, %u bytes: arena high water %u of %u bytes", LARGE_ROWS,
+           (unsigned)body.total(), (unsigned)jsonArenaHighWater(), (unsigned)JSON_ARENA_BYTES);
+  TEST_MESSAGE(line);
+}
+
+// Arenas go back to the pool with their parser, so one read can follow another indefinitely
+void test_arenas_return_to_the_pool()
+{
+  for (int i = 0; i < JSON_ARENA_COUNT * 4; i++)
+  {
+    RecordedStream body(recordedStatuses);
+    JsonRows rows(statusFields, 3);
+    while (rows.next(body))
+    {
+    }
+    TEST_ASSERT_FALSE(rows.failed());
+    TEST_ASSERT_EQUAL(6, rows.count());
+  }
+  TEST_ASSERT_EQUAL(0, loggedErrors);
+}
+
+void test_benchmark_parse()
+{
+  auto start = std::chrono::steady_clock::now();
+  CardStream body(LARGE_ROWS);
+  JsonRows rows(cardFields, 3);
+  while (rows.next(body))
+  {
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  char line[96];
+  snprintf(line, sizeof(line), "%d rows: %.2f us per row, %.1f MB/s", rows.count(), ns / rows.count() / 1000,
+           ns > 0 ? body.total() * 1000.0 / ns : 0.0);
+  TEST_MESSAGE(line);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_recorded_rows_keep_only_requested_fields);
+  RUN_TEST(test_empty_array_has_no_rows);
+  RUN_TEST(test_error_object_is_not_rows);
+  RUN_TEST(test_response_cut_inside_a_row_fails);
+  RUN_TEST(test_response_cut_between_rows_fails);
+  RUN_TEST(test_arena_high_water_does_not_grow_with_the_response);
+  RUN_TEST(test_arenas_return_to_the_pool);
+  RUN_TEST(test_benchmark_parse);
+  return UNITY_END();
+}
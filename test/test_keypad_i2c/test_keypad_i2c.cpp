@@ -0,0 +1,184 @@
+#include <unity.h>
+#include <stdio.h>
+#include <Keypad_I2C.h>
+
+// Same keymap and wiring as the device
+#define KEYPAD_ADDR 0x20
+#define ROWS 4
+#define COLS 4
+#define SCAN_GAP_MS 20 // Longer than Keypad's 10 ms debounce, so every getKeys() scans
+
+unsigned long mockMicros = 0;
+TwoWire Wire;
+
+static char keys[ROWS][COLS] = {
+    {'1', '2', '3', 'A'}, {'4', '5', '6', 'B'}, {'7', '8', '9', 'C'}, {'*', '0', '#', 'D'}};
+static byte rowPins[ROWS] = {0, 1, 2, 3};
+static byte colPins[COLS] = {4, 5, 6, 7};
+static byte wideRowPins[ROWS] = {8, 9, 10, 11};
+static byte wideColPins[COLS] = {12, 13, 14, 15};
+
+static unsigned int locks;
+static unsigned int unlockTransactions;
+static unsigned int unlockErrors;
+
+static bool countLock(byte address)
+{
+  locks++;
+  return address == KEYPAD_ADDR;
+}
+
+static void countUnlock(byte, unsigned int transactions, unsigned int errors)
+{
+  unlockTransactions += transactions;
+  unlockErrors += errors;
+}
+
+static void nextScan()
+{
+  mockMicros += SCAN_GAP_MS * 1000;
+}
+
+// Transactions the mock bus saw during one getKeys()
+static unsigned long scanTransactions(Keypad_I2C &keypad)
+{
+  nextScan();
+  unsigned long before = Wire.transactions();
+  keypad.getKeys();
+  return Wire.transactions() - before;
+}
+
+void setUp()
+{
+  Wire = TwoWire();
+  mockMicros = 0;
+  locks = 0;
+  unlockTransactions = 0;
+  unlockErrors = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_port_scan_costs_three_transactions_per_column()
+{
+  Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, KEYPAD_ADDR, PCF8574);
+  keypad.begin();
+  // Per column: drive it low, read the port once, release it
+  TEST_ASSERT_EQUAL(3 * COLS, scanTransactions(keypad));
+  TEST_ASSERT_EQUAL(3 * COLS, keypad.getLastScanTransactions());
+}
+
+void test_pin_scan_costs_a_read_per_row()
+{
+  Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, KEYPAD_ADDR, PCF8574);
+  keypad.setScanMode(KEYPAD_I2C_SCAN_PIN);
+  keypad.begin();
+  TEST_ASSERT_EQUAL((2 + ROWS) * COLS, scanTransactions(keypad));
+  TEST_ASSERT_EQUAL((2 + ROWS) * COLS, keypad.getLastScanTransactions());
+}
+
+void test_port_scan_bus_time_is_measured()
+{
+  Keypad_I2C portKeypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, KEYPAD_ADDR, PCF8574);
+  Keypad_I2C pinKeypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, KEYPAD_ADDR, PCF8574);
+  pinKeypad.setScanMode(KEYPAD_I2C_SCAN_PIN);
+  portKeypad.begin();
+  pinKeypad.begin();
+
+  nextScan();
+  unsigned long start = mockMicros;
+  portKeypad.getKeys();
+  unsigned long portMicros = mockMicros - start;
+  nextScan();
+  start = mockMicros;
+  pinKeypad.getKeys();
+  unsigned long pinMicros = mockMicros - start;
+
+  // The mock clock only moves while bytes are on the bus, so the keypad's figure is exact
+  TEST_ASSERT_EQUAL(portMicros, portKeypad.getLastScanMicros());
+  TEST_ASSERT_EQUAL(pinMicros, pinKeypad.getLastScanMicros());
+  TEST_ASSERT_LESS_THAN(pinMicros, portMicros);
+
+  char line[96];
+  snprintf(line, sizeof(line), "4x4 scan at 100 kHz: port mode %lu us, pin mode %lu us", portMicros, pinMicros);
+  TEST_MESSAGE(line);
+}
+
+void test_both_modes_decode_every_key()
+{
+  for (byte mode = KEYPAD_I2C_SCAN_PIN; mode <= KEYPAD_I2C_SCAN_PORT; mode++)
+  {
+    for (byte r = 0; r < ROWS; r++)
+    {
+      for (byte c = 0; c < COLS; c++)
+      {
+        Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, KEYPAD_ADDR, PCF8574);
+        keypad.setScanMode(mode);
+        keypad.begin();
+        Wire.releaseAll();
+        Wire.press(rowPins[r], colPins[c]);
+        nextScan();
+        TEST_ASSERT_EQUAL(keys[r][c], keypad.getKey());
+      }
+    }
+  }
+}
+
+void test_pcf8575_decodes_the_high_byte()
+{
+  Keypad_I2C keypad(makeKeymap(keys), wideRowPins, wideColPins, ROWS, COLS, KEYPAD_ADDR, PCF8575);
+  keypad.begin();
+  Wire.press(wideRowPins[2], wideColPins[1]);
+  nextScan();
+  TEST_ASSERT_EQUAL('8', keypad.getKey());
+  TEST_ASSERT_EQUAL(3 * COLS, keypad.getLastScanTransactions());
+}
+
+void test_debounce_window_keeps_the_bus_quiet()
+{
+  Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, KEYPAD_ADDR, PCF8574);
+  keypad.begin();
+  scanTransactions(keypad);
+  unsigned long before = Wire.transactions();
+  keypad.getKeys(); // Within Keypad's debounce time, so no scan
+  TEST_ASSERT_EQUAL(before, Wire.transactions());
+  TEST_ASSERT_EQUAL(3 * COLS, keypad.getLastScanTransactions());
+}
+
+void test_scan_runs_under_one_bus_lock()
+{
+  Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, KEYPAD_ADDR, PCF8574);
+  keypad.setBusHooks(countLock, countUnlock);
+  keypad.begin();
+  locks = 0;
+  unlockTransactions = 0;
+  scanTransactions(keypad);
+  TEST_ASSERT_EQUAL(1, locks);
+  TEST_ASSERT_EQUAL(3 * COLS, unlockTransactions);
+  TEST_ASSERT_EQUAL(0, unlockErrors);
+}
+
+void test_missing_expander_counts_errors()
+{
+  Wire.address = KEYPAD_ADDR + 1;
+  Keypad_I2C keypad(makeKeymap(keys), rowPins, colPins, ROWS, COLS, KEYPAD_ADDR, PCF8574);
+  keypad.begin();
+  scanTransactions(keypad);
+  TEST_ASSERT_EQUAL(Wire.transactions(), keypad.getErrors());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_port_scan_costs_three_transactions_per_column);
+  RUN_TEST(test_pin_scan_costs_a_read_per_row);
+  RUN_TEST(test_port_scan_bus_time_is_measured);
+  RUN_TEST(test_both_modes_decode_every_key);
+  RUN_TEST(test_pcf8575_decodes_the_high_byte);
+  RUN_TEST(test_debounce_window_keeps_the_bus_quiet);
+  RUN_TEST(test_scan_runs_under_one_bus_lock);
+  RUN_TEST(test_missing_expander_counts_errors);
+  return UNITY_END();
+}
@@ -0,0 +1,159 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "../../src/pinHash/pinHash.h"
+
+#define BENCH_ROUNDS 20000
+
+struct Vector
+{
+  const char *message;
+  size_t repeat; // The message is hashed this many times over
+  const char *digest;
+};
+
+// FIPS 180-2 examples, then lengths either side of the 55-byte point where padding spills into a
+// second block, with digests from Python's hashlib
+static const Vector vectors[] = {
+    {"", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+     "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"},
+    {"a", 55, "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318"},
+    {"a", 56, "b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a"},
+    {"a", 63, "7d3e74a05d7db15bce4ad9ec0658ea98e3f06eeecf16b4c6fff2da457ddc2f34"},
+    {"a", 64, "ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb"},
+    {"a", 65, "635361c48bb9eab14198e76ea8ab7f1a41685d6ad62aa9146d301d4f17eb0ae0"},
+    {"a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+};
+
+static uint8_t message[1000000];
+static uint8_t salt[PIN_SALT_BYTES];
+
+static void parseDigest(const char *hex, uint8_t out[PIN_HASH_BYTES])
+{
+  for (int i = 0; i < PIN_HASH_BYTES; i++)
+  {
+    unsigned byte;
+    sscanf(&hex[i * 2], "%2x", &byte);
+    out[i] = byte;
+  }
+}
+
+static size_t buildMessage(const Vector &vector)
+{
+  size_t length = strlen(vector.message);
+  for (size_t i = 0; i < vector.repeat; i++)
+  {
+    memcpy(&message[i * length], vector.message, length);
+  }
+  return length * vector.repeat;
+}
+
+void setUp()
+{
+  // Same salt as the simulator's users
+  for (int i = 0; i < PIN_SALT_BYTES; i++)
+  {
+    salt[i] = i * 37 + 11;
+  }
+}
+
+void tearDown()
+{
+}
+
+void test_software_sha256_vectors()
+{
+  for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+  {
+    uint8_t expected[PIN_HASH_BYTES];
+    uint8_t digest[PIN_HASH_BYTES];
+    parseDigest(vectors[i].digest, expected);
+    pinHashSha256Software(message, buildMessage(vectors[i]), digest);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, digest, PIN_HASH_BYTES);
+  }
+}
+
+// Off the device the hardware flag falls back to the same software hash
+void test_hardware_flag_gives_the_same_digest()
+{
+  TEST_ASSERT_FALSE(pinHashHardwareAvailable());
+  uint8_t software[PIN_HASH_BYTES];
+  uint8_t hardware[PIN_HASH_BYTES];
+  size_t length = buildMessage(vectors[3]);
+  pinHashSha256(message, length, software, false);
+  pinHashSha256(message, length, hardware, true);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(software, hardware, PIN_HASH_BYTES);
+}
+
+void test_salted_hash_is_sha256_of_salt_then_digits()
+{
+  uint8_t expected[PIN_HASH_BYTES];
+  uint8_t digest[PIN_HASH_BYTES];
+  parseDigest("179df281424be9c3a2b3bd516de11b1ee9a93c84adb37d35a0738c7c3989bcc8", expected);
+  pinHashSalted(salt, "123456", 6, digest, false);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, digest, PIN_HASH_BYTES);
+}
+
+void test_salt_and_digits_both_change_the_hash()
+{
+  uint8_t a[PIN_HASH_BYTES];
+  uint8_t b[PIN_HASH_BYTES];
+  pinHashSalted(salt, "123456", 6, a, false);
+  pinHashSalted(salt, "123457", 6, b, false);
+  TEST_ASSERT_FALSE(pinHashEqual(a, b, PIN_HASH_BYTES));
+  pinHashSalted(salt, "12345", 5, b, false); // A prefix is a different PIN
+  TEST_ASSERT_FALSE(pinHashEqual(a, b, PIN_HASH_BYTES));
+  salt[PIN_SALT_BYTES - 1] ^= 1;
+  pinHashSalted(salt, "123456", 6, b, false);
+  TEST_ASSERT_FALSE(pinHashEqual(a, b, PIN_HASH_BYTES));
+}
+
+void test_equal_compares_every_byte()
+{
+  uint8_t a[PIN_HASH_BYTES];
+  uint8_t b[PIN_HASH_BYTES];
+  pinHashSalted(salt, "2468", 4, a, false);
+  memcpy(b, a, sizeof(b));
+  TEST_ASSERT_TRUE(pinHashEqual(a, b, PIN_HASH_BYTES));
+  TEST_ASSERT_TRUE(pinHashEqual(a, b, 0));
+  b[0] ^= 0x80;
+  TEST_ASSERT_FALSE(pinHashEqual(a, b, PIN_HASH_BYTES));
+  b[0] ^= 0x80;
+  b[PIN_HASH_BYTES - 1] ^= 0x01;
+  TEST_ASSERT_FALSE(pinHashEqual(a, b, PIN_HASH_BYTES));
+}
+
+// One PIN check against one user, as pinStoreBenchmark times it on the device; prints only
+void test_benchmark_salted_hash()
+{
+  uint8_t digest[PIN_HASH_BYTES];
+  volatile uint8_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_ROUNDS; i++)
+  {
+    pinHashSalted(salt, "00000000", 8, digest, false);
+    sink = sink + digest[0];
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  char line[96];
+  snprintf(line, sizeof(line), "Salted PIN hash (software SHA): %.0f ns per user", ns / BENCH_ROUNDS);
+  TEST_MESSAGE(line);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_software_sha256_vectors);
+  RUN_TEST(test_hardware_flag_gives_the_same_digest);
+  RUN_TEST(test_salted_hash_is_sha256_of_salt_then_digits);
+  RUN_TEST(test_salt_and_digits_both_change_the_hash);
+  RUN_TEST(test_equal_compares_every_byte);
+  RUN_TEST(test_benchmark_salted_hash);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include <unity.h>
+#include "../../src/pinLockout/pinLockout.h"
+
+static PinLockout lockout;
+
+// Rejects PIN_MAX_FAILURES entries in a row at now; returns whether the last one locked
+static bool failAll(uint32_t now)
+{
+  bool locked = false;
+  for (int i = 0; i < PIN_MAX_FAILURES; i++)
+  {
+    TEST_ASSERT_EQUAL(0, pinLockoutRemaining(lockout, now));
+    locked = pinLockoutFailure(lockout, now);
+  }
+  return locked;
+}
+
+void setUp()
+{
+  pinLockoutInit(lockout);
+}
+
+void tearDown()
+{
+}
+
+void test_starts_unlocked()
+{
+  TEST_ASSERT_EQUAL(0, pinLockoutRemaining(lockout, 0));
+  TEST_ASSERT_EQUAL(0, pinLockoutRemaining(lockout, 123456));
+}
+
+void test_locks_on_the_fifth_failure_in_a_row()
+{
+  for (int i = 0; i < PIN_MAX_FAILURES - 1; i++)
+  {
+    TEST_ASSERT_FALSE(pinLockoutFailure(lockout, 1000));
+  }
+  TEST_ASSERT_EQUAL(0, pinLockoutRemaining(lockout, 1000));
+  TEST_ASSERT_TRUE(pinLockoutFailure(lockout, 1000));
+  TEST_ASSERT_EQUAL(PIN_LOCKOUT_MS, pinLockoutRemaining(lockout, 1000));
+  TEST_ASSERT_EQUAL(PIN_LOCKOUT_MS, lockout.durationMs);
+}
+
+void test_lockout_counts_down_and_lifts()
+{
+  TEST_ASSERT_TRUE(failAll(1000));
+  TEST_ASSERT_EQUAL(PIN_LOCKOUT_MS - 10000, pinLockoutRemaining(lockout, 11000));
+  TEST_ASSERT_EQUAL(1, pinLockoutRemaining(lockout, 1000 + PIN_LOCKOUT_MS - 1));
+  TEST_ASSERT_EQUAL(0, pinLockoutRemaining(lockout, 1000 + PIN_LOCKOUT_MS));
+  TEST_ASSERT_FALSE(lockout.lockedOut);
+  // Once lifted it stays lifted, however far the clock goes on
+  TEST_ASSERT_EQUAL(0, pinLockoutRemaining(lockout, 1000 + PIN_LOCKOUT_MS + 1));
+}
+
+// The failures leading to a lockout must be consecutive
+void test_success_clears_the_failures()
+{
+  for (int i = 0; i < PIN_MAX_FAILURES - 1; i++)
+  {
+    pinLockoutFailure(lockout, 0);
+  }
+  pinLockoutSuccess(lockout);
+  for (int i = 0; i < PIN_MAX_FAILURES - 1; i++)
+  {
+    TEST_ASSERT_FALSE(pinLockoutFailure(lockout, 0));
+  }
+  TEST_ASSERT_EQUAL(0, pinLockoutRemaining(lockout, 0));
+}
+
+void test_each_further_lockout_doubles_up_to_the_cap()
+{
+  uint32_t now = 0;
+  uint32_t expected = PIN_LOCKOUT_MS;
+  for (int round = 0; round < 8; round++)
+  {
+    TEST_ASSERT_TRUE(failAll(now));
+    TEST_ASSERT_EQUAL(expected, lockout.durationMs);
+    TEST_ASSERT_EQUAL(expected, pinLockoutRemaining(lockout, now));
+    now += lockout.durationMs;
+    expected = expected * 2 > PIN_LOCKOUT_MAX_MS ? PIN_LOCKOUT_MAX_MS : expected * 2;
+  }
+  TEST_ASSERT_EQUAL(PIN_LOCKOUT_MAX_MS, lockout.durationMs);
+}
+
+void test_success_resets_the_doubling()
+{
+  TEST_ASSERT_TRUE(failAll(0));
+  TEST_ASSERT_TRUE(failAll(PIN_LOCKOUT_MS));
+  TEST_ASSERT_EQUAL(2 * PIN_LOCKOUT_MS, lockout.durationMs);
+  pinLockoutSuccess(lockout);
+  TEST_ASSERT_TRUE(failAll(10 * PIN_LOCKOUT_MS));
+  TEST_ASSERT_EQUAL(PIN_LOCKOUT_MS, lockout.durationMs);
+}
+
+// millis() wraps after 49.7 days; a lockout spanning the wrap must still last its full time
+void test_lockout_across_the_clock_wrap()
+{
+  uint32_t start = 0xFFFFFFFF - 5000;
+  TEST_ASSERT_TRUE(failAll(start));
+  TEST_ASSERT_EQUAL(PIN_LOCKOUT_MS - 10000, pinLockoutRemaining(lockout, start + 10000));
+  TEST_ASSERT_EQUAL(0, pinLockoutRemaining(lockout, start + PIN_LOCKOUT_MS));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_starts_unlocked);
+  RUN_TEST(test_locks_on_the_fifth_failure_in_a_row);
+  RUN_TEST(test_lockout_counts_down_and_lifts);
+  RUN_TEST(test_success_clears_the_failures);
+  RUN_TEST(test_each_further_lockout_doubles_up_to_the_cap);
+  RUN_TEST(test_success_resets_the_doubling);
+  RUN_TEST(test_lockout_across_the_clock_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,403 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// The handlers are static, so the suite builds the channel into itself and drives the task a
+// pass at a time, with the server's side of the socket played from recorded Phoenix frames
+#include "../../src/realtimeChannel/realtimeChannel.cpp"
+
+unsigned long mockMicros = 0;
+MockSocket mockSocket;
+SemaphoreHandle_t xSupabaseMutex = NULL;
+
+struct AppliedRow
+{
+  std::string name;
+  std::string status;
+  std::string updatedAt;
+};
+
+static std::vector<AppliedRow> appliedRows;
+static size_t readOffset; // Start of the next client frame in mockSocket.written
+static uint32_t sessionGeneration;
+static char sessionToken[32];
+static bool wifiUp;
+static int loggedErrors;
+
+uint8_t logLevel(LogModule)
+{
+  return LOG_LEVEL_WARN;
+}
+
+void logRecord(uint8_t level, LogModule, const char *, const uintptr_t *, int, const char *)
+{
+  loggedErrors += level >= LOG_LEVEL_ERROR;
+}
+
+const char *supabaseHost()
+{
+  return "project.supabase.co";
+}
+
+const char *supabaseApiKey()
+{
+  return "anon-key";
+}
+
+bool supabaseSessionValid()
+{
+  return sessionToken[0] != '\0';
+}
+
+uint32_t supabaseSessionToken(char *out, size_t size)
+{
+  snprintf(out, size, "%s", sessionToken);
+  return sessionGeneration;
+}
+
+bool wifiManagerConnected()
+{
+  return wifiUp;
+}
+
+bool configSyncApply(const char *name, const char *status, const char *updatedAt)
+{
+  appliedRows.push_back({name ? name : "", status ? status : "", updatedAt ? updatedAt : ""});
+  return name != NULL && status != NULL;
+}
+
+int taskMonitorRegister(const char *, uint32_t, uint32_t, bool)
+{
+  return 0;
+}
+
+void taskMonitorCheckIn(int)
+{
+}
+
+static const char *handshake = "HTTP/1.1 101 Switching Protocols\r\n"
+                               "Upgrade: websocket\r\n"
+                               "Connection: Upgrade\r\n"
+                               "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+
+// Recorded from a project with the sensor_data table in the supabase_realtime publication
+static const char *insertEvent =
+    "{\"event\":\"postgres_changes\",\"payload\":{\"data\":{\"columns\":[{\"name\":\"id\",\"type\":\"int8\"},"
+    "{\"name\":\"created_at\",\"type\":\"timestamptz\"},{\"name\":\"name\",\"type\":\"text\"},"
+    "{\"name\":\"status\",\"type\":\"text\"},{\"name\":\"value\",\"type\":\"int4\"},"
+    "{\"name\":\"updated_at\",\"type\":\"timestamptz\"}],\"commit_timestamp\":\"2026-10-17T08:00:01.127Z\","
+    "\"errors\":null,\"record\":{\"created_at\":\"2026-10-17T08:00:01.123456+00:00\",\"id\":7,\"name\":\"siren\","
+    "\"status\":\"off\",\"updated_at\":\"2026-10-17T08:00:01.123456+00:00\",\"value\":null},\"schema\":\"public\","
+    "\"table\":\"sensor_data\",\"type\":\"INSERT\"},\"ids\":[38211541]},\"ref\":null,\"topic\":\"realtime:sensor_data\"}";
+
+static const char *updateEvent =
+    "{\"event\":\"postgres_changes\",\"payload\":{\"data\":{\"columns\":[{\"name\":\"id\",\"type\":\"int8\"},"
+    "{\"name\":\"created_at\",\"type\":\"timestamptz\"},{\"name\":\"name\",\"type\":\"text\"},"
+    "{\"name\":\"status\",\"type\":\"text\"},{\"name\":\"value\",\"type\":\"int4\"},"
+    "{\"name\":\"updated_at\",\"type\":\"timestamptz\"}],\"commit_timestamp\":\"2026-10-17T08:00:02.51Z\","
+    "\"errors\":null,\"old_record\":{\"id\":3},\"record\":{\"created_at\":\"2024-03-02T10:11:12.345678+00:00\","
+    "\"id\":3,\"name\":\"keypad\",\"status\":\"on\",\"updated_at\":\"2026-10-17T08:00:02.5+00:00\",\"value\":1},"
+    "\"schema\":\"public\",\"table\":\"sensor_data\",\"type\":\"UPDATE\"},\"ids\":[38211541]},\"ref\":null,"
+    "\"topic\":\"realtime:sensor_data\"}";
+
+static const char *channelError =
+    "{\"event\":\"phx_error\",\"payload\":{},\"ref\":\"1\",\"topic\":\"realtime:sensor_data\"}";
+
+// Queues one unmasked frame from the server, as Phoenix sends them
+static void serverFrame(uint8_t opcode, const char *payload, size_t length)
+{
+  std::string &in = mockSocket.incoming;
+  in += (char)(0x80 | opcode);
+  if (length < 126)
+  {
+    in += (char)length;
+  }
+  else
+  {
+    in += (char)126;
+    in += (char)(length >> 8);
+    in += (char)(length & 0xFF);
+  }
+  in.append(payload, length);
+}
+
+static void serverSends(const char *text)
+{
+  serverFrame(WS_OPCODE_TEXT, text, strlen(text));
+}
+
+static void joinReply(const char *status)
+{
+  char reply[320];
+  snprintf(reply, sizeof(reply),
+           "{\"event\":\"phx_reply\",\"payload\":{\"response\":{\"postgres_changes\":[{\"event\":\"*\","
+           "\"filter\":\"\",\"id\":38211541,\"schema\":\"public\",\"table\":\"sensor_data\"}]},\"status\":\"%s\"},"
+           "\"ref\":\"%u\",\"topic\":\"realtime:sensor_data\"}",
+           status, joinRef);
+  serverSends(reply);
+}
+
+// Next frame the client sent, unmasked; empty when there is none. Each must be masked
+static std::string clientFrame(uint8_t *opcode = NULL)
+{
+  const std::string &out = mockSocket.written;
+  if (out.size() < readOffset + 2)
+  {
+    return "";
+  }
+  const uint8_t *head = (const uint8_t *)&out[readOffset];
+  WsFrameHeader header;
+  wsFrameDecodeHeader(head, header);
+  size_t start = readOffset + wsFrameHeaderBytes(head);
+  TEST_ASSERT_TRUE(header.masked);
+  TEST_ASSERT_TRUE(header.fin);
+  TEST_ASSERT_LESS_OR_EQUAL(out.size(), start + header.length);
+  std::string payload = out.substr(start, header.length);
+  wsFrameMask((uint8_t *)&payload[0], payload.size(), header.mask);
+  readOffset = start + header.length;
+  if (opcode != NULL)
+  {
+    *opcode = header.opcode;
+  }
+  return payload;
+}
+
+static bool contains(const std::string &text, const char *part)
+{
+  return text.find(part) != std::string::npos;
+}
+
+// Opens the socket through the handshake; returns the join message
+static std::string connectChannel()
+{
+  mockSocket.incoming = handshake;
+  mockSocket.position = 0;
+  realtimeStep();
+  TEST_ASSERT_TRUE(connected);
+  size_t request = mockSocket.written.find("\r\n\r\n", readOffset);
+  TEST_ASSERT_TRUE(request != std::string::npos);
+  readOffset = request + 4;
+  return clientFrame();
+}
+
+static void subscribe()
+{
+  connectChannel();
+  joinReply("ok");
+  realtimeStep();
+  TEST_ASSERT_TRUE(realtimeLive());
+}
+
+static void advanceMs(unsigned long ms)
+{
+  mockMicros += ms * 1000;
+}
+
+void setUp()
+{
+  if (connected)
+  {
+    client->stop();
+  }
+  connected = false;
+  live = false;
+  joins = 0;
+  joinRef = 0;
+  backoffMs = 0;
+  nextConnectAt = 0;
+  stats = RealtimeStats();
+  mockSocket = MockSocket();
+  mockMicros = 1000000;
+  readOffset = 0;
+  appliedRows.clear();
+  sessionGeneration = 1;
+  snprintf(sessionToken, sizeof(sessionToken), "token-1");
+  wifiUp = true;
+  loggedErrors = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_handshake_then_join_with_the_session_token()
+{
+  std::string join = connectChannel();
+
+  TEST_ASSERT_EQUAL_STRING("project.supabase.co", mockSocket.host.c_str());
+  TEST_ASSERT_EQUAL(443, mockSocket.port);
+  TEST_ASSERT_EQUAL(0, mockSocket.written.find("GET /realtime/v1/websocket?apikey=anon-key&vsn=1.0.0 HTTP/1.1\r\n"));
+  TEST_ASSERT_TRUE(contains(mockSocket.written, "Sec-WebSocket-Version: 13\r\n"));
+  TEST_ASSERT_TRUE(contains(join, "\"topic\":\"realtime:sensor_data\",\"event\":\"phx_join\""));
+  TEST_ASSERT_TRUE(contains(join, "\"table\":\"sensor_data\""));
+  TEST_ASSERT_TRUE(contains(join, "\"access_token\":\"token-1\""));
+  TEST_ASSERT_FALSE(realtimeLive());
+  TEST_ASSERT_EQUAL(1, realtimeStats().connects);
+}
+
+void test_join_reply_makes_the_channel_live()
+{
+  connectChannel();
+  uint32_t before = realtimeJoins();
+  joinReply("ok");
+  realtimeStep();
+
+  TEST_ASSERT_TRUE(realtimeLive());
+  TEST_ASSERT_EQUAL(before + 1, realtimeJoins());
+  TEST_ASSERT_EQUAL(0, joinRef);
+  TEST_ASSERT_EQUAL(1, realtimeStats().frames);
+}
+
+void test_refused_join_falls_back_to_polling()
+{
+  connectChannel();
+  joinReply("error");
+  realtimeStep();
+
+  TEST_ASSERT_FALSE(realtimeLive());
+  TEST_ASSERT_FALSE(connected);
+  TEST_ASSERT_EQUAL(1, loggedErrors);
+  TEST_ASSERT_TRUE((long)(nextConnectAt - millis()) >= REALTIME_BACKOFF_MIN_MS);
+}
+
+void test_insert_and_update_reach_config_sync()
+{
+  subscribe();
+  serverSends(insertEvent);
+  serverSends(updateEvent);
+  realtimeStep();
+
+  TEST_ASSERT_EQUAL(2, (int)appliedRows.size());
+  TEST_ASSERT_EQUAL_STRING("siren", appliedRows[0].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("off", appliedRows[0].status.c_str());
+  TEST_ASSERT_EQUAL_STRING("2026-10-17T08:00:01.123456+00:00", appliedRows[0].updatedAt.c_str());
+  TEST_ASSERT_EQUAL_STRING("keypad", appliedRows[1].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("on", appliedRows[1].status.c_str());
+  TEST_ASSERT_EQUAL_STRING("2026-10-17T08:00:02.5+00:00", appliedRows[1].updatedAt.c_str());
+  TEST_ASSERT_EQUAL(2, realtimeStats().events);
+  TEST_ASSERT_EQUAL(2, realtimeStats().applied);
+  TEST_ASSERT_TRUE(realtimeLive());
+}
+
+void test_heartbeat_carries_a_renewed_token()
+{
+  subscribe();
+
+  advanceMs(REALTIME_HEARTBEAT_MS);
+  realtimeStep();
+  std::string heartbeat = clientFrame();
+  TEST_ASSERT_TRUE(contains(heartbeat, "\"topic\":\"phoenix\",\"event\":\"heartbeat\""));
+  TEST_ASSERT_EQUAL_STRING("", clientFrame().c_str()); // Same session, no token message
+
+  // The heartbeat reply is not the join's, so it changes nothing but the silence timer
+  char reply[160];
+  unsigned ref = strtoul(&heartbeat[heartbeat.find("\"ref\":\"") + 7], NULL, 10);
+  snprintf(reply, sizeof(reply),
+           "{\"event\":\"phx_reply\",\"payload\":{\"response\":{},\"status\":\"ok\"},\"ref\":\"%u\",\"topic\":\"phoenix\"}",
+           ref);
+  serverSends(reply);
+  uint32_t before = realtimeJoins();
+  realtimeStep();
+  TEST_ASSERT_EQUAL(before, realtimeJoins());
+
+  sessionGeneration++;
+  snprintf(sessionToken, sizeof(sessionToken), "token-2");
+  advanceMs(REALTIME_HEARTBEAT_MS);
+  realtimeStep();
+  TEST_ASSERT_TRUE(contains(clientFrame(), "\"event\":\"heartbeat\""));
+  std::string renewal = clientFrame();
+  TEST_ASSERT_TRUE(contains(renewal, "\"topic\":\"realtime:sensor_data\",\"event\":\"access_token\""));
+  TEST_ASSERT_TRUE(contains(renewal, "\"access_token\":\"token-2\""));
+  TEST_ASSERT_TRUE(realtimeLive());
+}
+
+void test_silent_socket_is_dropped()
+{
+  subscribe();
+  advanceMs(REALTIME_SILENCE_MS);
+  realtimeStep();
+
+  TEST_ASSERT_FALSE(realtimeLive());
+  TEST_ASSERT_FALSE(connected);
+  TEST_ASSERT_EQUAL(1, realtimeStats().drops);
+}
+
+void test_channel_error_drops_to_polling()
+{
+  subscribe();
+  serverSends(channelError);
+  serverSends(insertEvent); // Never read; the socket is gone
+  realtimeStep();
+
+  TEST_ASSERT_FALSE(realtimeLive());
+  TEST_ASSERT_FALSE(connected);
+  TEST_ASSERT_FALSE(mockSocket.open);
+  TEST_ASSERT_EQUAL(1, realtimeStats().drops);
+  TEST_ASSERT_EQUAL(0, (int)appliedRows.size());
+
+  // Reconnects after the backoff and subscribes again
+  advanceMs(REALTIME_BACKOFF_MIN_MS * 5 / 4 + 1);
+  subscribe();
+  TEST_ASSERT_EQUAL(2, realtimeStats().joins);
+}
+
+void test_close_frame_is_echoed()
+{
+  subscribe();
+  static const char code[] = {0x03, (char)0xE8, 'b', 'y', 'e'};
+  serverFrame(WS_OPCODE_CLOSE, code, sizeof(code));
+  realtimeStep();
+
+  uint8_t opcode = 0;
+  std::string echo = clientFrame(&opcode);
+  TEST_ASSERT_EQUAL(WS_OPCODE_CLOSE, opcode);
+  TEST_ASSERT_EQUAL(2, (int)echo.size());
+  TEST_ASSERT_EQUAL(WS_CLOSE_NORMAL, wsFrameCloseCode((const uint8_t *)echo.data(), echo.size()));
+  TEST_ASSERT_FALSE(connected);
+  TEST_ASSERT_FALSE(realtimeLive());
+}
+
+void test_ping_is_answered_with_its_payload()
+{
+  subscribe();
+  serverFrame(WS_OPCODE_PING, "beat", 4);
+  realtimeStep();
+
+  uint8_t opcode = 0;
+  TEST_ASSERT_EQUAL_STRING("beat", clientFrame(&opcode).c_str());
+  TEST_ASSERT_EQUAL(WS_OPCODE_PONG, opcode);
+  TEST_ASSERT_TRUE(realtimeLive());
+}
+
+void test_refused_handshake_backs_off()
+{
+  mockSocket.incoming = "HTTP/1.1 401 Unauthorized\r\nContent-Length: 0\r\n\r\n";
+  realtimeStep();
+  TEST_ASSERT_FALSE(connected);
+  TEST_ASSERT_EQUAL(0, realtimeStats().connects);
+
+  // Not before the backoff has passed
+  mockSocket.incoming = handshake;
+  mockSocket.position = 0;
+  realtimeStep();
+  TEST_ASSERT_FALSE(connected);
+}
+
+int main()
+{
+  realtimeBegin("sensor_data");
+  UNITY_BEGIN();
+  RUN_TEST(test_handshake_then_join_with_the_session_token);
+  RUN_TEST(test_join_reply_makes_the_channel_live);
+  RUN_TEST(test_refused_join_falls_back_to_polling);
+  RUN_TEST(test_insert_and_update_reach_config_sync);
+  RUN_TEST(test_heartbeat_carries_a_renewed_token);
+  RUN_TEST(test_silent_socket_is_dropped);
+  RUN_TEST(test_channel_error_drops_to_polling);
+  RUN_TEST(test_close_frame_is_echoed);
+  RUN_TEST(test_ping_is_answered_with_its_payload);
+  RUN_TEST(test_refused_handshake_backs_off);
+  return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <unity.h>
+#include "../../src/sensorReporter/sensorReporter.h"
+
+// Same windows as the motion sensor
+#define DEBOUNCE_MS 100
+#define HEARTBEAT_MS 60000
+
+static DigitalReporter reporter;
+
+// Feeds one level every stepMs from `from` up to, not including, `to`; counts the passes giving reason
+static int countReports(int level, unsigned long from, unsigned long to, unsigned long stepMs, ReportReason reason)
+{
+  int count = 0;
+  for (unsigned long now = from; now < to; now += stepMs)
+  {
+    count += digitalReporterUpdate(reporter, level, now) == reason;
+  }
+  return count;
+}
+
+void setUp()
+{
+  digitalReporterInit(reporter, DEBOUNCE_MS, HEARTBEAT_MS);
+}
+
+void tearDown()
+{
+}
+
+void test_first_level_settles_after_the_debounce_time()
+{
+  TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, 0, 1000));
+  TEST_ASSERT_EQUAL(-1, reporter.stableLevel);
+  TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, 0, 1000 + DEBOUNCE_MS - 1));
+  TEST_ASSERT_EQUAL(REPORT_CHANGE, digitalReporterUpdate(reporter, 0, 1000 + DEBOUNCE_MS));
+  TEST_ASSERT_EQUAL(0, reporter.stableLevel);
+}
+
+void test_glitch_shorter_than_the_debounce_is_ignored()
+{
+  digitalReporterUpdate(reporter, 0, 0);
+  digitalReporterUpdate(reporter, 0, DEBOUNCE_MS);
+  TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, 1, 1000));
+  TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, 1, 1040));
+  TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, 0, 1050));
+  TEST_ASSERT_EQUAL(0, countReports(0, 1060, 2000, 10, REPORT_CHANGE));
+  TEST_ASSERT_EQUAL(0, reporter.stableLevel);
+}
+
+// A bouncing edge restarts the window each time the raw level moves
+void test_bounce_restarts_the_window()
+{
+  digitalReporterUpdate(reporter, 0, 0);
+  digitalReporterUpdate(reporter, 0, DEBOUNCE_MS);
+  digitalReporterUpdate(reporter, 1, 1000);
+  digitalReporterUpdate(reporter, 0, 1030);
+  digitalReporterUpdate(reporter, 1, 1060);
+  TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, 1, 1000 + DEBOUNCE_MS));
+  TEST_ASSERT_EQUAL(REPORT_CHANGE, digitalReporterUpdate(reporter, 1, 1060 + DEBOUNCE_MS));
+}
+
+void test_change_is_reported_once()
+{
+  digitalReporterUpdate(reporter, 0, 0);
+  digitalReporterUpdate(reporter, 0, DEBOUNCE_MS);
+  TEST_ASSERT_EQUAL(1, countReports(1, 1000, 5000, 10, REPORT_CHANGE));
+  TEST_ASSERT_EQUAL(1, reporter.stableLevel);
+}
+
+void test_heartbeat_resends_an_unchanged_level()
+{
+  digitalReporterUpdate(reporter, 0, 0);
+  digitalReporterUpdate(reporter, 0, DEBOUNCE_MS);
+  TEST_ASSERT_EQUAL(0, countReports(0, DEBOUNCE_MS + 50, DEBOUNCE_MS + HEARTBEAT_MS, 50, REPORT_HEARTBEAT));
+  TEST_ASSERT_EQUAL(REPORT_HEARTBEAT, digitalReporterUpdate(reporter, 0, DEBOUNCE_MS + HEARTBEAT_MS));
+  // And every heartbeat period after that, from the last one sent
+  TEST_ASSERT_EQUAL(4, countReports(0, DEBOUNCE_MS + HEARTBEAT_MS + 50, DEBOUNCE_MS + 5 * HEARTBEAT_MS + 50, 50,
+                                    REPORT_HEARTBEAT));
+}
+
+void test_no_heartbeat_before_the_first_level_settles()
+{
+  // The level never holds still for the debounce time, so there is nothing to resend
+  for (unsigned long now = 0; now < 2 * HEARTBEAT_MS; now += 50)
+  {
+    TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, (now / 50) & 1, now));
+  }
+  TEST_ASSERT_EQUAL(-1, reporter.stableLevel);
+}
+
+void test_change_restarts_the_heartbeat()
+{
+  digitalReporterUpdate(reporter, 0, 0);
+  digitalReporterUpdate(reporter, 0, DEBOUNCE_MS);
+  digitalReporterUpdate(reporter, 1, 30000);
+  TEST_ASSERT_EQUAL(REPORT_CHANGE, digitalReporterUpdate(reporter, 1, 30000 + DEBOUNCE_MS));
+  TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, 1, DEBOUNCE_MS + HEARTBEAT_MS));
+  TEST_ASSERT_EQUAL(REPORT_HEARTBEAT, digitalReporterUpdate(reporter, 1, 30000 + DEBOUNCE_MS + HEARTBEAT_MS));
+}
+
+// An interrupt-captured edge can be stamped before the report the sensor pass just made
+void test_edge_stamped_before_the_last_report_is_not_a_heartbeat()
+{
+  digitalReporterUpdate(reporter, 0, 0);
+  digitalReporterUpdate(reporter, 0, 1000);
+  TEST_ASSERT_EQUAL(REPORT_NONE, digitalReporterUpdate(reporter, 0, 995));
+}
+
+void test_zero_debounce_reports_at_once()
+{
+  digitalReporterInit(reporter, 0, HEARTBEAT_MS);
+  TEST_ASSERT_EQUAL(REPORT_CHANGE, digitalReporterUpdate(reporter, 0, 500));
+  TEST_ASSERT_EQUAL(REPORT_CHANGE, digitalReporterUpdate(reporter, 1, 510));
+  TEST_ASSERT_EQUAL(REPORT_CHANGE, digitalReporterUpdate(reporter, 0, 520));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_first_level_settles_after_the_debounce_time);
+  RUN_TEST(test_glitch_shorter_than_the_debounce_is_ignored);
+  RUN_TEST(test_bounce_restarts_the_window);
+  RUN_TEST(test_change_is_reported_once);
+  RUN_TEST(test_heartbeat_resends_an_unchanged_level);
+  RUN_TEST(test_no_heartbeat_before_the_first_level_settles);
+  RUN_TEST(test_change_restarts_the_heartbeat);
+  RUN_TEST(test_edge_stamped_before_the_last_report_is_not_a_heartbeat);
+  RUN_TEST(test_zero_debounce_reports_at_once);
+  return UNITY_END();
+}
@@ -0,0 +1,214 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "../../src/uidTable/uidTable.h"
+
+#define BENCH_ROUNDS 200
+
+static UidTable table;
+static uint8_t uids[UID_TABLE_MAX_ENTRIES + 1][UID_MAX_LENGTH];
+static uint8_t lengths[UID_TABLE_MAX_ENTRIES + 1];
+static bool present[UID_TABLE_MAX_ENTRIES + 1];
+static uint32_t seed;
+
+static uint8_t nextByte()
+{
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 24;
+}
+
+// Distinct random cards with the 4, 7 and 10 byte UID lengths of ISO 14443, from a fixed seed
+static void makeCards()
+{
+  static const uint8_t sizes[] = {4, 7, 10};
+  seed = 1;
+  for (int i = 0; i <= UID_TABLE_MAX_ENTRIES; i++)
+  {
+    lengths[i] = sizes[i % 3];
+    for (uint8_t b = 0; b < lengths[i]; b++)
+    {
+      uids[i][b] = nextByte();
+    }
+    uids[i][0] = i & 0xFF; // The first two bytes make every card unique
+    uids[i][1] = i >> 8;
+  }
+}
+
+static void fillTable(int count)
+{
+  uidTableClear(table);
+  for (int i = 0; i < count; i++)
+  {
+    TEST_ASSERT_TRUE(uidTableInsert(table, uids[i], lengths[i]));
+    present[i] = true;
+  }
+  for (int i = count; i <= UID_TABLE_MAX_ENTRIES; i++)
+  {
+    present[i] = false;
+  }
+}
+
+static void assertMatchesReference()
+{
+  uint16_t count = 0;
+  for (int i = 0; i <= UID_TABLE_MAX_ENTRIES; i++)
+  {
+    TEST_ASSERT_EQUAL(present[i], uidTableContains(table, uids[i], lengths[i]));
+    count += present[i];
+  }
+  TEST_ASSERT_EQUAL(count, table.count);
+}
+
+void setUp()
+{
+  makeCards();
+  uidTableClear(table);
+}
+
+void tearDown()
+{
+}
+
+void test_insert_then_lookup()
+{
+  fillTable(100);
+  assertMatchesReference();
+}
+
+void test_insert_is_idempotent()
+{
+  fillTable(10);
+  TEST_ASSERT_TRUE(uidTableInsert(table, uids[3], lengths[3]));
+  TEST_ASSERT_EQUAL(10, table.count);
+}
+
+void test_length_is_part_of_the_key()
+{
+  const uint8_t uid[UID_MAX_LENGTH] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+  TEST_ASSERT_TRUE(uidTableInsert(table, uid, 7));
+  TEST_ASSERT_FALSE(uidTableContains(table, uid, 4));
+  TEST_ASSERT_TRUE(uidTableContains(table, uid, 7));
+}
+
+void test_bad_lengths_are_rejected()
+{
+  const uint8_t uid[UID_MAX_LENGTH + 1] = {0};
+  TEST_ASSERT_FALSE(uidTableInsert(table, uid, 0));
+  TEST_ASSERT_FALSE(uidTableInsert(table, uid, UID_MAX_LENGTH + 1));
+  TEST_ASSERT_FALSE(uidTableContains(table, uid, UID_MAX_LENGTH + 1));
+  TEST_ASSERT_EQUAL(0, table.count);
+}
+
+void test_full_table_refuses_new_cards()
+{
+  fillTable(UID_TABLE_MAX_ENTRIES);
+  TEST_ASSERT_FALSE(uidTableInsert(table, uids[UID_TABLE_MAX_ENTRIES], lengths[UID_TABLE_MAX_ENTRIES]));
+  TEST_ASSERT_TRUE(uidTableInsert(table, uids[0], lengths[0])); // Already present, so still fine
+  TEST_ASSERT_EQUAL(UID_TABLE_MAX_ENTRIES, table.count);
+  assertMatchesReference();
+
+  // Removing one makes room again
+  TEST_ASSERT_TRUE(uidTableRemove(table, uids[7], lengths[7]));
+  present[7] = false;
+  TEST_ASSERT_TRUE(uidTableInsert(table, uids[UID_TABLE_MAX_ENTRIES], lengths[UID_TABLE_MAX_ENTRIES]));
+  present[UID_TABLE_MAX_ENTRIES] = true;
+  assertMatchesReference();
+}
+
+// Backward-shift removal must keep every remaining card reachable, however the clusters fall
+void test_removal_keeps_probe_chains_intact()
+{
+  fillTable(UID_TABLE_MAX_ENTRIES);
+  seed = 7;
+  for (int round = 0; round < 3000; round++)
+  {
+    int i = ((uint32_t)nextByte() << 8 | nextByte()) % (UID_TABLE_MAX_ENTRIES + 1);
+    if (present[i])
+    {
+      TEST_ASSERT_TRUE(uidTableRemove(table, uids[i], lengths[i]));
+      present[i] = false;
+    }
+    else
+    {
+      TEST_ASSERT_FALSE(uidTableRemove(table, uids[i], lengths[i]));
+      present[i] = uidTableInsert(table, uids[i], lengths[i]);
+      TEST_ASSERT_TRUE(present[i] || table.count == UID_TABLE_MAX_ENTRIES);
+    }
+  }
+  assertMatchesReference();
+}
+
+void test_next_visits_every_card_once()
+{
+  fillTable(500);
+  int visited = 0;
+  for (int slot = uidTableNext(table, 0); slot >= 0; slot = uidTableNext(table, slot + 1))
+  {
+    visited++;
+  }
+  TEST_ASSERT_EQUAL(500, visited);
+}
+
+void test_parse_hex()
+{
+  uint8_t uid[UID_MAX_LENGTH];
+  uint8_t length;
+  const uint8_t expected[] = {0x7A, 0x77, 0xC7, 0xB2};
+  TEST_ASSERT_TRUE(uidParseHex("7A 77 C7 B2", uid, length));
+  TEST_ASSERT_EQUAL(4, length);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, uid, 4);
+  TEST_ASSERT_TRUE(uidParseHex("7a:77:c7:b2", uid, length));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, uid, 4);
+  TEST_ASSERT_FALSE(uidParseHex("7A77C7B", uid, length));   // Odd digit count
+  TEST_ASSERT_FALSE(uidParseHex("7A77C7BG", uid, length));  // Bad digit
+  TEST_ASSERT_FALSE(uidParseHex("", uid, length));
+  TEST_ASSERT_FALSE(uidParseHex("0011223344556677889900", uid, length)); // 11 bytes
+}
+
+// Lookups at full load, where probes are longest, and full rebuilds as a sync does; prints only
+void test_benchmark_lookup_and_rebuild()
+{
+  fillTable(UID_TABLE_MAX_ENTRIES);
+  volatile int found = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    for (int i = 0; i <= UID_TABLE_MAX_ENTRIES; i++)
+    {
+      found = found + uidTableContains(table, uids[i], lengths[i]);
+    }
+  }
+  double lookupNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    uidTableClear(table);
+    for (int i = 0; i < UID_TABLE_MAX_ENTRIES; i++)
+    {
+      uidTableInsert(table, uids[i], lengths[i]);
+    }
+  }
+  double rebuildNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  char line[128];
+  snprintf(line, sizeof(line), "%d cards: %.1f ns per lookup, %.1f us per full rebuild", UID_TABLE_MAX_ENTRIES,
+           lookupNs / BENCH_ROUNDS / (UID_TABLE_MAX_ENTRIES + 1), rebuildNs / BENCH_ROUNDS / 1000);
+  TEST_MESSAGE(line);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_insert_then_lookup);
+  RUN_TEST(test_insert_is_idempotent);
+  RUN_TEST(test_length_is_part_of_the_key);
+  RUN_TEST(test_bad_lengths_are_rejected);
+  RUN_TEST(test_full_table_refuses_new_cards);
+  RUN_TEST(test_removal_keeps_probe_chains_intact);
+  RUN_TEST(test_next_visits_every_card_once);
+  RUN_TEST(test_parse_hex);
+  RUN_TEST(test_benchmark_lookup_and_rebuild);
+  return UNITY_END();
+}
@@ -0,0 +1,284 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include "../../src/vibrationKernel/vibrationKernel.h"
+
+// Same block size, rate and thresholds as the sampler and the alarm logic on the device
+#define SAMPLE_RATE 8000
+#define BLOCK_SAMPLES 256
+#define TRACE_BLOCKS 64
+#define NOISE_PEAK 40
+
+static const VibrationThresholds thresholds = {4000, 3700, 1000};
+
+static uint16_t trace[TRACE_BLOCKS * BLOCK_SAMPLES];
+static bool hits[TRACE_BLOCKS];
+static uint32_t seed;
+
+// Fixed-seed generator, so every run replays the same trace
+static int noise(int peak)
+{
+  seed = seed * 1664525 + 1013904223;
+  return (int)(seed >> 16) % (2 * peak + 1) - peak;
+}
+
+static uint16_t clampSample(int sample)
+{
+  return sample < 0 ? 0 : sample > VIBRATION_SAMPLE_MASK ? VIBRATION_SAMPLE_MASK : sample;
+}
+
+// The piezo at rest: a small rectified noise floor
+static void quietTrace()
+{
+  seed = 1;
+  for (size_t i = 0; i < sizeof(trace) / sizeof(trace[0]); i++)
+  {
+    trace[i] = clampSample(noise(NOISE_PEAK));
+  }
+}
+
+// A knock: a 200 Hz ring that decays linearly over lengthMs; a hard one clips at full scale
+static void addImpact(uint32_t atMs, uint32_t lengthMs, int amplitude)
+{
+  uint32_t start = atMs * SAMPLE_RATE / 1000;
+  uint32_t length = lengthMs * SAMPLE_RATE / 1000;
+  for (uint32_t t = 0; t < length && start + t < sizeof(trace) / sizeof(trace[0]); t++)
+  {
+    double envelope = amplitude * (1.0 - (double)t / length);
+    double ring = fabs(sin(2 * M_PI * 200 * t / SAMPLE_RATE));
+    trace[start + t] = clampSample(trace[start + t] + (int)(envelope * ring));
+  }
+}
+
+// Feeds the trace block by block, as the sampler task does, and records the detector output
+static int replay()
+{
+  VibrationDetector detector;
+  vibrationDetectorInit(detector, thresholds);
+  int count = 0;
+  for (int b = 0; b < TRACE_BLOCKS; b++)
+  {
+    hits[b] = vibrationDetectorUpdate(detector, &trace[b * BLOCK_SAMPLES], BLOCK_SAMPLES);
+    count += hits[b];
+  }
+  return count;
+}
+
+static int firstHit()
+{
+  for (int b = 0; b < TRACE_BLOCKS; b++)
+  {
+    if (hits[b])
+    {
+      return b;
+    }
+  }
+  return -1;
+}
+
+static int lastHit()
+{
+  for (int b = TRACE_BLOCKS - 1; b >= 0; b--)
+  {
+    if (hits[b])
+    {
+      return b;
+    }
+  }
+  return -1;
+}
+
+static int blockAt(uint32_t ms)
+{
+  return ms * SAMPLE_RATE / 1000 / BLOCK_SAMPLES;
+}
+
+// Straightforward per-sample version of the unrolled kernel
+static void referenceFeatures(const uint16_t *samples, size_t count, VibrationFeatures &out)
+{
+  uint64_t energy = 0;
+  uint16_t peak = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    uint16_t s = samples[i] & VIBRATION_SAMPLE_MASK;
+    energy += (uint64_t)s * s;
+    peak = s > peak ? s : peak;
+  }
+  out.peak = peak;
+  out.energy = energy;
+  out.samples = count;
+  out.rms = count ? (uint16_t)sqrt((double)(energy / count)) : 0;
+}
+
+void setUp()
+{
+  quietTrace();
+}
+
+void tearDown()
+{
+}
+
+void test_isqrt_matches_floor_sqrt()
+{
+  const uint64_t values[] = {0, 1, 2, 3, 4, 15, 16, 17, 4095ull * 4095, 4095ull * 4095 - 1, 0xFFFFFFFFull,
+                             0xFFFFFFFFFFFFFFFFull};
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+  {
+    uint64_t root = vibrationIsqrt(values[i]);
+    TEST_ASSERT_TRUE(root * root <= values[i]);
+    TEST_ASSERT_TRUE((root + 1) * (root + 1) > values[i] || root == 0xFFFFFFFF);
+  }
+}
+
+void test_block_features_match_reference()
+{
+  // Lengths around the unroll and partial-sum boundaries, over full-scale samples
+  const size_t lengths[] = {0, 1, 3, 4, 5, 63, 64, 65, 127, 255, 256, 1000};
+  for (size_t i = 0; i < sizeof(trace) / sizeof(trace[0]); i++)
+  {
+    trace[i] = clampSample(2048 + noise(2048));
+  }
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+  {
+    VibrationFeatures got;
+    VibrationFeatures want;
+    vibrationBlockFeatures(trace, lengths[i], got);
+    referenceFeatures(trace, lengths[i], want);
+    TEST_ASSERT_EQUAL_UINT16(want.peak, got.peak);
+    TEST_ASSERT_EQUAL_UINT16(want.rms, got.rms);
+    TEST_ASSERT_EQUAL_UINT64(want.energy, got.energy);
+    TEST_ASSERT_EQUAL_UINT32(want.samples, got.samples);
+  }
+}
+
+void test_channel_bits_are_masked()
+{
+  uint16_t tagged[BLOCK_SAMPLES];
+  for (int i = 0; i < BLOCK_SAMPLES; i++)
+  {
+    tagged[i] = 0x7000 | trace[i]; // The I2S ADC puts the channel number in the top bits
+  }
+  VibrationFeatures plain;
+  VibrationFeatures masked;
+  vibrationBlockFeatures(trace, BLOCK_SAMPLES, plain);
+  vibrationBlockFeatures(tagged, BLOCK_SAMPLES, masked);
+  TEST_ASSERT_EQUAL_UINT16(plain.peak, masked.peak);
+  TEST_ASSERT_EQUAL_UINT64(plain.energy, masked.energy);
+}
+
+void test_quiet_trace_never_hits()
+{
+  TEST_ASSERT_EQUAL(0, replay());
+}
+
+void test_single_noisy_sample_is_ignored()
+{
+  trace[blockAt(500) * BLOCK_SAMPLES + 17] = VIBRATION_SAMPLE_MASK;
+  TEST_ASSERT_EQUAL(0, replay());
+}
+
+void test_knock_raises_one_hit()
+{
+  addImpact(500, 150, 6000);
+  TEST_ASSERT_GREATER_THAN(0, replay());
+
+  // The hit starts within a block of the knock, lasts until the knock leaves the
+  // 8-block window and is not broken up in between
+  int first = firstHit();
+  int last = lastHit();
+  TEST_ASSERT_GREATER_OR_EQUAL(blockAt(500), first);
+  TEST_ASSERT_LESS_OR_EQUAL(blockAt(500) + 1, first);
+  TEST_ASSERT_LESS_OR_EQUAL(blockAt(650) + VIBRATION_WINDOW_BLOCKS, last);
+  for (int b = first; b <= last; b++)
+  {
+    TEST_ASSERT_TRUE(hits[b]);
+  }
+}
+
+void test_knock_below_threshold_is_ignored()
+{
+  addImpact(500, 150, 3500);
+  TEST_ASSERT_EQUAL(0, replay());
+}
+
+void test_two_knocks_raise_two_hits()
+{
+  addImpact(200, 150, 6000);
+  addImpact(1400, 150, 6000);
+  replay();
+  int starts = 0;
+  for (int b = 0; b < TRACE_BLOCKS; b++)
+  {
+    starts += hits[b] && (b == 0 || !hits[b - 1]);
+  }
+  TEST_ASSERT_EQUAL(2, starts);
+}
+
+// Host throughput of the unrolled kernel against the per-sample reference; prints, asserts nothing
+void test_benchmark_block_features()
+{
+  const int rounds = 20000;
+  volatile uint64_t sink = 0;
+  VibrationFeatures features;
+  addImpact(500, 150, 6000);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+  {
+    vibrationBlockFeatures(&trace[(r % TRACE_BLOCKS) * BLOCK_SAMPLES], BLOCK_SAMPLES, features);
+    sink = sink + features.energy;
+  }
+  double kernelNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+  {
+    referenceFeatures(&trace[(r % TRACE_BLOCKS) * BLOCK_SAMPLES], BLOCK_SAMPLES, features);
+    sink = sink + features.energy;
+  }
+  double referenceNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  char line[128];
+  snprintf(line, sizeof(line), "%d-sample block: kernel %.0f ns, per-sample reference %.0f ns", BLOCK_SAMPLES,
+           kernelNs / rounds, referenceNs / rounds);
+  TEST_MESSAGE(line);
+}
+
+void test_benchmark_detector_update()
+{
+  const int rounds = 20000;
+  VibrationDetector detector;
+  vibrationDetectorInit(detector, thresholds);
+  addImpact(500, 150, 6000);
+
+  volatile int sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+  {
+    sink = sink + vibrationDetectorUpdate(detector, &trace[(r % TRACE_BLOCKS) * BLOCK_SAMPLES], BLOCK_SAMPLES);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  char line[128];
+  snprintf(line, sizeof(line), "detector update: %.0f ns per block, %.1f Msamples/s", ns / rounds,
+           ns > 0 ? rounds * BLOCK_SAMPLES * 1000.0 / ns : 0.0);
+  TEST_MESSAGE(line);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_isqrt_matches_floor_sqrt);
+  RUN_TEST(test_block_features_match_reference);
+  RUN_TEST(test_channel_bits_are_masked);
+  RUN_TEST(test_quiet_trace_never_hits);
+  RUN_TEST(test_single_noisy_sample_is_ignored);
+  RUN_TEST(test_knock_raises_one_hit);
+  RUN_TEST(test_knock_below_threshold_is_ignored);
+  RUN_TEST(test_two_knocks_raise_two_hits);
+  RUN_TEST(test_benchmark_block_features);
+  RUN_TEST(test_benchmark_detector_update);
+  return UNITY_END();
+}
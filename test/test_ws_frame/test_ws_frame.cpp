@@ -0,0 +1,232 @@
+#include <unity.h>
+#include <string.h>
+#include "../../src/wsFrame/wsFrame.h"
+
+// The masking key of the examples in RFC 6455 section 5.7
+static const uint8_t rfcMask[4] = {0x37, 0xFA, 0x21, 0x3D};
+
+static uint8_t frame[WS_HEADER_MAX_BYTES + 70000];
+static uint8_t payload[70000];
+
+// Builds a masked client frame the way realtimeChannel sends one; returns its size
+static size_t encode(uint8_t opcode, const uint8_t *data, size_t length, const uint8_t mask[4])
+{
+  size_t header = wsFrameEncodeHeader(frame, opcode, length, mask);
+  memcpy(&frame[header], data, length);
+  wsFrameMask(&frame[header], length, mask);
+  return header + length;
+}
+
+// Decodes a frame in memory the way realtimeChannel reads one off the socket; returns the payload
+static uint8_t *decode(uint8_t *bytes, WsFrameHeader &header)
+{
+  size_t size = wsFrameHeaderBytes(bytes);
+  wsFrameDecodeHeader(bytes, header);
+  if (header.masked)
+  {
+    wsFrameMask(&bytes[size], header.length, header.mask);
+  }
+  return &bytes[size];
+}
+
+void setUp()
+{
+  for (size_t i = 0; i < sizeof(payload); i++)
+  {
+    payload[i] = i * 31 + 7;
+  }
+}
+
+void tearDown()
+{
+}
+
+void test_masked_text_matches_rfc_example()
+{
+  const uint8_t expected[] = {0x81, 0x85, 0x37, 0xFA, 0x21, 0x3D, 0x7F, 0x9F, 0x4D, 0x51, 0x58};
+  TEST_ASSERT_EQUAL(sizeof(expected), encode(WS_OPCODE_TEXT, (const uint8_t *)"Hello", 5, rfcMask));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, frame, sizeof(expected));
+}
+
+void test_masked_text_decodes()
+{
+  uint8_t bytes[] = {0x81, 0x85, 0x37, 0xFA, 0x21, 0x3D, 0x7F, 0x9F, 0x4D, 0x51, 0x58};
+  WsFrameHeader header;
+  TEST_ASSERT_EQUAL(6, wsFrameHeaderBytes(bytes));
+  uint8_t *data = decode(bytes, header);
+  TEST_ASSERT_TRUE(header.fin);
+  TEST_ASSERT_TRUE(header.masked);
+  TEST_ASSERT_EQUAL(WS_OPCODE_TEXT, header.opcode);
+  TEST_ASSERT_EQUAL(5, header.length);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(rfcMask, header.mask, 4);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY("Hello", data, 5);
+}
+
+// Servers do not mask, and the key must not be left over from an earlier frame
+void test_unmasked_server_frame_decodes()
+{
+  uint8_t bytes[] = {0x81, 0x05, 'H', 'e', 'l', 'l', 'o'};
+  WsFrameHeader header;
+  memset(header.mask, 0xAA, 4);
+  TEST_ASSERT_EQUAL(2, wsFrameHeaderBytes(bytes));
+  uint8_t *data = decode(bytes, header);
+  TEST_ASSERT_FALSE(header.masked);
+  TEST_ASSERT_EQUAL(5, header.length);
+  const uint8_t zero[4] = {0, 0, 0, 0};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(zero, header.mask, 4);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY("Hello", data, 5);
+}
+
+void test_fragments_keep_fin_and_opcode()
+{
+  uint8_t first[] = {0x01, 0x03, 'H', 'e', 'l'};
+  uint8_t last[] = {0x80, 0x02, 'l', 'o'};
+  WsFrameHeader header;
+  decode(first, header);
+  TEST_ASSERT_FALSE(header.fin);
+  TEST_ASSERT_EQUAL(WS_OPCODE_TEXT, header.opcode);
+  decode(last, header);
+  TEST_ASSERT_TRUE(header.fin);
+  TEST_ASSERT_EQUAL(WS_OPCODE_CONTINUATION, header.opcode);
+}
+
+// 125 bytes is the last length that fits the first byte; 126 and up take a 16-bit length
+void test_length_boundaries()
+{
+  TEST_ASSERT_EQUAL(2 + 4, wsFrameEncodeHeader(frame, WS_OPCODE_TEXT, 125, rfcMask));
+  TEST_ASSERT_EQUAL_HEX8(0x80 | 125, frame[1]);
+
+  const uint8_t sixteen[] = {0x81, 0x80 | 126, 0x00, 0x7E};
+  TEST_ASSERT_EQUAL(4 + 4, wsFrameEncodeHeader(frame, WS_OPCODE_TEXT, 126, rfcMask));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(sixteen, frame, sizeof(sixteen));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(rfcMask, &frame[4], 4);
+
+  const uint8_t widest[] = {0x81, 0x80 | 126, 0xFF, 0xFF};
+  TEST_ASSERT_EQUAL(4 + 4, wsFrameEncodeHeader(frame, WS_OPCODE_TEXT, 0xFFFF, rfcMask));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(widest, frame, sizeof(widest));
+
+  const uint8_t sixtyFour[] = {0x81, 0x80 | 127, 0, 0, 0, 0, 0, 1, 0, 0};
+  TEST_ASSERT_EQUAL(10 + 4, wsFrameEncodeHeader(frame, WS_OPCODE_TEXT, 0x10000, rfcMask));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(sixtyFour, frame, sizeof(sixtyFour));
+}
+
+// The 256-byte and 64 KiB unmasked binary examples of RFC 6455 section 5.7
+void test_extended_lengths_decode()
+{
+  const uint8_t sixteen[] = {0x82, 0x7E, 0x01, 0x00};
+  const uint8_t sixtyFour[] = {0x82, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+  WsFrameHeader header;
+  TEST_ASSERT_EQUAL(4, wsFrameHeaderBytes(sixteen));
+  wsFrameDecodeHeader(sixteen, header);
+  TEST_ASSERT_EQUAL(WS_OPCODE_BINARY, header.opcode);
+  TEST_ASSERT_EQUAL(256, header.length);
+  TEST_ASSERT_EQUAL(10, wsFrameHeaderBytes(sixtyFour));
+  wsFrameDecodeHeader(sixtyFour, header);
+  TEST_ASSERT_EQUAL(65536, header.length);
+
+  const uint8_t huge[] = {0x82, 0xFF, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 1, 2, 3, 4};
+  TEST_ASSERT_EQUAL(14, wsFrameHeaderBytes(huge));
+  wsFrameDecodeHeader(huge, header);
+  TEST_ASSERT_TRUE(header.length == 0x0102030405060708ull);
+  TEST_ASSERT_EQUAL(4, header.mask[3]);
+}
+
+// What the client encodes, a server decodes back, on either side of each length boundary
+void test_round_trip_every_length_form()
+{
+  const size_t lengths[] = {0, 1, 3, 4, 5, 125, 126, 127, 2048, 0xFFFF, 0x10000, 0x10001};
+  const uint8_t mask[4] = {0x01, 0x80, 0xFF, 0x5A};
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+  {
+    size_t size = encode(WS_OPCODE_BINARY, payload, lengths[i], mask);
+    WsFrameHeader header;
+    uint8_t *data = decode(frame, header);
+    TEST_ASSERT_EQUAL(size, data - frame + lengths[i]);
+    TEST_ASSERT_TRUE(header.fin);
+    TEST_ASSERT_TRUE(header.masked);
+    TEST_ASSERT_EQUAL(WS_OPCODE_BINARY, header.opcode);
+    TEST_ASSERT_TRUE(header.length == lengths[i]);
+    if (lengths[i] > 0)
+    {
+      TEST_ASSERT_EQUAL_UINT8_ARRAY(payload, data, lengths[i]);
+    }
+  }
+}
+
+void test_masking_changes_every_key_position()
+{
+  uint8_t data[8] = {0};
+  wsFrameMask(data, sizeof(data), rfcMask);
+  for (size_t i = 0; i < sizeof(data); i++)
+  {
+    TEST_ASSERT_EQUAL_HEX8(rfcMask[i & 3], data[i]);
+  }
+  wsFrameMask(data, sizeof(data), rfcMask);
+  const uint8_t zero[8] = {0};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(zero, data, sizeof(data));
+}
+
+// A ping's payload goes back unchanged in the pong, masked by the client
+void test_ping_is_answered_with_its_payload()
+{
+  uint8_t ping[] = {0x89, 0x05, 'H', 'e', 'l', 'l', 'o'};
+  WsFrameHeader header;
+  uint8_t *data = decode(ping, header);
+  TEST_ASSERT_EQUAL(WS_OPCODE_PING, header.opcode);
+
+  const uint8_t pong[] = {0x8A, 0x85, 0x37, 0xFA, 0x21, 0x3D, 0x7F, 0x9F, 0x4D, 0x51, 0x58};
+  TEST_ASSERT_EQUAL(sizeof(pong), encode(WS_OPCODE_PONG, data, header.length, rfcMask));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(pong, frame, sizeof(pong));
+}
+
+void test_empty_ping_gets_empty_pong()
+{
+  const uint8_t pong[] = {0x8A, 0x80, 0x37, 0xFA, 0x21, 0x3D};
+  TEST_ASSERT_EQUAL(sizeof(pong), encode(WS_OPCODE_PONG, payload, 0, rfcMask));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(pong, frame, sizeof(pong));
+}
+
+void test_close_code_and_reason()
+{
+  uint8_t close[] = {0x88, 0x09, 0x03, 0xE8, 'g', 'o', 'i', 'n', 'g', ' ', 'x'};
+  WsFrameHeader header;
+  uint8_t *data = decode(close, header);
+  TEST_ASSERT_EQUAL(WS_OPCODE_CLOSE, header.opcode);
+  TEST_ASSERT_EQUAL(WS_CLOSE_NORMAL, wsFrameCloseCode(data, header.length));
+
+  const uint8_t away[] = {0x03, 0xE9};
+  TEST_ASSERT_EQUAL(1001, wsFrameCloseCode(away, 2));
+  TEST_ASSERT_EQUAL(WS_CLOSE_NO_STATUS, wsFrameCloseCode(away, 0));
+  TEST_ASSERT_EQUAL(WS_CLOSE_NO_STATUS, wsFrameCloseCode(away, 1));
+}
+
+// The client echoes only the code; the answer round-trips to the same code
+void test_close_echo_round_trips()
+{
+  uint8_t code[] = {0x03, 0xE8};
+  size_t size = encode(WS_OPCODE_CLOSE, code, 2, rfcMask);
+  TEST_ASSERT_EQUAL(2 + 4 + 2, size);
+  TEST_ASSERT_EQUAL_HEX8(0x88, frame[0]);
+  WsFrameHeader header;
+  uint8_t *data = decode(frame, header);
+  TEST_ASSERT_EQUAL(WS_OPCODE_CLOSE, header.opcode);
+  TEST_ASSERT_EQUAL(WS_CLOSE_NORMAL, wsFrameCloseCode(data, header.length));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_masked_text_matches_rfc_example);
+  RUN_TEST(test_masked_text_decodes);
+  RUN_TEST(test_unmasked_server_frame_decodes);
+  RUN_TEST(test_fragments_keep_fin_and_opcode);
+  RUN_TEST(test_length_boundaries);
+  RUN_TEST(test_extended_lengths_decode);
+  RUN_TEST(test_round_trip_every_length_form);
+  RUN_TEST(test_masking_changes_every_key_position);
+  RUN_TEST(test_ping_is_answered_with_its_payload);
+  RUN_TEST(test_empty_ping_gets_empty_pong);
+  RUN_TEST(test_close_code_and_reason);
+  RUN_TEST(test_close_echo_round_trips);
+  return UNITY_END();
+}